@@ -0,0 +1,178 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include "mesh_builder.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+/// Synthetic meshes and .obj captures, as the snapshots the main thread
+/// copies out of Maya.
+namespace bench
+{
+	/// Quads in row order, triangulated the way Maya fans them.
+	///
+	inline void makeGrid(mb::MeshSnapshot& _snapshot, int _size, bool _shuffle)
+	{
+		for (int yy = 0; yy <= _size; ++yy)
+		{
+			for (int xx = 0; xx <= _size; ++xx)
+			{
+				_snapshot.positions.push_back(float(xx));
+				_snapshot.positions.push_back(0.0f);
+				_snapshot.positions.push_back(float(yy));
+			}
+		}
+
+		std::vector<int> faces;
+		for (int yy = 0; yy < _size; ++yy)
+		{
+			for (int xx = 0; xx < _size; ++xx)
+			{
+				faces.push_back(yy * _size + xx);
+			}
+		}
+
+		// Worst case, like a mesh that was built up from many separate edits
+		if (_shuffle)
+		{
+			std::mt19937 random(1234);
+			std::shuffle(faces.begin(), faces.end(), random);
+		}
+
+		for (int face : faces)
+		{
+			int xx = face % _size;
+			int yy = face / _size;
+			int v0 = yy * (_size + 1) + xx;
+			int quad[4] = { v0, v0 + 1, v0 + _size + 2, v0 + _size + 1 };
+
+			_snapshot.faceVertexCounts.push_back(4);
+			_snapshot.faceVertexIndices.insert(_snapshot.faceVertexIndices.end(), quad, quad + 4);
+			_snapshot.triangleCounts.push_back(2);
+			int triangles[6] = { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] };
+			_snapshot.triangleVertices.insert(_snapshot.triangleVertices.end(), triangles, triangles + 6);
+		}
+	}
+
+	/// Latitude-longitude sphere, quads with triangle fans at the poles.
+	///
+	inline void makeSphere(mb::MeshSnapshot& _snapshot, int _rings, int _segments)
+	{
+		const float pi = 3.14159265f;
+
+		_snapshot.positions.insert(_snapshot.positions.end(), { 0.0f, 1.0f, 0.0f });
+		for (int rr = 1; rr < _rings; ++rr)
+		{
+			float theta = pi * float(rr) / float(_rings);
+			for (int ss = 0; ss < _segments; ++ss)
+			{
+				float phi = 2.0f * pi * float(ss) / float(_segments);
+				_snapshot.positions.insert(_snapshot.positions.end(), { sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) });
+			}
+		}
+		_snapshot.positions.insert(_snapshot.positions.end(), { 0.0f, -1.0f, 0.0f });
+
+		int bottom = 1 + (_rings - 1) * _segments;
+		auto ring = [&](int _ring, int _segment) { return 1 + (_ring - 1) * _segments + (_segment % _segments); };
+
+		for (int rr = 0; rr < _rings; ++rr)
+		{
+			for (int ss = 0; ss < _segments; ++ss)
+			{
+				// Fixed size, a vector assigned from an initializer list trips
+				// -Wnonnull in the standard library once inlined
+				int face[4];
+				int count = 0;
+				if (rr == 0)
+				{
+					face[count++] = 0;
+					face[count++] = ring(1, ss + 1);
+					face[count++] = ring(1, ss);
+				}
+				else if (rr == _rings - 1)
+				{
+					face[count++] = ring(rr, ss);
+					face[count++] = ring(rr, ss + 1);
+					face[count++] = bottom;
+				}
+				else
+				{
+					face[count++] = ring(rr, ss);
+					face[count++] = ring(rr, ss + 1);
+					face[count++] = ring(rr + 1, ss + 1);
+					face[count++] = ring(rr + 1, ss);
+				}
+
+				_snapshot.faceVertexCounts.push_back(count);
+				_snapshot.faceVertexIndices.insert(_snapshot.faceVertexIndices.end(), face, face + count);
+				_snapshot.triangleCounts.push_back(count - 2);
+				for (int jj = 1; jj + 1 < count; ++jj)
+				{
+					_snapshot.triangleVertices.push_back(face[0]);
+					_snapshot.triangleVertices.push_back(face[jj]);
+					_snapshot.triangleVertices.push_back(face[jj + 1]);
+				}
+			}
+		}
+	}
+
+	/// Positions and polygons of an .obj, fan triangulated.
+	///
+	inline bool loadObj(mb::MeshSnapshot& _snapshot, const char* _path)
+	{
+		FILE* file = fopen(_path, "r");
+		if (file == NULL)
+		{
+			return false;
+		}
+
+		char line[4096];
+		while (fgets(line, sizeof(line), file) != NULL)
+		{
+			if (line[0] == 'v' && line[1] == ' ')
+			{
+				float x = 0.0f, y = 0.0f, z = 0.0f;
+				sscanf(line + 2, "%f %f %f", &x, &y, &z);
+				_snapshot.positions.insert(_snapshot.positions.end(), { x, y, z });
+			}
+			else if (line[0] == 'f' && line[1] == ' ')
+			{
+				std::vector<int> face;
+				char* token = strtok(line + 2, " \t\r\n");
+				while (token != NULL)
+				{
+					int index = atoi(token);
+					face.push_back(index > 0 ? index - 1 : int(_snapshot.positions.size() / 3) + index);
+					token = strtok(NULL, " \t\r\n");
+				}
+				if (face.size() < 3)
+				{
+					continue;
+				}
+
+				_snapshot.faceVertexCounts.push_back(int(face.size()));
+				_snapshot.faceVertexIndices.insert(_snapshot.faceVertexIndices.end(), face.begin(), face.end());
+				_snapshot.triangleCounts.push_back(int(face.size()) - 2);
+				for (size_t jj = 1; jj + 1 < face.size(); ++jj)
+				{
+					_snapshot.triangleVertices.insert(_snapshot.triangleVertices.end(), { face[0], face[jj], face[jj + 1] });
+				}
+			}
+		}
+
+		fclose(file);
+		return !_snapshot.faceVertexCounts.empty();
+	}
+
+} // namespace bench
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+// Reports the vertex cache efficiency (ACMR) of converted meshes with and
+// without the optimization stage, for synthetic meshes and for meshes
+// captured from Maya as .obj files passed on the command line:
+//
+//   mesh_optimizer_bench [capture.obj ...]
+//
+// Also checks that rebuilding a deformed mesh keeps the vertex order the
+// consumer patches vertex deltas into.
+
+#include "bench_meshes.h"
+#include "mesh_optimizer.h"
+
+#include <chrono>
+#include <string>
+
+namespace
+{
+	float getMeshAcmr(const mb::MeshData& _mesh, uint32_t _cacheSize)
+	{
+		uint32_t misses = 0;
+		size_t numTriangles = _mesh.indices.size() / 3;
+		for (const mb::SubMeshData& subMesh : _mesh.subMeshes)
+		{
+			float acmr = mb::getAcmr(&_mesh.indices[subMesh.firstIndex], subMesh.numIndices, uint32_t(_mesh.vertices.size()), _cacheSize);
+			misses += uint32_t(lrintf(acmr * float(subMesh.numIndices / 3)));
+		}
+		return numTriangles != 0 ? float(misses) / float(numTriangles) : 0.0f;
+	}
+
+	double buildMs(const mb::MeshSnapshot& _snapshot, mb::MeshData& _mesh, bool _optimize)
+	{
+		_mesh = mb::MeshData();
+		_mesh.optimize = _optimize;
+
+		auto start = std::chrono::steady_clock::now();
+		mb::buildMesh(_snapshot, _mesh);
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	void run(const char* _name, mb::MeshSnapshot& _snapshot)
+	{
+		// One material on every face
+		_snapshot.faceShaders.assign(_snapshot.faceVertexCounts.size(), 0);
+		_snapshot.materials.assign(1, "lambert1");
+
+		mb::MeshData before;
+		mb::MeshData after;
+		double beforeMs = buildMs(_snapshot, before, false);
+		double afterMs = buildMs(_snapshot, after, true);
+
+		size_t indexSize = after.vertices.size() < UINT16_MAX ? sizeof(uint16_t) : sizeof(uint32_t);
+
+		printf("%-24s %8zu tris %8zu verts | ACMR@16 %5.3f -> %5.3f | ACMR@32 %5.3f -> %5.3f | build %7.2f -> %7.2f ms | indices %zu -> %zu KB\n",
+			_name,
+			after.indices.size() / 3,
+			after.vertices.size(),
+			getMeshAcmr(before, 16), getMeshAcmr(after, 16),
+			getMeshAcmr(before, 32), getMeshAcmr(after, 32),
+			beforeMs, afterMs,
+			before.indices.size() * sizeof(uint32_t) / 1024,
+			after.indices.size() * indexSize / 1024);
+	}
+
+	/// Builds _snapshot, deforms it and rebuilds it the way the quiet rebuild
+	/// after a deformation does. The rebuild has to number vertices like the
+	/// first build, and match it patched with the vertex delta.
+	bool checkStableOrder(const char* _name, mb::MeshSnapshot& _snapshot)
+	{
+		_snapshot.faceShaders.assign(_snapshot.faceVertexCounts.size(), 0);
+		_snapshot.materials.assign(1, "lambert1");
+
+		mb::MeshData first;
+		first.optimize = true;
+		mb::MeshSource source;
+		mb::buildMesh(_snapshot, first, &source);
+
+		// Stretch one side, which moves the overdraw sort keys around
+		mb::MeshSnapshot deformed = _snapshot;
+		for (size_t ii = 0; ii < deformed.positions.size(); ii += 3)
+		{
+			float* position = &deformed.positions[ii];
+			if (position[1] > 0.0f)
+			{
+				position[0] = position[0] * 3.0f + 2.0f;
+				position[2] -= position[1] * 1.5f;
+			}
+		}
+
+		mb::MeshData fresh;
+		fresh.optimize = true;
+		mb::buildMesh(deformed, fresh);
+		bool freshKept = fresh.indices == first.indices;
+
+		mb::MeshData rebuilt;
+		rebuilt.optimize = true;
+		mb::MeshSource rebuiltSource;
+		mb::buildMesh(deformed, rebuilt, &rebuiltSource, &source);
+
+		// What the consumer has after applying the delta to the first build
+		mb::MeshSnapshot edited = deformed;
+		mb::VertexDeltaData delta;
+		bool patched = mb::buildVertexDelta(source, edited, delta);
+
+		std::vector<mb::Vertex> vertices = first.vertices;
+		size_t cursor = 0;
+		for (const mb::VertexRun& run : delta.runs)
+		{
+			for (uint32_t ii = run.first; ii < run.first + run.count; ++ii)
+			{
+				memcpy(vertices[ii].position, delta.vertices[cursor++].position, sizeof(float) * 3);
+			}
+		}
+		for (size_t ii = 0; ii < vertices.size() && patched; ++ii)
+		{
+			patched = memcmp(vertices[ii].position, rebuilt.vertices[ii].position, sizeof(float) * 3) == 0;
+		}
+
+		bool kept = rebuilt.indices == first.indices && rebuiltSource.remap == source.remap && rebuilt.vertices.size() == first.vertices.size();
+		printf("%-24s deformed rebuild | order %s (%s without the previous order) | delta %s\n",
+			_name,
+			kept ? "kept" : "CHANGED",
+			freshKept ? "kept" : "changes",
+			patched ? "matches" : "MISMATCH");
+		return kept && patched;
+	}
+
+	/// Flips the diagonal of every quad, which keeps the vertex and index
+	/// counts. The rebuild must not take the order of the first build over.
+	bool checkRetriangulated(const char* _name, mb::MeshSnapshot& _snapshot)
+	{
+		_snapshot.faceShaders.assign(_snapshot.faceVertexCounts.size(), 0);
+		_snapshot.materials.assign(1, "lambert1");
+
+		mb::MeshData first;
+		first.optimize = true;
+		mb::MeshSource source;
+		mb::buildMesh(_snapshot, first, &source);
+
+		mb::MeshSnapshot flipped = _snapshot;
+		size_t faceVertex = 0;
+		size_t triangleVertex = 0;
+		for (size_t ii = 0; ii < flipped.faceVertexCounts.size(); ++ii)
+		{
+			if (flipped.faceVertexCounts[ii] == 4)
+			{
+				const int* quad = &flipped.faceVertexIndices[faceVertex];
+				int triangles[6] = { quad[1], quad[2], quad[3], quad[1], quad[3], quad[0] };
+				memcpy(&flipped.triangleVertices[triangleVertex], triangles, sizeof(triangles));
+			}
+			faceVertex += flipped.faceVertexCounts[ii];
+			triangleVertex += flipped.triangleCounts[ii] * 3;
+		}
+
+		mb::MeshData fresh;
+		fresh.optimize = true;
+		mb::buildMesh(flipped, fresh);
+
+		mb::MeshData rebuilt;
+		rebuilt.optimize = true;
+		mb::buildMesh(flipped, rebuilt, NULL, &source);
+
+		bool rebuiltFresh = rebuilt.indices == fresh.indices && rebuilt.indices != first.indices;
+		printf("%-24s flipped diagonals | %s\n", _name, rebuiltFresh ? "ordered again" : "OLD ORDER KEPT");
+		return rebuiltFresh;
+	}
+
+	/// A UV edit dirties the mesh like a deformation, but has to be refused
+	/// as a delta so the mesh is sent whole.
+	bool checkUVEdit(const char* _name, mb::MeshSnapshot& _snapshot)
+	{
+		_snapshot.faceShaders.assign(_snapshot.faceVertexCounts.size(), 0);
+		_snapshot.materials.assign(1, "lambert1");
+		for (size_t ii = 0; ii < _snapshot.positions.size(); ii += 3)
+		{
+			_snapshot.us.push_back(_snapshot.positions[ii + 0]);
+			_snapshot.vs.push_back(_snapshot.positions[ii + 2]);
+		}
+		_snapshot.faceUVCounts = _snapshot.faceVertexCounts;
+		_snapshot.faceUVIds = _snapshot.faceVertexIndices;
+
+		mb::MeshData first;
+		mb::MeshSource source;
+		mb::buildMesh(_snapshot, first, &source);
+
+		mb::MeshSnapshot moved = _snapshot;
+		moved.positions[1] += 1.0f;
+		mb::VertexDeltaData delta;
+		bool deltaMoved = mb::buildVertexDelta(source, moved, delta) && !delta.runs.empty();
+
+		mb::MeshSnapshot unwrapped = _snapshot;
+		unwrapped.us[0] += 0.5f;
+		bool deltaUnwrapped = mb::buildVertexDelta(source, unwrapped, delta);
+
+		printf("%-24s point moved | %s, uv moved | %s\n",
+			_name,
+			deltaMoved ? "delta" : "NO DELTA",
+			deltaUnwrapped ? "DELTA" : "sent whole");
+		return deltaMoved && !deltaUnwrapped;
+	}
+
+} // namespace
+
+int main(int _argc, char** _argv)
+{
+	bool stable = true;
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeSphere(snapshot, 64, 128);
+		stable = checkStableOrder("sphere 64x128", snapshot) && stable;
+	}
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeGrid(snapshot, 100, true);
+		stable = checkStableOrder("grid 100x100 shuffled", snapshot) && stable;
+	}
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeGrid(snapshot, 100, false);
+		stable = checkUVEdit("grid 100x100", snapshot) && stable;
+	}
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeGrid(snapshot, 100, true);
+		stable = checkRetriangulated("grid 100x100 shuffled", snapshot) && stable;
+	}
+
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeGrid(snapshot, 200, false);
+		run("grid 200x200", snapshot);
+	}
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeGrid(snapshot, 200, true);
+		run("grid 200x200 shuffled", snapshot);
+	}
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeSphere(snapshot, 128, 256);
+		run("sphere 128x256", snapshot);
+	}
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeGrid(snapshot, 400, false);
+		run("grid 400x400", snapshot);
+	}
+
+	for (int ii = 1; ii < _argc; ++ii)
+	{
+		mb::MeshSnapshot snapshot;
+		if (!bench::loadObj(snapshot, _argv[ii]))
+		{
+			fprintf(stderr, "Failed to load %s\n", _argv[ii]);
+			continue;
+		}
+
+		std::string name = _argv[ii];
+		size_t slash = name.find_last_of("/\\");
+		run(slash == std::string::npos ? name.c_str() : name.c_str() + slash + 1, snapshot);
+	}
+
+	return stable ? 0 : 1;
+}
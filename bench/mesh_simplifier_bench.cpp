@@ -0,0 +1,147 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+// Reports the LOD chains of converted meshes, how long they and the proxy
+// sent ahead of them take, and checks that generation is deterministic and
+// every level is a valid index buffer. For the unit sphere the error is
+// also measured against the true surface:
+//
+//   mesh_simplifier_bench [capture.obj ...]
+
+#include "bench_meshes.h"
+#include "mesh_simplifier.h"
+
+#include <chrono>
+#include <string>
+
+namespace
+{
+	double elapsedMs(std::chrono::steady_clock::time_point _start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+	}
+
+	/// Farthest triangle centroid or vertex off the unit sphere.
+	///
+	float getSphereError(const mb::MeshData& _mesh, const uint32_t* _indices, uint32_t _numIndices)
+	{
+		float error = 0.0f;
+		for (uint32_t ii = 0; ii + 2 < _numIndices; ii += 3)
+		{
+			float centroid[3] = { 0.0f, 0.0f, 0.0f };
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				const float* p = _mesh.vertices[_indices[ii + kk]].position;
+				centroid[0] += p[0] / 3.0f;
+				centroid[1] += p[1] / 3.0f;
+				centroid[2] += p[2] / 3.0f;
+			}
+			float radius = sqrtf(centroid[0] * centroid[0] + centroid[1] * centroid[1] + centroid[2] * centroid[2]);
+			error = std::max(error, fabsf(radius - 1.0f));
+		}
+		return error;
+	}
+
+	bool isValid(const mb::MeshData& _mesh, const uint32_t* _indices, uint32_t _numIndices)
+	{
+		for (uint32_t ii = 0; ii + 2 < _numIndices; ii += 3)
+		{
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				if (_indices[ii + kk] >= _mesh.vertices.size() || _indices[ii + kk] == _indices[ii + (kk + 1) % 3])
+				{
+					return false;
+				}
+			}
+		}
+		return _numIndices % 3 == 0;
+	}
+
+	void run(const char* _name, mb::MeshSnapshot& _snapshot, bool _sphere)
+	{
+		_snapshot.faceShaders.assign(_snapshot.faceVertexCounts.size(), 0);
+		_snapshot.materials.assign(1, "lambert1");
+
+		mb::MeshData meshes[2];
+		double lodMs = 0.0;
+		for (mb::MeshData& mesh : meshes)
+		{
+			mesh.optimize = true;
+			mb::buildMesh(_snapshot, mesh);
+
+			auto start = std::chrono::steady_clock::now();
+			mb::buildLods(mesh, MAYABRIDGE_MAX_LODS - 1);
+			lodMs = elapsedMs(start);
+		}
+		const mb::MeshData& mesh = meshes[0];
+
+		bool deterministic = meshes[0].lodIndices == meshes[1].lodIndices;
+
+		auto start = std::chrono::steady_clock::now();
+		mb::MeshData proxy;
+		mb::buildProxyMesh(mesh, 64, proxy);
+		double proxyMs = elapsedMs(start);
+
+		printf("%-24s %8zu tris | lods %7.2f ms | proxy %6.2f ms %7zu tris | %s\n",
+			_name,
+			mesh.indices.size() / 3,
+			lodMs,
+			proxyMs,
+			proxy.indices.size() / 3,
+			deterministic ? "deterministic" : "NOT DETERMINISTIC");
+
+		for (const mb::SubMeshData& subMesh : mesh.subMeshes)
+		{
+			for (size_t ii = 0; ii < subMesh.lods.size(); ++ii)
+			{
+				const mb::LodData& lod = subMesh.lods[ii];
+				const uint32_t* indices = &mesh.lodIndices[lod.firstIndex];
+
+				printf("  lod %zu %8u tris (%5.1f%%) | error %.5f", ii + 1, lod.numIndices / 3, 100.0f * float(lod.numIndices) / float(subMesh.numIndices), lod.error);
+				if (_sphere)
+				{
+					printf(" | off sphere %.5f", getSphereError(mesh, indices, lod.numIndices));
+				}
+				printf("%s\n", isValid(mesh, indices, lod.numIndices) ? "" : " | INVALID");
+			}
+		}
+	}
+
+} // namespace
+
+int main(int _argc, char** _argv)
+{
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeGrid(snapshot, 200, false);
+		run("grid 200x200", snapshot, false);
+	}
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeSphere(snapshot, 128, 256);
+		run("sphere 128x256", snapshot, true);
+	}
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeSphere(snapshot, 512, 1024);
+		run("sphere 512x1024", snapshot, true);
+	}
+
+	for (int ii = 1; ii < _argc; ++ii)
+	{
+		mb::MeshSnapshot snapshot;
+		if (!bench::loadObj(snapshot, _argv[ii]))
+		{
+			fprintf(stderr, "Failed to load %s\n", _argv[ii]);
+			continue;
+		}
+
+		std::string name = _argv[ii];
+		size_t slash = name.find_last_of("/\\");
+		run(slash == std::string::npos ? name.c_str() : name.c_str() + slash + 1, snapshot, false);
+	}
+
+	return 0;
+}
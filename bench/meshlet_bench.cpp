@@ -0,0 +1,170 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+// Reports how well converted meshes fill their meshlets and how many of
+// them the normal cones cull, and checks on the CPU that generation is
+// deterministic and that the bounds hold:
+//
+//   meshlet_bench [capture.obj ...]
+
+#include "bench_meshes.h"
+
+#include <chrono>
+#include <string>
+
+namespace
+{
+	float dot(const float* _a, const float* _b)
+	{
+		return _a[0] * _b[0] + _a[1] * _b[1] + _a[2] * _b[2];
+	}
+
+	bool isCulled(const mb::Meshlet& _meshlet, const float* _eye)
+	{
+		float d[3] = { _meshlet.coneApex[0] - _eye[0], _meshlet.coneApex[1] - _eye[1], _meshlet.coneApex[2] - _eye[2] };
+		float length = sqrtf(dot(d, d));
+		return length > 0.0f && dot(d, _meshlet.coneAxis) / length >= _meshlet.coneCutoff;
+	}
+
+	/// Counts meshlets whose bounds don't hold: a vertex outside the sphere,
+	/// or a culled meshlet with a triangle facing the eye.
+	///
+	uint32_t validate(const mb::MeshData& _mesh, const float* _eye, uint32_t& _culled)
+	{
+		uint32_t errors = 0;
+		for (const mb::Meshlet& meshlet : _mesh.meshletRecords)
+		{
+			const uint32_t* vertices = &_mesh.meshletVertices[meshlet.vertexOffset];
+			const uint8_t* triangles = &_mesh.meshletTriangles[meshlet.triangleOffset];
+
+			bool error = meshlet.numVertices > MAYABRIDGE_MESHLET_MAX_VERTICES || meshlet.numTriangles > MAYABRIDGE_MESHLET_MAX_TRIANGLES;
+			for (uint32_t ii = 0; ii < meshlet.numVertices; ++ii)
+			{
+				const float* p = _mesh.vertices[vertices[ii]].position;
+				float d[3] = { p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2] };
+				error |= sqrtf(dot(d, d)) > meshlet.radius * 1.0001f + 1e-6f;
+			}
+
+			if (isCulled(meshlet, _eye))
+			{
+				_culled += 1;
+				for (uint32_t ii = 0; ii < meshlet.numTriangles; ++ii)
+				{
+					const float* p0 = _mesh.vertices[vertices[triangles[ii * 3 + 0]]].position;
+					const float* p1 = _mesh.vertices[vertices[triangles[ii * 3 + 1]]].position;
+					const float* p2 = _mesh.vertices[vertices[triangles[ii * 3 + 2]]].position;
+
+					float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+					float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+					float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+					float v[3] = { _eye[0] - p0[0], _eye[1] - p0[1], _eye[2] - p0[2] };
+					error |= dot(n, v) > 1e-4f * sqrtf(dot(n, n)) * sqrtf(dot(v, v));
+				}
+			}
+
+			errors += error ? 1 : 0;
+		}
+		return errors;
+	}
+
+	void run(const char* _name, mb::MeshSnapshot& _snapshot)
+	{
+		_snapshot.faceShaders.assign(_snapshot.faceVertexCounts.size(), 0);
+		_snapshot.materials.assign(1, "lambert1");
+
+		mb::MeshData meshes[2];
+		double ms = 0.0;
+		for (mb::MeshData& mesh : meshes)
+		{
+			mesh.optimize = true;
+			mesh.meshlets = true;
+
+			auto start = std::chrono::steady_clock::now();
+			mb::buildMesh(_snapshot, mesh);
+			ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		const mb::MeshData& mesh = meshes[0];
+		bool deterministic = meshes[0].hash == meshes[1].hash
+			&& meshes[0].meshletRecords.size() == meshes[1].meshletRecords.size()
+			&& memcmp(meshes[0].meshletRecords.data(), meshes[1].meshletRecords.data(), sizeof(mb::Meshlet) * mesh.meshletRecords.size()) == 0
+			&& meshes[0].meshletVertices == meshes[1].meshletVertices
+			&& meshes[0].meshletTriangles == meshes[1].meshletTriangles;
+
+		// Six views from outside the bounds
+		float min[3] = { INFINITY, INFINITY, INFINITY };
+		float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (const mb::Vertex& vertex : mesh.vertices)
+		{
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				min[kk] = std::min(min[kk], vertex.position[kk]);
+				max[kk] = std::max(max[kk], vertex.position[kk]);
+			}
+		}
+
+		uint32_t culled = 0;
+		uint32_t errors = 0;
+		for (int axis = 0; axis < 6; ++axis)
+		{
+			float eye[3];
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				float center = (min[kk] + max[kk]) * 0.5f;
+				float extent = (max[kk] - min[kk]) + 1.0f;
+				eye[kk] = center + (kk == axis % 3 ? (axis < 3 ? 2.0f : -2.0f) * extent : 0.0f);
+			}
+			errors += validate(mesh, eye, culled);
+		}
+
+		size_t numMeshlets = mesh.meshletRecords.size();
+		printf("%-24s %8zu tris %7zu meshlets | %5.1f verts %5.1f tris each | cone culled %5.1f%% | build %7.2f ms | %s, %u bad bounds\n",
+			_name,
+			mesh.indices.size() / 3,
+			numMeshlets,
+			numMeshlets != 0 ? double(mesh.meshletVertices.size()) / double(numMeshlets) : 0.0,
+			numMeshlets != 0 ? double(mesh.indices.size() / 3) / double(numMeshlets) : 0.0,
+			numMeshlets != 0 ? 100.0 * double(culled) / double(numMeshlets * 6) : 0.0,
+			ms,
+			deterministic ? "deterministic" : "NOT DETERMINISTIC",
+			errors);
+	}
+
+} // namespace
+
+int main(int _argc, char** _argv)
+{
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeGrid(snapshot, 200, false);
+		run("grid 200x200", snapshot);
+	}
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeGrid(snapshot, 200, true);
+		run("grid 200x200 shuffled", snapshot);
+	}
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeSphere(snapshot, 128, 256);
+		run("sphere 128x256", snapshot);
+	}
+
+	for (int ii = 1; ii < _argc; ++ii)
+	{
+		mb::MeshSnapshot snapshot;
+		if (!bench::loadObj(snapshot, _argv[ii]))
+		{
+			fprintf(stderr, "Failed to load %s\n", _argv[ii]);
+			continue;
+		}
+
+		std::string name = _argv[ii];
+		size_t slash = name.find_last_of("/\\");
+		run(slash == std::string::npos ? name.c_str() : name.c_str() + slash + 1, snapshot);
+	}
+
+	return 0;
+}
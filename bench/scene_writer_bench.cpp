@@ -0,0 +1,507 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+// Drives a SceneWriter against a consumer in the same process, through the
+// same SharedData protocol a renderer uses across processes: publishes and
+// acquires, the event ring, blob retirement and snapshot files. Each check
+// prints a line and the exit code is 1 if any failed. Then times loading
+// and publishing a scene of many models.
+
+#include "bench_meshes.h"
+#include "maya-bridge/shared_buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	/// Zeroed, page aligned memory standing in for the shared mapping.
+	struct Arena
+	{
+		explicit Arena(uint64_t _size)
+			: bytes(_size + 4096, 0)
+			, m_size(_size)
+		{
+		}
+
+		void* data()
+		{
+			uintptr_t address = reinterpret_cast<uintptr_t>(bytes.data());
+			return bytes.data() + ((4096 - address % 4096) % 4096);
+		}
+
+		uint64_t size() const
+		{
+			return m_size;
+		}
+
+		std::vector<uint8_t> bytes;
+		uint64_t m_size;
+	};
+
+	bool report(const char* _name, bool _ok, const char* _detail)
+	{
+		printf("%-28s %s | %s\n", _name, _ok ? "ok    " : "FAILED", _detail);
+		return _ok;
+	}
+
+	/// Consumes every pending event, like a consumer would once per frame.
+	std::vector<mb::Event> drain(mb::SharedData& _data)
+	{
+		std::vector<mb::Event> events(MAYABRIDGE_CONFIG_EVENT_RING_SIZE);
+		uint32_t count = _data.events.peek(events.data(), uint32_t(events.size()));
+		_data.events.consume(count);
+		events.resize(count);
+		return events;
+	}
+
+	uint32_t countEvents(const std::vector<mb::Event>& _events, uint32_t _type)
+	{
+		uint32_t count = 0;
+		for (const mb::Event& event : _events)
+		{
+			count += event.type == _type ? 1 : 0;
+		}
+		return count;
+	}
+
+	void makeMesh(mb::MeshData& _mesh, int _size)
+	{
+		mb::MeshSnapshot snapshot;
+		bench::makeGrid(snapshot, _size, false);
+		snapshot.faceShaders.assign(snapshot.faceVertexCounts.size(), 0);
+		snapshot.materials.assign(1, "lambert1");
+		mb::buildMesh(snapshot, _mesh);
+	}
+
+	uint32_t addModel(mb::SceneWriter& _writer, const char* _name, const mb::MeshData& _mesh)
+	{
+		uint32_t index = _writer.addModel();
+		_writer.editModel(index).name = _writer.internString(_name);
+
+		mb::Mesh mesh;
+		if (_writer.writeMesh(mesh, _mesh))
+		{
+			_writer.setMesh(index, mesh);
+		}
+		return index;
+	}
+
+	/// Every published record and blob reads back as written.
+	bool checkRoundTrip()
+	{
+		Arena arena(64 << 20);
+		mb::SceneWriter writer;
+		writer.init(arena.data(), arena.size());
+		mb::SharedData& data = *static_cast<mb::SharedData*>(arena.data());
+		drain(data);
+
+		mb::MeshData mesh;
+		makeMesh(mesh, 20);
+
+		writer.addMaterial("lambert1");
+		char name[32];
+		for (uint32_t ii = 0; ii < 100; ++ii)
+		{
+			snprintf(name, sizeof(name), "model%u", ii);
+			addModel(writer, name, mesh);
+		}
+		writer.getHierarchy().resize(3);
+		writer.updateHierarchy(true);
+		writer.publish();
+
+		mb::Scene scene;
+		bool ok = data.isValid() && data.acquire(scene) && scene.numModels == 100 && scene.numMaterials == 1 && scene.numNodes == 3;
+		for (uint32_t ii = 0; ii < scene.numModels && ok; ++ii)
+		{
+			const mb::Model& model = scene.getModel(&data, ii);
+			snprintf(name, sizeof(name), "model%u", ii);
+			ok = model.id != 0
+				&& strcmp(scene.getString(&data, model.name), name) == 0
+				&& model.mesh.hash == mesh.hash
+				&& model.mesh.numVertices == mesh.vertices.size()
+				&& memcmp(model.mesh.getVertices(&data), mesh.vertices.data(), sizeof(mb::Vertex) * mesh.vertices.size()) == 0;
+		}
+		ok = ok && strcmp(scene.getString(&data, scene.getMaterial(&data, 0).name), "lambert1") == 0;
+		data.release();
+
+		std::vector<mb::Event> events = drain(data);
+		ok = ok && countEvents(events, MAYABRIDGE_EVENT_MODEL_ADDED) == 100
+			&& countEvents(events, MAYABRIDGE_EVENT_MATERIAL_ADDED) == 1
+			&& countEvents(events, MAYABRIDGE_EVENT_HIERARCHY_CHANGED) == 1;
+		for (const mb::Event& event : events)
+		{
+			ok = ok && event.sequence <= data.sequence.load();
+		}
+
+		return report("publish and acquire", ok, "100 models, names, mesh bytes and events");
+	}
+
+	/// A chunk that can't be written when the arena fills up between
+	/// publishes must not be published, nor any record after it.
+	bool checkFullArena()
+	{
+		Arena arena(1 << 20);
+		mb::SceneWriter writer;
+		writer.init(arena.data(), arena.size());
+		mb::SharedData& data = *static_cast<mb::SharedData*>(arena.data());
+
+		for (uint32_t ii = 0; ii < 10; ++ii)
+		{
+			writer.addModel();
+		}
+		writer.publish();
+
+		// Private blobs fill the arena, like meshes the workers are writing
+		mb::MeshData mesh;
+		makeMesh(mesh, 4);
+		std::vector<mb::Mesh> meshes;
+		mb::Mesh written;
+		while (writer.writeMesh(written, mesh))
+		{
+			meshes.push_back(written);
+		}
+
+		for (uint32_t ii = 0; ii < 100; ++ii)
+		{
+			writer.addModel();
+		}
+		writer.publish();
+
+		// Whatever is published has to be whole
+		mb::Scene scene;
+		bool ok = data.acquire(scene) && scene.numModels <= writer.getNumModels();
+		uint32_t published = scene.numModels;
+		for (uint32_t ii = 0; ii < scene.numModels && ok; ++ii)
+		{
+			ok = scene.getModel(&data, ii).id == writer.getModel(ii).id && scene.getModel(&data, ii).id != 0;
+		}
+		data.release();
+
+		// Room again, the rest goes out with the next publish
+		for (const mb::Mesh& discarded : meshes)
+		{
+			writer.discardMesh(discarded);
+		}
+		writer.publish();
+
+		ok = ok && data.acquire(scene) && scene.numModels == 110;
+		for (uint32_t ii = 0; ii < scene.numModels && ok; ++ii)
+		{
+			ok = scene.getModel(&data, ii).id == writer.getModel(ii).id && scene.getModel(&data, ii).id != 0;
+		}
+		data.release();
+
+		char detail[96];
+		snprintf(detail, sizeof(detail), "%u of 110 models published while full, all once there was room", published);
+		return report("full arena", ok, detail);
+	}
+
+	/// Removed slots read as empty and are taken again lowest first.
+	bool checkSlotReuse()
+	{
+		Arena arena(16 << 20);
+		mb::SceneWriter writer;
+		writer.init(arena.data(), arena.size());
+		mb::SharedData& data = *static_cast<mb::SharedData*>(arena.data());
+
+		for (uint32_t ii = 0; ii < 200; ++ii)
+		{
+			writer.addModel();
+		}
+		writer.publish();
+		drain(data);
+
+		uint32_t removedId = writer.getModel(130).id;
+		writer.removeModel(130);
+		writer.removeModel(70);
+		writer.removeModel(199);
+		writer.publish();
+
+		mb::Scene scene;
+		std::vector<mb::Event> events = drain(data);
+		bool ok = data.acquire(scene) && scene.numModels == 199
+			&& scene.getModel(&data, 70).id == 0 && scene.getModel(&data, 130).id == 0
+			&& countEvents(events, MAYABRIDGE_EVENT_MODEL_REMOVED) == 3;
+		data.release();
+
+		uint32_t first = writer.addModel();
+		uint32_t second = writer.addModel();
+		uint32_t third = writer.addModel();
+		writer.publish();
+
+		ok = ok && first == 70 && second == 130 && third == 199
+			&& data.acquire(scene) && scene.numModels == 200
+			&& scene.getModel(&data, 130).id != 0 && scene.getModel(&data, 130).id != removedId;
+		data.release();
+
+		return report("slot reuse", ok, "removed slots empty, then taken again lowest first with new ids");
+	}
+
+	/// Events that don't fit are dropped, and a RESYNC pointing at a scene
+	/// with everything in it follows once there is room.
+	bool checkRingOverflow()
+	{
+		Arena arena(16 << 20);
+		mb::SceneWriter writer;
+		writer.init(arena.data(), arena.size());
+		mb::SharedData& data = *static_cast<mb::SharedData*>(arena.data());
+		writer.addMaterial("lambert1");
+		writer.publish();
+		drain(data);
+
+		// A camera orbit only ever has one event in the ring
+		mb::Camera camera;
+		camera.reset();
+		for (uint32_t ii = 0; ii < 1000; ++ii)
+		{
+			writer.publishCamera(camera);
+		}
+		bool ok = countEvents(drain(data), MAYABRIDGE_EVENT_CAMERA_CHANGED) == 1;
+
+		for (uint32_t ii = 0; ii < MAYABRIDGE_CONFIG_EVENT_RING_SIZE + 100; ++ii)
+		{
+			writer.stageEvent(MAYABRIDGE_EVENT_MATERIAL_CHANGED, 0);
+		}
+		writer.publish();
+		ok = ok && writer.getNumResyncs() == 0 && drain(data).size() == MAYABRIDGE_CONFIG_EVENT_RING_SIZE;
+
+		writer.stageEvent(MAYABRIDGE_EVENT_MATERIAL_CHANGED, 0);
+		writer.publish();
+
+		mb::Scene scene;
+		std::vector<mb::Event> events = drain(data);
+		ok = ok && writer.getNumResyncs() == 1 && events.size() == 2
+			&& events[0].type == MAYABRIDGE_EVENT_RESYNC
+			&& data.acquire(scene) && events[0].sequence <= data.sequence.load();
+		data.release();
+
+		return report("ring overflow", ok, "one camera event per orbit, RESYNC once there was room");
+	}
+
+	/// A blob replaced while the reader holds a scene stays as it was until
+	/// the reader lets go.
+	bool checkRetire()
+	{
+		Arena arena(16 << 20);
+		mb::SceneWriter writer;
+		writer.init(arena.data(), arena.size());
+		mb::SharedData& data = *static_cast<mb::SharedData*>(arena.data());
+		writer.addMaterial("lambert1");
+
+		mb::MeshData mesh;
+		makeMesh(mesh, 30);
+		uint32_t index = addModel(writer, "model", mesh);
+		writer.publish();
+
+		mb::Scene held;
+		bool ok = data.acquire(held);
+		mb::Mesh old = held.getModel(&data, index).mesh;
+
+		// Replaced, and everything freed since written again
+		mb::MeshData other;
+		makeMesh(other, 30);
+		for (mb::Vertex& vertex : other.vertices)
+		{
+			vertex.position[1] = 1.0f;
+		}
+		for (uint32_t ii = 0; ii < 4; ++ii)
+		{
+			mb::Mesh replacement;
+			ok = ok && writer.writeMesh(replacement, other);
+			writer.setMesh(index, replacement);
+			writer.publish();
+		}
+		ok = ok && memcmp(old.getVertices(&data), mesh.vertices.data(), sizeof(mb::Vertex) * mesh.vertices.size()) == 0;
+
+		// Free once the reader moved on
+		data.release();
+		writer.publish();
+
+		mb::Mesh reused;
+		ok = ok && writer.writeMesh(reused, other) && reused.blobOffset <= old.blobOffset;
+		writer.discardMesh(reused);
+
+		return report("retire and reclaim", ok, "held mesh intact across replacements, reused after release");
+	}
+
+	/// Strings fill pages, and long ones get blobs of their own.
+	bool checkStrings()
+	{
+		Arena arena(16 << 20);
+		mb::SceneWriter writer;
+		writer.init(arena.data(), arena.size());
+		mb::SharedData& data = *static_cast<mb::SharedData*>(arena.data());
+
+		std::vector<std::string> strings;
+		std::vector<uint32_t> ids;
+		for (uint32_t ii = 0; ii < 3000; ++ii)
+		{
+			strings.push_back("|root|group" + std::to_string(ii % 17) + "|mesh" + std::to_string(ii) + std::string(ii % 97, 'x'));
+		}
+		strings.push_back(std::string(3 * MAYABRIDGE_STRING_PAGE_SIZE, 'y'));
+
+		// Some interned between publishes, so pages are appended to in place
+		bool ok = true;
+		for (size_t ii = 0; ii < strings.size(); ++ii)
+		{
+			ids.push_back(writer.internString(strings[ii].c_str()));
+			ok = ok && ids.back() != 0 && writer.internString(strings[ii].c_str()) == ids.back();
+			if (ii % 1000 == 0)
+			{
+				writer.publish();
+			}
+		}
+		writer.publish();
+
+		mb::Scene scene;
+		ok = ok && data.acquire(scene);
+		for (size_t ii = 0; ii < strings.size() && ok; ++ii)
+		{
+			ok = strings[ii] == scene.getString(&data, ids[ii]);
+		}
+		data.release();
+
+		return report("string pages", ok, "3001 strings, one longer than a page");
+	}
+
+	/// A snapshot file maps like the live buffer, as of the capture.
+	bool checkSnapshot()
+	{
+		Arena arena(64 << 20);
+		mb::SceneWriter writer;
+		writer.init(arena.data(), arena.size());
+		writer.addMaterial("lambert1");
+
+		mb::MeshData mesh;
+		makeMesh(mesh, 20);
+		char name[32];
+		for (uint32_t ii = 0; ii < 70; ++ii)
+		{
+			snprintf(name, sizeof(name), "model%u", ii);
+			addModel(writer, name, mesh);
+		}
+		writer.getHierarchy().resize(2);
+		writer.updateHierarchy(true);
+		writer.publish();
+
+		std::string path = (std::filesystem::temp_directory_path() / "scene_writer_bench.mbscene").string();
+		mb::SnapshotData snapshot;
+		writer.captureSnapshot(path.c_str(), snapshot);
+
+		// Edits after the capture aren't in the file
+		writer.removeModel(3);
+		for (uint32_t ii = 0; ii < 10; ++ii)
+		{
+			addModel(writer, "later", mesh);
+		}
+		writer.publish();
+
+		bool ok = mb::SceneWriter::writeSnapshot(snapshot);
+
+		mb::SharedBuffer file;
+		ok = ok && file.initFromFile(path.c_str());
+		if (ok)
+		{
+			mb::SharedData& data = *static_cast<mb::SharedData*>(file.getBuffer());
+
+			mb::Scene scene;
+			ok = data.isValid() && file.getSize() == data.capacity && data.acquire(scene)
+				&& scene.numModels == 70 && scene.numNodes == 2
+				&& strcmp(scene.getString(&data, scene.snapshotPath), path.c_str()) == 0;
+			for (uint32_t ii = 0; ii < scene.numModels && ok; ++ii)
+			{
+				const mb::Model& model = scene.getModel(&data, ii);
+				snprintf(name, sizeof(name), "model%u", ii);
+				ok = strcmp(scene.getString(&data, model.name), name) == 0
+					&& memcmp(model.mesh.getVertices(&data), mesh.vertices.data(), sizeof(mb::Vertex) * mesh.vertices.size()) == 0;
+			}
+			file.shutdown();
+		}
+
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		return report("snapshot file", ok, "written from the capture, mapped with initFromFile");
+	}
+
+	/// Loading and publishing a scene of many small models.
+	void runManyModels(uint32_t _count)
+	{
+		Arena arena(uint64_t(_count) * 4096 + (64 << 20));
+		mb::SceneWriter writer;
+		writer.init(arena.data(), arena.size());
+		mb::SharedData& data = *static_cast<mb::SharedData*>(arena.data());
+
+		Clock::time_point begin = Clock::now();
+		char name[32];
+		for (uint32_t ii = 0; ii < _count; ++ii)
+		{
+			uint32_t index = writer.addModel();
+			snprintf(name, sizeof(name), "model%u", ii);
+			writer.editModel(index).name = writer.internString(name);
+		}
+		double addMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+
+		begin = Clock::now();
+		writer.publish();
+		double publishMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+		drain(data);
+
+		// Every 100th model changes, only their chunks are written again
+		begin = Clock::now();
+		for (uint32_t ii = 0; ii < _count; ii += 100)
+		{
+			writer.editModel(ii).node = 0;
+		}
+		writer.publish();
+		double editMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+
+		// Half removed, then as many added back into the free slots
+		for (uint32_t ii = 0; ii < _count; ii += 2)
+		{
+			writer.removeModel(ii);
+		}
+		begin = Clock::now();
+		for (uint32_t ii = 0; ii < _count; ii += 2)
+		{
+			writer.addModel();
+		}
+		double refillMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+		writer.publish();
+		drain(data);
+
+		printf("%8u models | add %8.2f ms | publish %8.2f ms | 1%% edited %8.2f ms | refill half %8.2f ms\n",
+			_count, addMs, publishMs, editMs, refillMs);
+	}
+
+} // namespace
+
+int main(int _argc, char** _argv)
+{
+	(void)_argc;
+	(void)_argv;
+
+	bool ok = true;
+	ok = checkRoundTrip() && ok;
+	ok = checkFullArena() && ok;
+	ok = checkSlotReuse() && ok;
+	ok = checkRingOverflow() && ok;
+	ok = checkRetire() && ok;
+	ok = checkStrings() && ok;
+	ok = checkSnapshot() && ok;
+
+	runManyModels(10000);
+	runManyModels(100000);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,341 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+// Plays a stream the bridge recorded (see MAYABRIDGE_CONFIG_RECORD_PATH)
+// back into the shared buffer, for profiling a consumer without Maya:
+//
+//   stream_replay <stream file> [--speed <factor> | --max] [--wait] [--name <buffer>]
+//
+// Records go out at the pace they were recorded at, --speed divides the
+// gaps and --max drops them. The consumer is never outrun, a blob waits
+// until the consumer has let go of what was there before and an event
+// until the ring has room, like Maya would have. The time spent waiting
+// is what the consumer cost, and is reported along with the throughput.
+// Without a consumer the replay stalls once the ring is full. With --wait
+// the clock only starts once the consumer has acquired a scene or
+// consumed an event. Requests from the consumer are ignored.
+
+#include "stream_recorder.h"
+#include "maya-bridge/shared_buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <fstream>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	struct Totals
+	{
+		uint64_t blobs = 0;
+		uint64_t blobBytes = 0;
+		uint64_t scenes = 0;
+		uint64_t cameras = 0;
+		uint64_t events = 0;
+		double stallSeconds = 0.0; //!< Waiting for the consumer.
+	};
+
+	template<typename Ready>
+	void waitFor(Ready _ready, Totals& _totals)
+	{
+		if (_ready())
+		{
+			return;
+		}
+
+		Clock::time_point begin = Clock::now();
+		while (!_ready())
+		{
+			std::this_thread::yield();
+		}
+		_totals.stallSeconds += std::chrono::duration<double>(Clock::now() - begin).count();
+	}
+
+	bool readFile(const char* _path, std::vector<uint8_t>& _bytes)
+	{
+		std::ifstream file(_path, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return false;
+		}
+
+		_bytes.resize(size_t(file.tellg()));
+		file.seekg(0);
+		return bool(file.read(reinterpret_cast<char*>(_bytes.data()), _bytes.size()));
+	}
+
+	void publishScene(mb::SharedData& _data, const mb::Scene& _scene)
+	{
+		uint64_t sequence = _data.sequence.load(std::memory_order_relaxed);
+		_data.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		memcpy(&_data.scene, &_scene, sizeof(mb::Scene));
+
+		_data.sequence.store(sequence + 2, std::memory_order_seq_cst);
+	}
+
+	void publishCamera(mb::SharedData& _data, const mb::Camera& _camera)
+	{
+		mb::SharedCamera& shared = _data.camera;
+
+		uint64_t sequence = shared.sequence.load(std::memory_order_relaxed);
+		shared.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		memcpy(&shared.camera, &_camera, sizeof(mb::Camera));
+
+		shared.sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	void pushEvent(mb::SharedData& _data, const mb::Event& _event, Totals& _totals)
+	{
+		mb::EventRing& ring = _data.events;
+
+		uint64_t head = ring.head.load(std::memory_order_relaxed);
+		waitFor([&]() { return head - ring.tail.load(std::memory_order_acquire) < MAYABRIDGE_CONFIG_EVENT_RING_SIZE; }, _totals);
+
+		ring.events[head & (MAYABRIDGE_CONFIG_EVENT_RING_SIZE - 1)] = _event;
+		ring.head.store(head + 1, std::memory_order_release);
+	}
+
+	bool writeBlob(mb::SharedBuffer& _buffer, mb::SharedData& _data, const uint8_t* _record, uint64_t _size, Totals& _totals)
+	{
+		mb::StreamBlob blob;
+		memcpy(&blob, _record, sizeof(mb::StreamBlob));
+
+		uint64_t size = _size - sizeof(mb::StreamBlob);
+		if (blob.offset < sizeof(mb::SharedData) || blob.offset + size > _data.capacity || !_buffer.commit(blob.offset + size))
+		{
+			return false;
+		}
+
+		// Same test as SceneWriter::reclaim, against the reader of this run
+		waitFor([&]()
+		{
+			uint64_t readSequence = _data.readSequence.load(std::memory_order_seq_cst);
+			return (readSequence == 0 || readSequence >= blob.readSequence)
+				&& _data.events.tail.load(std::memory_order_acquire) >= blob.eventTail;
+		}, _totals);
+
+		uint8_t* base = static_cast<uint8_t*>(_buffer.getBuffer());
+		memcpy(base + blob.offset, _record + sizeof(mb::StreamBlob), size);
+		_totals.blobs += 1;
+		_totals.blobBytes += size;
+		return true;
+	}
+
+} // namespace
+
+int main(int _argc, char** _argv)
+{
+	const char* path = NULL;
+	const char* name = "maya-bridge-write";
+	double speed = 1.0;
+	bool max = false;
+	bool wait = false;
+
+	for (int ii = 1; ii < _argc; ++ii)
+	{
+		if (strcmp(_argv[ii], "--speed") == 0 && ii + 1 < _argc)
+		{
+			speed = atof(_argv[++ii]);
+		}
+		else if (strcmp(_argv[ii], "--max") == 0)
+		{
+			max = true;
+		}
+		else if (strcmp(_argv[ii], "--wait") == 0)
+		{
+			wait = true;
+		}
+		else if (strcmp(_argv[ii], "--name") == 0 && ii + 1 < _argc)
+		{
+			name = _argv[++ii];
+		}
+		else if (path == NULL && _argv[ii][0] != '-')
+		{
+			path = _argv[ii];
+		}
+		else
+		{
+			path = NULL;
+			break;
+		}
+	}
+
+	if (path == NULL || !(speed > 0.0))
+	{
+		fprintf(stderr, "Usage: stream_replay <stream file> [--speed <factor> | --max] [--wait] [--name <buffer>]\n");
+		return 1;
+	}
+
+	// Read up front so the disk doesn't pace the replay
+	std::vector<uint8_t> stream;
+	if (!readFile(path, stream) || stream.size() < sizeof(mb::StreamHeader))
+	{
+		fprintf(stderr, "Failed to read %s\n", path);
+		return 1;
+	}
+
+	mb::StreamHeader header;
+	memcpy(&header, stream.data(), sizeof(mb::StreamHeader));
+	if (header.magic != MAYABRIDGE_STREAM_MAGIC || header.version != MAYABRIDGE_STREAM_VERSION)
+	{
+		fprintf(stderr, "%s is not a stream recording\n", path);
+		return 1;
+	}
+	if (header.sceneVersion != MAYABRIDGE_SCENE_VERSION)
+	{
+		fprintf(stderr, "%s was recorded with scene version %u, this is %u\n", path, header.sceneVersion, MAYABRIDGE_SCENE_VERSION);
+		return 1;
+	}
+	if (header.capacity < sizeof(mb::SharedData))
+	{
+		fprintf(stderr, "%s has a bad capacity\n", path);
+		return 1;
+	}
+
+	mb::SharedBuffer buffer;
+	if (!buffer.init(name, header.capacity, MAYABRIDGE_BUFFER_HUGE_PAGES))
+	{
+		fprintf(stderr, "Failed to map %s\n", name);
+		return 1;
+	}
+
+	// A fresh buffer where the recording started, as if Maya had just
+	// started the session
+	uint8_t* base = static_cast<uint8_t*>(buffer.getBuffer());
+	mb::SharedData* data = new (base) mb::SharedData();
+	data->capacity = header.capacity;
+	data->sequence.store(header.sequence, std::memory_order_relaxed);
+	data->camera.sequence.store(header.cameraSequence, std::memory_order_relaxed);
+	memcpy(&data->camera.camera, &header.camera, sizeof(mb::Camera));
+	data->events.head.store(header.eventPosition, std::memory_order_relaxed);
+	data->events.tail.store(header.eventPosition, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	printf("replaying %s into %s, %s\n", path, name, max ? "max speed" : speed == 1.0 ? "recorded speed" : "accelerated");
+
+	if (wait)
+	{
+		printf("waiting for a consumer\n");
+		while (data->readSequence.load(std::memory_order_acquire) == 0 && data->events.tail.load(std::memory_order_acquire) == header.eventPosition)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	Totals totals;
+	uint64_t recorded = 0;
+	Clock::time_point start = Clock::now();
+
+	size_t position = sizeof(mb::StreamHeader);
+	while (position + sizeof(mb::StreamRecord) <= stream.size())
+	{
+		mb::StreamRecord record;
+		memcpy(&record, stream.data() + position, sizeof(mb::StreamRecord));
+		position += sizeof(mb::StreamRecord);
+
+		// The recording stopped halfway through this one
+		if (record.size > stream.size() - position)
+		{
+			break;
+		}
+		const uint8_t* payload = stream.data() + position;
+		position += size_t(record.size);
+
+		if (!max)
+		{
+			std::this_thread::sleep_until(start + std::chrono::nanoseconds(uint64_t(double(record.time) / speed)));
+		}
+		recorded = record.time;
+
+		bool valid = true;
+		switch (record.type)
+		{
+		case MAYABRIDGE_STREAM_RECORD_BLOB:
+			valid = record.size >= sizeof(mb::StreamBlob) && writeBlob(buffer, *data, payload, record.size, totals);
+			break;
+
+		case MAYABRIDGE_STREAM_RECORD_SCENE:
+			{
+				valid = record.size == sizeof(mb::Scene);
+				if (valid)
+				{
+					mb::Scene scene;
+					memcpy(&scene, payload, sizeof(mb::Scene));
+					publishScene(*data, scene);
+					totals.scenes += 1;
+				}
+			}
+			break;
+
+		case MAYABRIDGE_STREAM_RECORD_CAMERA:
+			{
+				valid = record.size == sizeof(mb::Camera);
+				if (valid)
+				{
+					mb::Camera camera;
+					memcpy(&camera, payload, sizeof(mb::Camera));
+					publishCamera(*data, camera);
+					totals.cameras += 1;
+				}
+			}
+			break;
+
+		case MAYABRIDGE_STREAM_RECORD_EVENT:
+			{
+				valid = record.size == sizeof(mb::Event);
+				if (valid)
+				{
+					mb::Event event;
+					memcpy(&event, payload, sizeof(mb::Event));
+					pushEvent(*data, event, totals);
+					totals.events += 1;
+				}
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		if (!valid)
+		{
+			fprintf(stderr, "Bad record at byte %zu, stopping\n", position - size_t(record.size) - sizeof(mb::StreamRecord));
+			break;
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	double recordedSeconds = double(recorded) * 1e-9;
+
+	printf("recorded %8.3f s | replayed %8.3f s | consumer stalls %8.3f s\n", recordedSeconds, seconds, totals.stallSeconds);
+	printf("%8llu scenes %8llu cameras %8llu events | %8.1f publishes/s\n",
+		(unsigned long long)totals.scenes, (unsigned long long)totals.cameras, (unsigned long long)totals.events,
+		seconds > 0.0 ? double(totals.scenes + totals.cameras) / seconds : 0.0);
+	printf("%8llu blobs %10.2f MB | %8.1f MB/s\n",
+		(unsigned long long)totals.blobs, double(totals.blobBytes) / (1024.0 * 1024.0),
+		seconds > 0.0 ? double(totals.blobBytes) / (1024.0 * 1024.0) / seconds : 0.0);
+
+	// The name goes away with this process, so a consumer that is still
+	// reading gets to drain the ring first
+	uint64_t head = data->events.head.load(std::memory_order_relaxed);
+	while (data->events.tail.load(std::memory_order_acquire) != header.eventPosition && data->events.tail.load(std::memory_order_acquire) != head)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	buffer.shutdown();
+	return 0;
+}
@@ -0,0 +1,351 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+// Reports how fast textures compress and how close the blocks decode to
+// the source, and checks that a texture survives the round trip through
+// the texture cache:
+//
+//   texture_bench [cache directory]
+
+#include "texture_encoder.h"
+#include "texture_cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+namespace
+{
+	void decodeColorBlock(const uint8_t* _block, bool _opaque, uint8_t _out[16][4])
+	{
+		uint16_t c0 = uint16_t(_block[0] | (_block[1] << 8));
+		uint16_t c1 = uint16_t(_block[2] | (_block[3] << 8));
+
+		int palette[4][4];
+		for (int ii = 0; ii < 2; ++ii)
+		{
+			uint16_t c = ii == 0 ? c0 : c1;
+			int r = (c >> 11) & 31;
+			int g = (c >> 5) & 63;
+			int b = c & 31;
+			palette[ii][0] = (r << 3) | (r >> 2);
+			palette[ii][1] = (g << 2) | (g >> 4);
+			palette[ii][2] = (b << 3) | (b >> 2);
+			palette[ii][3] = 255;
+		}
+		for (int cc = 0; cc < 4; ++cc)
+		{
+			if (c0 > c1 || _opaque)
+			{
+				palette[2][cc] = (2 * palette[0][cc] + palette[1][cc]) / 3;
+				palette[3][cc] = (palette[0][cc] + 2 * palette[1][cc]) / 3;
+			}
+			else
+			{
+				palette[2][cc] = (palette[0][cc] + palette[1][cc]) / 2;
+				palette[3][cc] = 0;
+			}
+		}
+
+		uint32_t bits;
+		memcpy(&bits, _block + 4, 4);
+		for (int ii = 0; ii < 16; ++ii)
+		{
+			for (int cc = 0; cc < 4; ++cc)
+			{
+				_out[ii][cc] = uint8_t(palette[(bits >> (ii * 2)) & 3][cc]);
+			}
+		}
+	}
+
+	void decodeChannelBlock(const uint8_t* _block, int _channel, uint8_t _out[16][4])
+	{
+		int r0 = _block[0];
+		int r1 = _block[1];
+		int palette[8] = { r0, r1 };
+		for (int kk = 2; kk < 8; ++kk)
+		{
+			palette[kk] = r0 > r1 ? ((8 - kk) * r0 + (kk - 1) * r1) / 7 : kk < 6 ? ((6 - kk) * r0 + (kk - 1) * r1) / 5 : kk == 6 ? 0 : 255;
+		}
+
+		uint64_t bits = 0;
+		for (int ii = 0; ii < 6; ++ii)
+		{
+			bits |= uint64_t(_block[2 + ii]) << (ii * 8);
+		}
+		for (int ii = 0; ii < 16; ++ii)
+		{
+			_out[ii][_channel] = uint8_t(palette[(bits >> (ii * 3)) & 7]);
+		}
+	}
+
+	/// Mode 6 only, the one the encoder writes.
+	///
+	bool decodeBc7Block(const uint8_t* _block, uint8_t _out[16][4])
+	{
+		uint32_t position = 0;
+		auto read = [&](uint32_t _bits)
+		{
+			uint32_t value = 0;
+			for (uint32_t ii = 0; ii < _bits; ++ii, ++position)
+			{
+				value |= uint32_t((_block[position >> 3] >> (position & 7)) & 1) << ii;
+			}
+			return value;
+		};
+
+		if (read(7) != (1 << 6))
+		{
+			return false;
+		}
+
+		uint32_t endpoints[2][4];
+		for (int cc = 0; cc < 4; ++cc)
+		{
+			endpoints[0][cc] = read(7);
+			endpoints[1][cc] = read(7);
+		}
+		uint32_t p0 = read(1);
+		uint32_t p1 = read(1);
+
+		static const int s_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+		for (int ii = 0; ii < 16; ++ii)
+		{
+			int index = int(read(ii == 0 ? 3 : 4));
+			for (int cc = 0; cc < 4; ++cc)
+			{
+				int e0 = int((endpoints[0][cc] << 1) | p0);
+				int e1 = int((endpoints[1][cc] << 1) | p1);
+				_out[ii][cc] = uint8_t((e0 * (64 - s_weights[index]) + e1 * s_weights[index] + 32) >> 6);
+			}
+		}
+		return true;
+	}
+
+	/// Decodes mip 0 of _format back to RGBA8, channels the format doesn't
+	/// have stay as they were in _image.
+	///
+	bool decompress(const uint8_t* _blocks, uint32_t _format, mb::TextureImage& _image)
+	{
+		uint32_t blockSize = _format == MAYABRIDGE_TEXTURE_FORMAT_BC1 || _format == MAYABRIDGE_TEXTURE_FORMAT_BC4 ? 8 : 16;
+		uint32_t numBlocksX = (_image.width + 3) / 4;
+		uint32_t numBlocksY = (_image.height + 3) / 4;
+
+		for (uint32_t by = 0; by < numBlocksY; ++by)
+		{
+			for (uint32_t bx = 0; bx < numBlocksX; ++bx)
+			{
+				const uint8_t* block = _blocks + (size_t(by) * numBlocksX + bx) * blockSize;
+
+				uint8_t texels[16][4];
+				for (uint32_t ii = 0; ii < 16; ++ii)
+				{
+					uint32_t x = std::min(bx * 4 + ii % 4, _image.width - 1);
+					uint32_t y = std::min(by * 4 + ii / 4, _image.height - 1);
+					memcpy(texels[ii], &_image.pixels[(size_t(y) * _image.width + x) * 4], 4);
+				}
+
+				if (_format == MAYABRIDGE_TEXTURE_FORMAT_BC1)
+				{
+					decodeColorBlock(block, false, texels);
+				}
+				else if (_format == MAYABRIDGE_TEXTURE_FORMAT_BC3)
+				{
+					decodeColorBlock(block + 8, true, texels);
+					decodeChannelBlock(block, 3, texels);
+				}
+				else if (_format == MAYABRIDGE_TEXTURE_FORMAT_BC4)
+				{
+					decodeChannelBlock(block, 0, texels);
+				}
+				else if (_format == MAYABRIDGE_TEXTURE_FORMAT_BC5)
+				{
+					decodeChannelBlock(block, 0, texels);
+					decodeChannelBlock(block + 8, 1, texels);
+				}
+				else if (!decodeBc7Block(block, texels))
+				{
+					return false;
+				}
+
+				for (uint32_t ii = 0; ii < 16; ++ii)
+				{
+					uint32_t x = bx * 4 + ii % 4;
+					uint32_t y = by * 4 + ii / 4;
+					if (x < _image.width && y < _image.height)
+					{
+						memcpy(&_image.pixels[(size_t(y) * _image.width + x) * 4], texels[ii], 4);
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	double getPsnr(const mb::TextureImage& _a, const mb::TextureImage& _b, uint32_t _channels)
+	{
+		double sum = 0.0;
+		for (size_t ii = 0; ii < _a.pixels.size(); ++ii)
+		{
+			if (ii % 4 < _channels)
+			{
+				double d = double(_a.pixels[ii]) - double(_b.pixels[ii]);
+				sum += d * d;
+			}
+		}
+		double mse = sum / (double(_a.pixels.size() / 4) * _channels);
+		return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+	}
+
+	/// Smooth color ramps with soft noise, an alpha ramp, like painted albedo.
+	///
+	void makeAlbedo(mb::TextureImage& _image, uint32_t _size)
+	{
+		std::mt19937 random(1);
+		std::uniform_int_distribution<int> noise(-6, 6);
+
+		_image.width = _size;
+		_image.height = _size;
+		_image.pixels.resize(size_t(_size) * _size * 4);
+		for (uint32_t yy = 0; yy < _size; ++yy)
+		{
+			for (uint32_t xx = 0; xx < _size; ++xx)
+			{
+				uint8_t* texel = &_image.pixels[(size_t(yy) * _size + xx) * 4];
+				float u = float(xx) / float(_size);
+				float v = float(yy) / float(_size);
+				texel[0] = uint8_t(std::min(std::max(int(128.0f + 100.0f * sinf(u * 9.0f)) + noise(random), 0), 255));
+				texel[1] = uint8_t(std::min(std::max(int(255.0f * v) + noise(random), 0), 255));
+				texel[2] = uint8_t(std::min(std::max(int(64.0f + 60.0f * cosf((u + v) * 13.0f)) + noise(random), 0), 255));
+				texel[3] = uint8_t(255.0f * u);
+			}
+		}
+	}
+
+	/// Tangent space normals of a field of bumps.
+	///
+	void makeNormalMap(mb::TextureImage& _image, uint32_t _size)
+	{
+		_image.width = _size;
+		_image.height = _size;
+		_image.pixels.resize(size_t(_size) * _size * 4);
+		for (uint32_t yy = 0; yy < _size; ++yy)
+		{
+			for (uint32_t xx = 0; xx < _size; ++xx)
+			{
+				float u = float(xx) / float(_size) * 40.0f;
+				float v = float(yy) / float(_size) * 40.0f;
+				float n[3] = { -0.6f * cosf(u) * sinf(v), -0.6f * sinf(u) * cosf(v), 1.0f };
+				float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+				uint8_t* texel = &_image.pixels[(size_t(yy) * _size + xx) * 4];
+				for (int cc = 0; cc < 3; ++cc)
+				{
+					texel[cc] = uint8_t((n[cc] / length * 0.5f + 0.5f) * 255.0f + 0.5f);
+				}
+				texel[3] = 255;
+			}
+		}
+	}
+
+	void run(const char* _name, const mb::TextureImage& _image, uint32_t _slot, bool _bc7)
+	{
+		uint32_t flags = 0;
+		uint32_t format = mb::chooseTextureFormat(_slot, _image, _bc7, flags);
+
+		std::vector<uint8_t> files[2];
+		double ms = 0.0;
+		for (std::vector<uint8_t>& file : files)
+		{
+			auto start = std::chrono::steady_clock::now();
+			mb::encodeTexture(_image, format, flags, file);
+			ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		const mb::TextureHeader& header = *reinterpret_cast<const mb::TextureHeader*>(files[0].data());
+		mb::TextureImage decoded = _image;
+		bool valid = header.isValid() && decompress(header.getMip(files[0].data(), 0), format, decoded);
+
+		static const char* s_formats[] = { "BC1", "BC3", "BC4", "BC5", "BC7" };
+		uint32_t channels = format == MAYABRIDGE_TEXTURE_FORMAT_BC4 ? 1 : format == MAYABRIDGE_TEXTURE_FORMAT_BC5 ? 2 : format == MAYABRIDGE_TEXTURE_FORMAT_BC1 ? 3 : 4;
+		double pixels = double(_image.width) * _image.height * 4.0 / 3.0;
+		printf("%-24s %s %2u mips %9zu bytes | %6.2f dB | encode %8.2f ms %6.1f Mpix/s | %s%s\n",
+			_name,
+			s_formats[format],
+			header.numMips,
+			files[0].size(),
+			getPsnr(_image, decoded, channels),
+			ms,
+			pixels / (ms * 1000.0),
+			files[0] == files[1] ? "deterministic" : "NOT DETERMINISTIC",
+			valid ? "" : ", INVALID");
+	}
+
+	/// Stores an encoded texture and reads it back through the cache.
+	///
+	bool checkCache(const std::string& _directory, const mb::TextureImage& _image)
+	{
+		mb::TextureCache cache;
+		if (!cache.init(_directory))
+		{
+			return false;
+		}
+
+		std::string source = (std::filesystem::path(_directory) / "source.raw").string();
+		{
+			std::ofstream file(source, std::ios::binary);
+			file.write(reinterpret_cast<const char*>(_image.pixels.data()), _image.pixels.size());
+		}
+
+		uint64_t key = 0;
+		uint64_t bc1Key = 0;
+		if (!cache.getKey(source, MAYABRIDGE_TEXTURE_BASE_COLOR, true, key) || !cache.getKey(source, MAYABRIDGE_TEXTURE_BASE_COLOR, false, bc1Key) || key == bc1Key)
+		{
+			return false;
+		}
+
+		std::vector<uint8_t> file;
+		mb::encodeTexture(_image, MAYABRIDGE_TEXTURE_FORMAT_BC7, MAYABRIDGE_TEXTURE_FLAG_SRGB, file);
+		bool stored = cache.store(key, file) && cache.contains(key) && !cache.contains(bc1Key);
+
+		std::ifstream cached(cache.getPath(key), std::ios::binary);
+		std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(cached)), std::istreambuf_iterator<char>());
+
+		std::error_code error;
+		std::filesystem::remove(source, error);
+		std::filesystem::remove(cache.getPath(key), error);
+		return stored && bytes == file;
+	}
+
+} // namespace
+
+int main(int _argc, char** _argv)
+{
+	mb::TextureImage albedo;
+	makeAlbedo(albedo, 1024);
+	mb::TextureImage normal;
+	makeNormalMap(normal, 1024);
+	mb::TextureImage odd;
+	makeAlbedo(odd, 333);
+
+	run("albedo 1024", albedo, MAYABRIDGE_TEXTURE_BASE_COLOR, true);
+	run("albedo 1024", albedo, MAYABRIDGE_TEXTURE_BASE_COLOR, false);
+	run("emissive 1024", albedo, MAYABRIDGE_TEXTURE_EMISSIVE, false);
+	run("roughness 1024", albedo, MAYABRIDGE_TEXTURE_ROUGHNESS, true);
+	run("normal 1024", normal, MAYABRIDGE_TEXTURE_NORMAL, true);
+	run("albedo 333", odd, MAYABRIDGE_TEXTURE_BASE_COLOR, true);
+
+	std::string directory = _argc > 1 ? _argv[1] : (std::filesystem::temp_directory_path() / "maya-bridge-texture-bench").string();
+	printf("texture cache round trip: %s\n", checkCache(directory, odd) ? "ok" : "FAILED");
+
+	return 0;
+}
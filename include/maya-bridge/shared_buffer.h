@@ -6,26 +6,66 @@
 #pragma once
 
 #include <string>
-#include <mutex>
 #include <cstring>
+#include <stdint.h> // uint32_t
 
-#include <windows.h> // Only contains windows implementation rn
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif // defined(_WIN32)
+
+/// Flags for SharedBuffer::init. Flags that are not supported by the
+/// platform or the system configuration are silently ignored.
+#define MAYABRIDGE_BUFFER_NONE       UINT32_C(0x00000000)
+#define MAYABRIDGE_BUFFER_HUGE_PAGES UINT32_C(0x00000001) //!< Back the mapping with huge pages.
+#define MAYABRIDGE_BUFFER_POPULATE   UINT32_C(0x00000002) //!< Pre-fault the whole mapping in init.
+
+///
+#ifndef MAYABRIDGE_CONFIG_HUGETLBFS_PATH
+#define MAYABRIDGE_CONFIG_HUGETLBFS_PATH "/dev/hugepages"
+#endif // MAYABRIDGE_CONFIG_HUGETLBFS_PATH
+
+///
+#ifndef MAYABRIDGE_CONFIG_HUGE_PAGE_SIZE
+#define MAYABRIDGE_CONFIG_HUGE_PAGE_SIZE (2u << 20)
+#endif // MAYABRIDGE_CONFIG_HUGE_PAGE_SIZE
+
+/// Step SharedBuffer::commit commits the mapping in on Windows, where init
+/// only reserves it. init commits the first step, for the header.
+#ifndef MAYABRIDGE_CONFIG_COMMIT_SIZE
+#define MAYABRIDGE_CONFIG_COMMIT_SIZE (16u << 20)
+#endif // MAYABRIDGE_CONFIG_COMMIT_SIZE
 
 namespace mb
 {
-    class SharedBuffer 
+    class SharedBuffer
     {
     public:
-        bool init(const char* name, uint32_t size) 
+        bool init(const char* name, uint64_t size, uint32_t flags = MAYABRIDGE_BUFFER_NONE)
         {
+            // Has to fit the address space, a 32-bit process can't map 4GB
+            if (uint64_t(size_t(size)) != size)
+            {
+                return false;
+            }
+
             m_name = std::string(name);
             m_size = size;
+            m_flags = flags;
 
+#if defined(_WIN32)
+            // Reserved rather than committed, so the mapping isn't charged
+            // against the pagefile until the arena grows into it
             m_filemap = CreateFileMapping(
                 INVALID_HANDLE_VALUE,
                 nullptr,
-                PAGE_READWRITE,
-                0,
+                PAGE_READWRITE | SEC_RESERVE,
+                static_cast<DWORD>(m_size >> 32),
                 static_cast<DWORD>(m_size),
                 m_name.c_str()
             );
@@ -35,18 +75,157 @@ namespace mb
                 return false;
             }
 
-            m_buffer = MapViewOfFile(m_filemap, FILE_MAP_ALL_ACCESS, 0, 0, m_size);
+            m_buffer = MapViewOfFile(m_filemap, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(m_size));
+            if (!m_buffer)
+            {
+                CloseHandle(m_filemap);
+                return false;
+            }
+
+            m_committed = 0;
+            if (!commit(m_size < MAYABRIDGE_CONFIG_COMMIT_SIZE ? m_size : MAYABRIDGE_CONFIG_COMMIT_SIZE))
+            {
+                UnmapViewOfFile(m_buffer);
+                CloseHandle(m_filemap);
+                m_buffer = nullptr;
+                return false;
+            }
+
+            return true;
+#else
+            // Huge pages can't be requested for a regular POSIX shared memory
+            // object, MAP_HUGETLB only applies to anonymous memory which other
+            // processes can't attach to. Explicit huge pages are therefore taken
+            // from a hugetlbfs mount when one is configured, otherwise we fall back
+            // to a tmpfs object and ask for transparent huge pages.
+            if (m_flags & MAYABRIDGE_BUFFER_HUGE_PAGES)
+            {
+                if (mapHugeTlbFs())
+                {
+                    return true;
+                }
+            }
+
+            return mapShm();
+#endif // defined(_WIN32)
+        }
+
+        /// Maps a snapshot file the bridge wrote, instead of the live buffer.
+        /// The mapping is private, what the reader writes into it (like
+        /// SharedData::acquire does) never reaches the file.
+        bool initFromFile(const char* path)
+        {
+            m_name = std::string(path);
+            m_flags = MAYABRIDGE_BUFFER_NONE;
+
+#if defined(_WIN32)
+            HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+            {
+                return false;
+            }
+
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || uint64_t(SIZE_T(size.QuadPart)) != uint64_t(size.QuadPart))
+            {
+                CloseHandle(file);
+                return false;
+            }
+
+            // The mapping keeps the file open
+            m_filemap = CreateFileMapping(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+            CloseHandle(file);
+            if (!m_filemap)
+            {
+                return false;
+            }
+
+            m_size = uint64_t(size.QuadPart);
+            m_committed = m_size;
+            m_buffer = MapViewOfFile(m_filemap, FILE_MAP_COPY, 0, 0, static_cast<SIZE_T>(m_size));
             if (!m_buffer)
             {
                 CloseHandle(m_filemap);
+                m_filemap = nullptr;
+                return false;
+            }
+
+            return true;
+#else
+            int fd = open(path, O_RDONLY);
+            if (fd == -1)
+            {
+                return false;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) == -1 || st.st_size <= 0 || uint64_t(size_t(st.st_size)) != uint64_t(st.st_size))
+            {
+                close(fd);
+                return false;
+            }
+
+            void* buffer = mmap(nullptr, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (buffer == MAP_FAILED)
+            {
+                return false;
+            }
+
+            m_buffer = buffer;
+            m_size = uint64_t(st.st_size);
+            m_mappedSize = size_t(st.st_size);
+            m_owner = false;
+            m_hugeTlbFs = false;
+            return true;
+#endif // defined(_WIN32)
+        }
+
+        uint64_t getSize() const
+        {
+            return m_size;
+        }
+
+        /// Makes the first size bytes of the mapping usable before they are
+        /// written. Only does anything on Windows, where init reserves the
+        /// mapping, POSIX objects are backed as pages are first touched.
+        /// Not thread safe, the caller serializes it.
+        bool commit(uint64_t size)
+        {
+#if defined(_WIN32)
+            if (size <= m_committed)
+            {
+                return true;
+            }
+
+            uint64_t step = MAYABRIDGE_CONFIG_COMMIT_SIZE;
+            uint64_t end = (size + step - 1) / step * step;
+            end = end < m_size ? end : m_size;
+            if (size > end)
+            {
                 return false;
             }
 
+            uint8_t* begin = static_cast<uint8_t*>(m_buffer) + m_committed;
+            if (!VirtualAlloc(begin, static_cast<SIZE_T>(end - m_committed), MEM_COMMIT, PAGE_READWRITE))
+            {
+                // The other process created the mapping committed
+                MEMORY_BASIC_INFORMATION info;
+                if (VirtualQuery(begin, &info, sizeof(info)) == 0 || info.State != MEM_COMMIT)
+                {
+                    return false;
+                }
+            }
+            m_committed = end;
+#else
+            (void)size;
+#endif // defined(_WIN32)
             return true;
         }
 
-        void shutdown() 
+        void shutdown()
         {
+#if defined(_WIN32)
             if (m_buffer)
             {
                 UnmapViewOfFile(m_buffer);
@@ -58,11 +237,37 @@ namespace mb
                 CloseHandle(m_filemap);
                 m_filemap = nullptr;
             }
+#else
+            if (m_buffer)
+            {
+                munmap(m_buffer, m_mappedSize);
+                m_buffer = nullptr;
+                m_mappedSize = 0;
+            }
+
+            // The POSIX object outlives its handles, unlike a Windows file mapping.
+            // Whoever created it removes the name again, mappings already made by
+            // the other process stay valid until it unmaps them.
+            if (m_owner)
+            {
+                if (m_hugeTlbFs)
+                {
+                    unlink(m_path.c_str());
+                }
+                else
+                {
+                    shm_unlink(m_path.c_str());
+                }
+                m_owner = false;
+            }
+#endif // defined(_WIN32)
         }
 
-        bool write(const void* data, uint32_t size) 
+        /// Plain copies, the buffer doesn't synchronize with the other process.
+        /// Anything read while it is being written has to be published through
+        /// a protocol in the data itself, see SharedData::acquire.
+        bool write(const void* data, size_t size)
         {
-            std::lock_guard<std::mutex> lock(m_mutex);
             if (size > m_size)
             {
                 return false;
@@ -71,9 +276,8 @@ namespace mb
             return true;
         }
 
-        bool read(void* data, uint32_t size) 
+        bool read(void* data, size_t size)
         {
-            std::lock_guard<std::mutex> lock(m_mutex);
             if (size > m_size)
             {
                 return false;
@@ -82,17 +286,178 @@ namespace mb
             return true;
         }
 
-        void* getBuffer() 
+        void* getBuffer()
         {
             return m_buffer;
         }
 
     private:
+#if !defined(_WIN32)
+        bool mapHugeTlbFs()
+        {
+            const size_t hugePageSize = MAYABRIDGE_CONFIG_HUGE_PAGE_SIZE;
+            const size_t size = (size_t(m_size) + hugePageSize - 1) & ~(hugePageSize - 1);
+
+            m_path = std::string(MAYABRIDGE_CONFIG_HUGETLBFS_PATH) + "/" + m_name;
+
+            int fd = open(m_path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+            bool owner = fd != -1;
+            if (!owner && errno == EEXIST)
+            {
+                fd = open(m_path.c_str(), O_RDWR, 0666);
+            }
+            if (fd == -1)
+            {
+                return false;
+            }
+
+            if (!resize(fd, size))
+            {
+                close(fd);
+                if (owner)
+                {
+                    unlink(m_path.c_str());
+                }
+                return false;
+            }
+
+            void* buffer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | populateFlag(), fd, 0);
+            close(fd);
+            if (buffer == MAP_FAILED)
+            {
+                if (owner)
+                {
+                    unlink(m_path.c_str());
+                }
+                return false;
+            }
+
+            m_buffer = buffer;
+            m_mappedSize = size;
+            m_owner = owner;
+            m_hugeTlbFs = true;
+            return true;
+        }
+
+        bool mapShm()
+        {
+            m_path = "/" + m_name;
+
+            int fd = shm_open(m_path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+            bool owner = fd != -1;
+            if (!owner && errno == EEXIST)
+            {
+                fd = shm_open(m_path.c_str(), O_RDWR, 0666);
+            }
+            if (fd == -1)
+            {
+                return false;
+            }
+
+            if (!resize(fd, size_t(m_size)))
+            {
+                close(fd);
+                if (owner)
+                {
+                    shm_unlink(m_path.c_str());
+                }
+                return false;
+            }
+
+            // Transparent huge pages are assigned at fault time, so the mapping is
+            // advised before it is populated rather than using MAP_POPULATE.
+            const bool transparentHugePages = (m_flags & MAYABRIDGE_BUFFER_HUGE_PAGES) != 0;
+            const int flags = MAP_SHARED | (transparentHugePages ? 0 : populateFlag());
+
+            void* buffer = mmap(nullptr, size_t(m_size), PROT_READ | PROT_WRITE, flags, fd, 0);
+            close(fd);
+            if (buffer == MAP_FAILED)
+            {
+                if (owner)
+                {
+                    shm_unlink(m_path.c_str());
+                }
+                return false;
+            }
+
+            m_buffer = buffer;
+            m_mappedSize = size_t(m_size);
+            m_owner = owner;
+            m_hugeTlbFs = false;
+
+            if (transparentHugePages)
+            {
+#if defined(MADV_HUGEPAGE)
+                madvise(m_buffer, m_mappedSize, MADV_HUGEPAGE);
+#endif // defined(MADV_HUGEPAGE)
+
+                if (m_flags & MAYABRIDGE_BUFFER_POPULATE)
+                {
+                    populate();
+                }
+            }
+
+            return true;
+        }
+
+        bool resize(int fd, size_t size)
+        {
+            struct stat st;
+            if (fstat(fd, &st) == -1)
+            {
+                return false;
+            }
+
+            // Only ever grow, the other process may already have sized the object.
+            if (size_t(st.st_size) < size)
+            {
+                return ftruncate(fd, off_t(size)) != -1;
+            }
+            return true;
+        }
+
+        void populate()
+        {
+#if defined(MADV_POPULATE_WRITE)
+            if (madvise(m_buffer, m_mappedSize, MADV_POPULATE_WRITE) == 0)
+            {
+                return;
+            }
+#endif // defined(MADV_POPULATE_WRITE)
+
+            // Reading is enough to fault the pages in, writing would clobber
+            // whatever the other process has already published.
+            const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+            const volatile uint8_t* bytes = static_cast<const volatile uint8_t*>(m_buffer);
+            for (size_t offset = 0; offset < m_mappedSize; offset += pageSize)
+            {
+                (void)bytes[offset];
+            }
+        }
+
+        int populateFlag() const
+        {
+#if defined(MAP_POPULATE)
+            return (m_flags & MAYABRIDGE_BUFFER_POPULATE) ? MAP_POPULATE : 0;
+#else
+            return 0;
+#endif // defined(MAP_POPULATE)
+        }
+#endif // !defined(_WIN32)
+
         std::string m_name;
-        std::mutex m_mutex;
         void* m_buffer = nullptr;
-        uint32_t m_size = 0;
+        uint64_t m_size = 0;
+        uint32_t m_flags = MAYABRIDGE_BUFFER_NONE;
+#if defined(_WIN32)
         HANDLE m_filemap = nullptr;
+        uint64_t m_committed = 0; //!< Bytes at the start that commit made usable.
+#else
+        std::string m_path;
+        size_t m_mappedSize = 0;
+        bool m_owner = false;
+        bool m_hugeTlbFs = false;
+#endif // defined(_WIN32)
     };
 
 } // namespace mb
@@ -5,41 +5,204 @@
 
 #pragma once
 
+#include <math.h>   // sqrtf
+#include <stddef.h> // offsetof
 #include <stdint.h> // uint32_t
+#include <string.h> // memset
 
- ///
-#ifndef MAYABRIDGE_CONFIG_MAX_MATERIALS
-#define MAYABRIDGE_CONFIG_MAX_MATERIALS 3
-#endif // MAYABRIDGE_CONFIG_MAX_MATERIALS
+#include <atomic>
 
-///
-#ifndef MAYABRIDGE_CONFIG_MAX_MODELS
-#define MAYABRIDGE_CONFIG_MAX_MODELS 3
-#endif // MAYABRIDGE_CONFIG_MAX_MODELS
+/// Default size of the shared scene mapping, the mayaBridgeSceneCapacityMb
+/// optionVar overrides it. Only the part in use is ever touched, so this is a
+/// reservation rather than what the scene costs. Consumers map
+/// SharedData::capacity bytes.
+#ifndef MAYABRIDGE_CONFIG_SCENE_CAPACITY
+#define MAYABRIDGE_CONFIG_SCENE_CAPACITY (UINT64_C(1) << 30)
+#endif // MAYABRIDGE_CONFIG_SCENE_CAPACITY
 
-///
-#ifndef MAYABRIDGE_CONFIG_MAX_SUBMESHES
-#define MAYABRIDGE_CONFIG_MAX_SUBMESHES 30
-#endif // MAYABRIDGE_CONFIG_MAX_SUBMESHES
+/// Number of events in the shared ring, must be a power of two.
+#ifndef MAYABRIDGE_CONFIG_EVENT_RING_SIZE
+#define MAYABRIDGE_CONFIG_EVENT_RING_SIZE 4096
+#endif // MAYABRIDGE_CONFIG_EVENT_RING_SIZE
+
+/// Requests the consumer writes to SharedData::request. 0x00020000 and
+/// 0x00040000 were RECEIVED and SAVE_SCENE and are never reused, so an old
+/// consumer's request can't be taken for something else.
+#define MAYABRIDGE_MESSAGE_NONE         UINT32_C(0x00010000)
+#define MAYABRIDGE_MESSAGE_RELOAD_SCENE UINT32_C(0x00030000)
+#define MAYABRIDGE_MESSAGE_VERTEX_LAYOUT UINT32_C(0x00050000) //!< Low 16 bits are a MAYABRIDGE_VERTEX_LAYOUT_*, the scene is reloaded in it.
+#define MAYABRIDGE_MESSAGE_WRITE_SNAPSHOT UINT32_C(0x00060000) //!< Write a snapshot file of the scene once it is out.
+#define MAYABRIDGE_MESSAGE_VERTEX_FORMAT UINT32_C(0x00070000) //!< Low 16 bits are a MAYABRIDGE_VERTEX_FORMAT_*, the scene is reloaded in it.
+#define MAYABRIDGE_MESSAGE_MASK         UINT32_C(0xffff0000)
+
+/// Event types published in SharedData::events.
+#define MAYABRIDGE_EVENT_RESET              UINT32_C(0x00000001) //!< Every model and material was removed.
+#define MAYABRIDGE_EVENT_RESYNC             UINT32_C(0x00000002) //!< Events were dropped, rebuild from a snapshot.
+#define MAYABRIDGE_EVENT_MODEL_ADDED        UINT32_C(0x00000003)
+#define MAYABRIDGE_EVENT_MODEL_REMOVED      UINT32_C(0x00000004)
+#define MAYABRIDGE_EVENT_MODEL_CHANGED      UINT32_C(0x00000005) //!< Mesh was replaced.
+#define MAYABRIDGE_EVENT_TRANSFORM_CHANGED  UINT32_C(0x00000006) //!< `index` Transform records at `payload`.
+#define MAYABRIDGE_EVENT_MATERIAL_ADDED     UINT32_C(0x00000007)
+#define MAYABRIDGE_EVENT_MATERIAL_CHANGED   UINT32_C(0x00000008)
+#define MAYABRIDGE_EVENT_CAMERA_CHANGED     UINT32_C(0x00000009) //!< At most one unconsumed, SharedCamera::sequence has the newest.
+#define MAYABRIDGE_EVENT_SAVE_SCENE         UINT32_C(0x0000000a)
+#define MAYABRIDGE_EVENT_VERTICES_CHANGED   UINT32_C(0x0000000b) //!< VertexDelta for model `index` at `payload`.
+#define MAYABRIDGE_EVENT_INSTANCES_CHANGED  UINT32_C(0x0000000c) //!< Instance table of model `index` was replaced.
+#define MAYABRIDGE_EVENT_HIERARCHY_CHANGED  UINT32_C(0x0000000d) //!< Hierarchy was replaced, read Scene::getNodes and Model::node again.
+#define MAYABRIDGE_EVENT_SNAPSHOT_WRITTEN   UINT32_C(0x0000000e) //!< The scene was written to Scene::snapshotPath.
 
 ///
-#ifndef MAYABRIDGE_CONFIG_MAX_VERTICES
-#define MAYABRIDGE_CONFIG_MAX_VERTICES 1000000
-#endif // MAYABRIDGE_CONFIG_MAX_VERTICES
+#define MAYABRIDGE_SCENE_MAGIC   UINT32_C(0x4353424d) // 'MBSC'
+#define MAYABRIDGE_SCENE_VERSION UINT32_C(23)
+
+/// Alignment of every blob in the shared arena.
+#define MAYABRIDGE_SCENE_ALIGNMENT UINT64_C(64)
+
+/// Model and material records per chunk. A publish writes again only the
+/// chunks with records that changed.
+#define MAYABRIDGE_SCENE_CHUNK_RECORDS UINT32_C(64)
+
+/// Interned strings are packed into pages of this many bytes.
+#define MAYABRIDGE_STRING_PAGE_SIZE UINT64_C(4096)
+
+/// Layouts of the vertices in a mesh blob, see Mesh::vertexFormat.
+#define MAYABRIDGE_VERTEX_FORMAT_FLOAT   UINT32_C(0) //!< mb::Vertex, 80 bytes.
+#define MAYABRIDGE_VERTEX_FORMAT_COMPACT UINT32_C(1) //!< mb::CompactVertex, 32 bytes.
+#define MAYABRIDGE_VERTEX_FORMAT_SLIM    UINT32_C(2) //!< mb::SlimVertex, 16 bytes.
+#define MAYABRIDGE_VERTEX_FORMAT_COUNT   UINT32_C(3)
+
+/// Vertex format meshes are written in unless the consumer asks for another.
+#ifndef MAYABRIDGE_CONFIG_VERTEX_FORMAT
+#define MAYABRIDGE_CONFIG_VERTEX_FORMAT MAYABRIDGE_VERTEX_FORMAT_FLOAT
+#endif // MAYABRIDGE_CONFIG_VERTEX_FORMAT
+
+/// How the vertices of a mesh blob are arranged, see Mesh::vertexLayout.
+#define MAYABRIDGE_VERTEX_LAYOUT_INTERLEAVED UINT32_C(0) //!< One stream of whole vertices.
+#define MAYABRIDGE_VERTEX_LAYOUT_STREAMS     UINT32_C(1) //!< One stream per MAYABRIDGE_STREAM_*.
+#define MAYABRIDGE_VERTEX_LAYOUT_COUNT       UINT32_C(2)
+
+/// Vertex layout meshes are written in unless the consumer asks for another.
+#ifndef MAYABRIDGE_CONFIG_VERTEX_LAYOUT
+#define MAYABRIDGE_CONFIG_VERTEX_LAYOUT MAYABRIDGE_VERTEX_LAYOUT_INTERLEAVED
+#endif // MAYABRIDGE_CONFIG_VERTEX_LAYOUT
+
+/// Streams of a MAYABRIDGE_VERTEX_LAYOUT_STREAMS mesh. A format that has no
+/// attribute for a stream leaves it empty (stride 0).
+#define MAYABRIDGE_STREAM_POSITION      UINT8_C(0)
+#define MAYABRIDGE_STREAM_NORMAL        UINT8_C(1)
+#define MAYABRIDGE_STREAM_TANGENT_FRAME UINT8_C(2) //!< Tangent and bitangent, or the quaternion holding the normal too.
+#define MAYABRIDGE_STREAM_TEXCOORD      UINT8_C(3)
+#define MAYABRIDGE_STREAM_SKIN          UINT8_C(4) //!< Weights, joints and displacement.
+#define MAYABRIDGE_STREAM_COUNT         UINT8_C(5)
+
+/// What a vertex attribute holds.
+#define MAYABRIDGE_SEMANTIC_POSITION      UINT8_C(0) //!< UNORM16 is relative to Mesh::positionOffset and Mesh::positionScale.
+#define MAYABRIDGE_SEMANTIC_NORMAL        UINT8_C(1) //!< Two SNORM16 components are octahedral.
+#define MAYABRIDGE_SEMANTIC_TANGENT       UINT8_C(2)
+#define MAYABRIDGE_SEMANTIC_BITANGENT     UINT8_C(3)
+#define MAYABRIDGE_SEMANTIC_TANGENT_FRAME UINT8_C(4) //!< Quaternion, the sign of w is the handedness of the bitangent.
+#define MAYABRIDGE_SEMANTIC_TEXCOORD      UINT8_C(5)
+#define MAYABRIDGE_SEMANTIC_WEIGHTS       UINT8_C(6)
+#define MAYABRIDGE_SEMANTIC_JOINTS        UINT8_C(7)
+#define MAYABRIDGE_SEMANTIC_DISPLACEMENT  UINT8_C(8)
+
+/// How a vertex attribute is stored.
+#define MAYABRIDGE_ATTRIBUTE_FLOAT32 UINT8_C(0)
+#define MAYABRIDGE_ATTRIBUTE_FLOAT16 UINT8_C(1)
+#define MAYABRIDGE_ATTRIBUTE_UNORM16 UINT8_C(2)
+#define MAYABRIDGE_ATTRIBUTE_SNORM16 UINT8_C(3)
+#define MAYABRIDGE_ATTRIBUTE_UNORM8  UINT8_C(4)
+#define MAYABRIDGE_ATTRIBUTE_UINT8   UINT8_C(5)
+
+/// Limits of a meshlet, what mesh shaders are commonly fastest with.
+#define MAYABRIDGE_MESHLET_MAX_VERTICES  64
+#define MAYABRIDGE_MESHLET_MAX_TRIANGLES 124
+
+/// Detail levels of a submesh, the full mesh included.
+#define MAYABRIDGE_MAX_LODS 4
+
+/// Textures of a material, see Material::textureCache.
+#define MAYABRIDGE_TEXTURE_BASE_COLOR UINT32_C(0)
+#define MAYABRIDGE_TEXTURE_METALLIC   UINT32_C(1)
+#define MAYABRIDGE_TEXTURE_ROUGHNESS  UINT32_C(2)
+#define MAYABRIDGE_TEXTURE_NORMAL     UINT32_C(3)
+#define MAYABRIDGE_TEXTURE_OCCLUSION  UINT32_C(4)
+#define MAYABRIDGE_TEXTURE_EMISSIVE   UINT32_C(5)
+#define MAYABRIDGE_TEXTURE_COUNT      UINT32_C(6)
+
+/// Block compressed formats of preprocessed textures, 4x4 pixels a block.
+#define MAYABRIDGE_TEXTURE_FORMAT_BC1 UINT32_C(0) //!< RGB, 8 bytes a block.
+#define MAYABRIDGE_TEXTURE_FORMAT_BC3 UINT32_C(1) //!< RGBA, 16 bytes a block.
+#define MAYABRIDGE_TEXTURE_FORMAT_BC4 UINT32_C(2) //!< R, 8 bytes a block.
+#define MAYABRIDGE_TEXTURE_FORMAT_BC5 UINT32_C(3) //!< RG, 16 bytes a block.
+#define MAYABRIDGE_TEXTURE_FORMAT_BC7 UINT32_C(4) //!< RGBA, 16 bytes a block.
+#define MAYABRIDGE_TEXTURE_FORMAT_COUNT UINT32_C(5)
+
+/// How the texels of a preprocessed texture are meant to be read.
+#define MAYABRIDGE_TEXTURE_FLAG_SRGB   UINT32_C(0x00000001) //!< Colors are sRGB encoded.
+#define MAYABRIDGE_TEXTURE_FLAG_NORMAL UINT32_C(0x00000002) //!< Tangent space normal in RG, z is reconstructed.
+
+/// Enough mips for a 32768 texture.
+#define MAYABRIDGE_TEXTURE_MAX_MIPS 16
 
 ///
-#ifndef MAYABRIDGE_CONFIG_MAX_INDICES
-#define MAYABRIDGE_CONFIG_MAX_INDICES 1000000
-#endif // MAYABRIDGE_CONFIG_MAX_INDICES
+#define MAYABRIDGE_TEXTURE_MAGIC   UINT32_C(0x5854424d) // 'MBTX'
+#define MAYABRIDGE_TEXTURE_VERSION UINT32_C(1)
 
 ///
-#define MAYABRIDGE_MESSAGE_NONE         UINT32_C(0x00010000)  
-#define MAYABRIDGE_MESSAGE_RECEIVED     UINT32_C(0x00020000)  
-#define MAYABRIDGE_MESSAGE_RELOAD_SCENE UINT32_C(0x00030000)  
-#define MAYABRIDGE_MESSAGE_SAVE_SCENE   UINT32_C(0x00040000)  
+#define MAYABRIDGE_VERTEX_MAX_ATTRIBUTES 8
+#define MAYABRIDGE_VERTEX_MAX_STREAMS    MAYABRIDGE_STREAM_COUNT
+
+/// Attempts SharedData::acquire makes before giving up on a snapshot.
+#ifndef MAYABRIDGE_CONFIG_ACQUIRE_RETRIES
+#define MAYABRIDGE_CONFIG_ACQUIRE_RETRIES 64
+#endif // MAYABRIDGE_CONFIG_ACQUIRE_RETRIES
 
 namespace mb
 {
+	/// Resolves an offset from the start of the shared buffer.
+	///
+	template<typename T>
+	inline const T* resolve(const void* _base, uint64_t _offset)
+	{
+		return reinterpret_cast<const T*>(static_cast<const uint8_t*>(_base) + _offset);
+	}
+
+	/// Start of a preprocessed texture file, followed by the blocks of every
+	/// mip, largest first, with rows of blocks from the top of the image.
+	/// Written by the bridge into its texture cache, the files are ready to
+	/// be mapped and uploaded as they are.
+	///
+	struct TextureHeader
+	{
+		/// Blocks of mip _mip, _file is where the file is mapped.
+		const uint8_t* getMip(const void* _file, uint32_t _mip) const
+		{
+			return resolve<uint8_t>(_file, mipOffsets[_mip]);
+		}
+
+		/// False for a file this header can't read.
+		bool isValid() const
+		{
+			return magic == MAYABRIDGE_TEXTURE_MAGIC && version == MAYABRIDGE_TEXTURE_VERSION
+				&& format < MAYABRIDGE_TEXTURE_FORMAT_COUNT && numMips <= MAYABRIDGE_TEXTURE_MAX_MIPS;
+		}
+
+		uint32_t magic;
+		uint32_t version;
+		uint32_t format;   //!< MAYABRIDGE_TEXTURE_FORMAT_*
+		uint32_t flags;    //!< MAYABRIDGE_TEXTURE_FLAG_*
+		uint32_t width;
+		uint32_t height;
+		uint32_t numMips;
+		uint32_t padding;
+		uint64_t mipOffsets[MAYABRIDGE_TEXTURE_MAX_MIPS]; //!< From the start of the file.
+		uint64_t mipSizes[MAYABRIDGE_TEXTURE_MAX_MIPS];
+	};
+
+	/// Names and texture paths are ids of strings interned in the scene, see
+	/// Scene::getString.
+	///
 	struct Material
 	{
 		Material()
@@ -49,14 +212,15 @@ namespace mb
 
 		void reset()
 		{
-			strcpy_s(name, "");
+			name = 0;
 
-			strcpy_s(baseColorTexture, "");
-			strcpy_s(metallicTexture, "");
-			strcpy_s(roughnessTexture, "");
-			strcpy_s(normalTexture, "");
-			strcpy_s(occlusionTexture, "");
-			strcpy_s(emissiveTexture, "");
+			baseColorTexture = 0;
+			metallicTexture = 0;
+			roughnessTexture = 0;
+			normalTexture = 0;
+			occlusionTexture = 0;
+			emissiveTexture = 0;
+			memset(textureCache, 0, sizeof(textureCache));
 
 			baseColorFactor[0] = 1.0f;
 			baseColorFactor[1] = 1.0f;
@@ -66,18 +230,23 @@ namespace mb
 			normalScale		   = 1.0f;
 			occlusionStrength  = 1.0f;
 			emissiveFactor[0]  = 0.0f;
-			emissiveFactor[0]  = 0.0f;
-			emissiveFactor[0]  = 0.0f;
+			emissiveFactor[1]  = 0.0f;
+			emissiveFactor[2]  = 0.0f;
 		}
 
-		char name[256];
+		uint32_t name;
+
+		uint32_t baseColorTexture;
+		uint32_t metallicTexture;
+		uint32_t roughnessTexture;
+		uint32_t normalTexture;
+		uint32_t occlusionTexture;
+		uint32_t emissiveTexture;
 
-		char baseColorTexture[256];
-		char metallicTexture[256];
-		char roughnessTexture[256];
-		char normalTexture[256];
-		char occlusionTexture[256];
-		char emissiveTexture[256];
+		/// Preprocessed file of each MAYABRIDGE_TEXTURE_*, see TextureHeader.
+		/// 0 until the texture is ready, which is announced with
+		/// MAYABRIDGE_EVENT_MATERIAL_CHANGED, or when there is no cache.
+		uint32_t textureCache[MAYABRIDGE_TEXTURE_COUNT];
 
 		float baseColorFactor[3];
 		float metallicFactor;
@@ -99,6 +268,251 @@ namespace mb
 		uint8_t indices[4];
 	};
 
+	/// Quantized vertex, position relative to the mesh bounds, normal,
+	/// tangent and bitangent as one quaternion.
+	///
+	struct CompactVertex
+	{
+		uint16_t position[4];    //!< UNORM16, w is 0.
+		int16_t tangentFrame[4]; //!< SNORM16 quaternion.
+		uint16_t texcoord[2];    //!< FLOAT16.
+		uint8_t weights[4];      //!< UNORM8.
+		uint8_t indices[4];
+		uint16_t displacement;   //!< FLOAT16.
+		uint16_t padding;
+	};
+
+	/// Position, normal and texcoord only, for consumers that derive the
+	/// tangent frame themselves.
+	///
+	struct SlimVertex
+	{
+		uint16_t position[4];    //!< UNORM16, w is 0.
+		int16_t normal[2];       //!< SNORM16 octahedral.
+		uint16_t texcoord[2];    //!< FLOAT16.
+	};
+
+	static_assert(sizeof(Vertex) == 80, "Vertex layout changed");
+	static_assert(sizeof(CompactVertex) == 32, "CompactVertex layout changed");
+	static_assert(sizeof(SlimVertex) == 16, "SlimVertex layout changed");
+
+	struct VertexAttribute
+	{
+		uint8_t semantic;   //!< MAYABRIDGE_SEMANTIC_*
+		uint8_t format;     //!< MAYABRIDGE_ATTRIBUTE_*
+		uint8_t components;
+		uint8_t offset;     //!< From the start of the element in its stream.
+		uint8_t stream;     //!< 0 when interleaved, MAYABRIDGE_STREAM_* otherwise.
+	};
+
+	/// Describes a vertex format in a layout, enough to set up vertex input
+	/// for it with one binding per stream.
+	///
+	struct VertexLayout
+	{
+		uint32_t stride;    //!< Bytes per vertex over all streams.
+		uint32_t numAttributes;
+		VertexAttribute attributes[MAYABRIDGE_VERTEX_MAX_ATTRIBUTES];
+		uint32_t streamStrides[MAYABRIDGE_VERTEX_MAX_STREAMS]; //!< 0 for streams the format doesn't use.
+	};
+
+	/// Bytes the attribute takes up in a vertex.
+	///
+	inline uint32_t getAttributeSize(const VertexAttribute& _attribute)
+	{
+		static const uint8_t s_sizes[] = { 4, 2, 2, 2, 1, 1 };
+		return s_sizes[_attribute.format] * _attribute.components;
+	}
+
+	/// Stream an attribute lives in with MAYABRIDGE_VERTEX_LAYOUT_STREAMS.
+	///
+	inline uint8_t getVertexStream(uint8_t _semantic)
+	{
+		switch (_semantic)
+		{
+		case MAYABRIDGE_SEMANTIC_POSITION:      return MAYABRIDGE_STREAM_POSITION;
+		case MAYABRIDGE_SEMANTIC_NORMAL:        return MAYABRIDGE_STREAM_NORMAL;
+		case MAYABRIDGE_SEMANTIC_TANGENT:
+		case MAYABRIDGE_SEMANTIC_BITANGENT:
+		case MAYABRIDGE_SEMANTIC_TANGENT_FRAME: return MAYABRIDGE_STREAM_TANGENT_FRAME;
+		case MAYABRIDGE_SEMANTIC_TEXCOORD:      return MAYABRIDGE_STREAM_TEXCOORD;
+		default:                                return MAYABRIDGE_STREAM_SKIN;
+		}
+	}
+
+	/// Returns false for an unknown format or layout. Interleaved formats
+	/// have a single stream, split into streams every attribute keeps its
+	/// order within its stream and each stream is padded to 4 bytes.
+	///
+	inline bool getVertexLayout(uint32_t _format, VertexLayout& _out, uint32_t _layout = MAYABRIDGE_VERTEX_LAYOUT_INTERLEAVED)
+	{
+		struct Builder
+		{
+			VertexLayout& layout;
+			bool streams;
+
+			void add(uint8_t _semantic, uint8_t _format, uint8_t _components, size_t _offset)
+			{
+				VertexAttribute& attribute = layout.attributes[layout.numAttributes++];
+				attribute.semantic = _semantic;
+				attribute.format = _format;
+				attribute.components = _components;
+				attribute.offset = uint8_t(_offset);
+				attribute.stream = 0;
+
+				if (streams)
+				{
+					attribute.stream = getVertexStream(_semantic);
+					attribute.offset = uint8_t(layout.streamStrides[attribute.stream]);
+					layout.streamStrides[attribute.stream] += getAttributeSize(attribute);
+				}
+			}
+
+			bool finish(uint32_t _stride)
+			{
+				layout.stride = _stride;
+				if (!streams)
+				{
+					layout.streamStrides[0] = _stride;
+					return true;
+				}
+
+				for (uint32_t& stride : layout.streamStrides)
+				{
+					stride = (stride + 3) & ~UINT32_C(3);
+				}
+				return true;
+			}
+		};
+
+		memset(&_out, 0, sizeof(VertexLayout));
+		if (_layout >= MAYABRIDGE_VERTEX_LAYOUT_COUNT)
+		{
+			return false;
+		}
+		Builder builder = { _out, _layout == MAYABRIDGE_VERTEX_LAYOUT_STREAMS };
+
+		switch (_format)
+		{
+		case MAYABRIDGE_VERTEX_FORMAT_FLOAT:
+			builder.add(MAYABRIDGE_SEMANTIC_POSITION, MAYABRIDGE_ATTRIBUTE_FLOAT32, 3, offsetof(Vertex, position));
+			builder.add(MAYABRIDGE_SEMANTIC_NORMAL, MAYABRIDGE_ATTRIBUTE_FLOAT32, 3, offsetof(Vertex, normal));
+			builder.add(MAYABRIDGE_SEMANTIC_TANGENT, MAYABRIDGE_ATTRIBUTE_FLOAT32, 3, offsetof(Vertex, tangent));
+			builder.add(MAYABRIDGE_SEMANTIC_BITANGENT, MAYABRIDGE_ATTRIBUTE_FLOAT32, 3, offsetof(Vertex, bitangent));
+			builder.add(MAYABRIDGE_SEMANTIC_TEXCOORD, MAYABRIDGE_ATTRIBUTE_FLOAT32, 2, offsetof(Vertex, texcoord));
+			builder.add(MAYABRIDGE_SEMANTIC_WEIGHTS, MAYABRIDGE_ATTRIBUTE_FLOAT32, 4, offsetof(Vertex, weights));
+			builder.add(MAYABRIDGE_SEMANTIC_DISPLACEMENT, MAYABRIDGE_ATTRIBUTE_FLOAT32, 1, offsetof(Vertex, displacement));
+			builder.add(MAYABRIDGE_SEMANTIC_JOINTS, MAYABRIDGE_ATTRIBUTE_UINT8, 4, offsetof(Vertex, indices));
+			return builder.finish(sizeof(Vertex));
+
+		case MAYABRIDGE_VERTEX_FORMAT_COMPACT:
+			builder.add(MAYABRIDGE_SEMANTIC_POSITION, MAYABRIDGE_ATTRIBUTE_UNORM16, 4, offsetof(CompactVertex, position));
+			builder.add(MAYABRIDGE_SEMANTIC_TANGENT_FRAME, MAYABRIDGE_ATTRIBUTE_SNORM16, 4, offsetof(CompactVertex, tangentFrame));
+			builder.add(MAYABRIDGE_SEMANTIC_TEXCOORD, MAYABRIDGE_ATTRIBUTE_FLOAT16, 2, offsetof(CompactVertex, texcoord));
+			builder.add(MAYABRIDGE_SEMANTIC_WEIGHTS, MAYABRIDGE_ATTRIBUTE_UNORM8, 4, offsetof(CompactVertex, weights));
+			builder.add(MAYABRIDGE_SEMANTIC_JOINTS, MAYABRIDGE_ATTRIBUTE_UINT8, 4, offsetof(CompactVertex, indices));
+			builder.add(MAYABRIDGE_SEMANTIC_DISPLACEMENT, MAYABRIDGE_ATTRIBUTE_FLOAT16, 1, offsetof(CompactVertex, displacement));
+			return builder.finish(sizeof(CompactVertex));
+
+		case MAYABRIDGE_VERTEX_FORMAT_SLIM:
+			builder.add(MAYABRIDGE_SEMANTIC_POSITION, MAYABRIDGE_ATTRIBUTE_UNORM16, 4, offsetof(SlimVertex, position));
+			builder.add(MAYABRIDGE_SEMANTIC_NORMAL, MAYABRIDGE_ATTRIBUTE_SNORM16, 2, offsetof(SlimVertex, normal));
+			builder.add(MAYABRIDGE_SEMANTIC_TEXCOORD, MAYABRIDGE_ATTRIBUTE_FLOAT16, 2, offsetof(SlimVertex, texcoord));
+			return builder.finish(sizeof(SlimVertex));
+		}
+
+		return false;
+	}
+
+	/// Axis aligned box and a sphere around the same points, all zero when
+	/// there is nothing to bound.
+	///
+	struct Bounds
+	{
+		float min[3];
+		float max[3];
+		float center[3];
+		float radius;
+	};
+
+	/// Bounds of _local moved by the affine _matrix, column-major with the
+	/// translation in elements 12 to 14 (the memory layout of a Maya MMatrix
+	/// too). The box is the one around the moved box, the sphere scales with
+	/// the largest axis.
+	///
+	inline void transformBounds(const Bounds& _local, const float* _matrix, Bounds& _world)
+	{
+		float scale = 0.0f;
+		for (int ii = 0; ii < 3; ++ii)
+		{
+			const float* axis = &_matrix[ii * 4];
+			float lengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+			scale = lengthSq > scale ? lengthSq : scale;
+		}
+
+		Bounds world;
+		for (int jj = 0; jj < 3; ++jj)
+		{
+			float boxCenter = _matrix[12 + jj];
+			float extent = 0.0f;
+			float center = _matrix[12 + jj];
+			for (int ii = 0; ii < 3; ++ii)
+			{
+				float m = _matrix[ii * 4 + jj];
+				boxCenter += (_local.min[ii] + _local.max[ii]) * 0.5f * m;
+				extent += (_local.max[ii] - _local.min[ii]) * 0.5f * (m < 0.0f ? -m : m);
+				center += _local.center[ii] * m;
+			}
+			world.min[jj] = boxCenter - extent;
+			world.max[jj] = boxCenter + extent;
+			world.center[jj] = center;
+		}
+		world.radius = _local.radius * sqrtf(scale);
+		_world = world;
+	}
+
+	/// Cluster of up to MAYABRIDGE_MESHLET_MAX_TRIANGLES triangles using up to
+	/// MAYABRIDGE_MESHLET_MAX_VERTICES vertices, with the bounds to cull it.
+	/// Bounds are in the space of the mesh.
+	///
+	struct Meshlet
+	{
+		float center[3];
+		float radius;
+
+		/// Every triangle faces away from a camera at _eye if
+		/// dot(normalize(coneApex - _eye), coneAxis) >= coneCutoff. A cutoff of
+		/// 1 or more never culls.
+		float coneApex[3];
+		float coneCutoff;
+		float coneAxis[3];
+
+		uint32_t vertexOffset;   //!< First entry in Mesh meshlet vertices.
+		uint32_t triangleOffset; //!< First byte in Mesh meshlet triangles, a multiple of 4.
+		uint32_t numVertices;
+		uint32_t numTriangles;
+		uint32_t padding;
+	};
+
+	static_assert(sizeof(Meshlet) == 64, "Meshlet layout changed");
+
+	/// Simplified index buffer of a submesh, drawing the same vertices.
+	///
+	struct SubMeshLod
+	{
+		uint32_t numIndices;
+
+		/// How far the level strays from the full mesh, in the space of the
+		/// mesh. Seen from _distance with a vertical field of view _fovY on a
+		/// viewport _height pixels tall that is
+		/// error * _height / (2 * tan(_fovY / 2) * _distance) pixels.
+		float error;
+
+		uint64_t indicesOffset;
+	};
+
+	/// Lives in the owning mesh blob, indices point into the same blob.
+	///
 	struct SubMesh
 	{
 		SubMesh()
@@ -110,17 +524,70 @@ namespace mb
 		{
 			hash = 0;
 			numIndices = 0;
-			strcpy_s(material, "");
+			indicesOffset = 0;
+			numMeshlets = 0;
+			meshletsOffset = 0;
+			numLods = 0;
+			memset(lods, 0, sizeof(lods));
+			memset(&bounds, 0, sizeof(bounds));
+			material = UINT32_MAX;
+		}
+
+		/// Only for meshes with 32-bit indices, use getIndexData otherwise.
+		const uint32_t* getIndices(const void* _base) const
+		{
+			return resolve<uint32_t>(_base, indicesOffset);
 		}
 
-		size_t hash;
+		/// Mesh::indexSize bytes per index.
+		const void* getIndexData(const void* _base) const
+		{
+			return resolve<uint8_t>(_base, indicesOffset);
+		}
+
+		uint64_t hash; //!< Vertices and indices the submesh draws, usable as a GPU buffer cache key.
+		Bounds bounds; //!< Of the vertices the submesh draws, in the space of the mesh.
+
+		const Meshlet* getMeshlets(const void* _base) const
+		{
+			return resolve<Meshlet>(_base, meshletsOffset);
+		}
 
 		uint32_t numIndices;
-		uint32_t indices[MAYABRIDGE_CONFIG_MAX_INDICES];
+		uint64_t indicesOffset;
+
+		uint32_t numMeshlets;    //!< 0 unless Maya was asked for meshlets.
+		uint64_t meshletsOffset;
+
+		/// Coarsest level that strays at most _maxError from the full mesh.
+		uint32_t selectLod(float _maxError) const
+		{
+			uint32_t lod = 0;
+			while (lod + 1 < numLods && lods[lod + 1].error <= _maxError)
+			{
+				++lod;
+			}
+			return lod;
+		}
+
+		uint32_t numLods;                     //!< Level 0 is the full submesh, meshlets only cover that one.
+		SubMeshLod lods[MAYABRIDGE_MAX_LODS]; //!< Finest first, indices use Mesh::indexSize too.
+
+		uint32_t material; //!< Material slot, UINT32_MAX if the shader isn't a published material.
+	};
 
-		char material[256];
+	/// Contiguous vertex data of one stream, uploadable on its own.
+	///
+	struct VertexStream
+	{
+		uint64_t offset;
+		uint64_t hash;   //!< Bytes of the stream, re-upload it only when this changes.
+		uint32_t stride; //!< 0 if the stream is empty.
 	};
 
+	/// Each mesh owns one tightly sized blob in the shared arena holding its
+	/// submeshes, vertices and indices.
+	///
 	struct Mesh
 	{
 		Mesh()
@@ -130,21 +597,181 @@ namespace mb
 
 		void reset()
 		{
+			id = 0;
+			hash = 0;
+			vertexFormat = MAYABRIDGE_VERTEX_FORMAT_FLOAT;
+			vertexLayout = MAYABRIDGE_VERTEX_LAYOUT_INTERLEAVED;
+			vertexStride = sizeof(Vertex);
+			indexSize = sizeof(uint32_t);
+			memset(streams, 0, sizeof(streams));
+			memset(positionOffset, 0, sizeof(float) * 3);
+			memset(positionScale, 0, sizeof(float) * 3);
+			memset(&bounds, 0, sizeof(bounds));
 			numVertices = 0;
 			numSubMeshes = 0;
-			for (auto& subMesh : subMeshes)
+			verticesOffset = 0;
+			subMeshesOffset = 0;
+			meshletVerticesOffset = 0;
+			meshletTrianglesOffset = 0;
+			blobOffset = 0;
+			blobSize = 0;
+		}
+
+		/// Only for interleaved MAYABRIDGE_VERTEX_FORMAT_FLOAT, use getVertexData
+		/// or getStreamData otherwise.
+		const Vertex* getVertices(const void* _base) const
+		{
+			return resolve<Vertex>(_base, verticesOffset);
+		}
+
+		const void* getVertexData(const void* _base) const
+		{
+			return resolve<uint8_t>(_base, verticesOffset);
+		}
+
+		/// Interleaved meshes only use stream 0.
+		const void* getStreamData(const void* _base, uint32_t _stream) const
+		{
+			return resolve<uint8_t>(_base, streams[_stream].offset);
+		}
+
+		const SubMesh* getSubMeshes(const void* _base) const
+		{
+			return resolve<SubMesh>(_base, subMeshesOffset);
+		}
+
+		/// Mesh vertex of every meshlet vertex, Meshlet::vertexOffset indexes it.
+		const uint32_t* getMeshletVertices(const void* _base) const
+		{
+			return resolve<uint32_t>(_base, meshletVerticesOffset);
+		}
+
+		/// Three meshlet vertices per triangle, Meshlet::triangleOffset indexes it.
+		const uint8_t* getMeshletTriangles(const void* _base) const
+		{
+			return resolve<uint8_t>(_base, meshletTrianglesOffset);
+		}
+
+		uint64_t id;   //!< Identifies the vertex numbering, a VertexDelta only applies to the mesh with its id.
+		uint64_t hash; //!< Everything in the blob, vertices, indices and the names of the materials.
+
+		uint32_t vertexFormat;    //!< MAYABRIDGE_VERTEX_FORMAT_*
+		uint32_t vertexLayout;    //!< MAYABRIDGE_VERTEX_LAYOUT_*
+		uint32_t vertexStride;    //!< Bytes per vertex over all streams.
+		float positionOffset[3];  //!< Quantized positions decode to offset + unorm * scale.
+		float positionScale[3];
+		Bounds bounds;            //!< Of all vertices, in the space of the mesh.
+
+		uint32_t numVertices;
+		uint32_t numSubMeshes;
+		uint32_t indexSize;       //!< 2 when every vertex fits in 16 bits, 4 otherwise.
+
+		uint64_t verticesOffset;  //!< Start of the first stream.
+		uint64_t subMeshesOffset;
+
+		uint64_t meshletVerticesOffset;
+		uint64_t meshletTrianglesOffset;
+
+		VertexStream streams[MAYABRIDGE_VERTEX_MAX_STREAMS];
+
+		uint64_t blobOffset;
+		uint64_t blobSize;
+	};
+
+	/// Consecutive vertices changed by a VertexDelta.
+	///
+	struct VertexRun
+	{
+		uint32_t first;
+		uint32_t count;
+	};
+
+	struct DeltaVertex
+	{
+		float position[3];
+		float normal[3];
+	};
+
+	/// Vertices that moved while the topology stayed the same, for patching
+	/// a copy of the mesh in place. Every run is followed by its vertices, in
+	/// run order. Only sent for meshes in MAYABRIDGE_VERTEX_FORMAT_FLOAT.
+	///
+	struct VertexDelta
+	{
+		const VertexRun* getRuns(const void* _base) const
+		{
+			return resolve<VertexRun>(_base, runsOffset);
+		}
+
+		const DeltaVertex* getVertices(const void* _base) const
+		{
+			return resolve<DeltaVertex>(_base, verticesOffset);
+		}
+
+		uint32_t modelId;
+		uint32_t numRuns;
+		uint64_t meshId; //!< Skip the delta if the model has another mesh.
+
+		uint32_t numVertices;
+		uint64_t runsOffset;
+		uint64_t verticesOffset;
+	};
+
+	/// Column-major _a * _b into _out, which must not be either of them.
+	///
+	inline void multiplyMatrices(const float* _a, const float* _b, float* _out)
+	{
+		for (int ii = 0; ii < 4; ++ii)
+		{
+			for (int jj = 0; jj < 4; ++jj)
 			{
-				subMesh.reset();
+				_out[ii * 4 + jj] = _a[jj] * _b[ii * 4] + _a[4 + jj] * _b[ii * 4 + 1] + _a[8 + jj] * _b[ii * 4 + 2] + _a[12 + jj] * _b[ii * 4 + 3];
 			}
 		}
+	}
 
-		uint32_t numVertices;
-		Vertex vertices[MAYABRIDGE_CONFIG_MAX_VERTICES];
+	/// Transform at one DAG path. A transform instanced under several
+	/// parents is a node per path.
+	///
+	struct HierarchyNode
+	{
+		float local[16]; //!< Relative to the parent, column-major like transformBounds wants.
+		uint32_t parent; //!< UINT32_MAX for roots, always lower than the index of the node itself.
+		uint32_t padding;
+	};
 
-		uint32_t numSubMeshes;
-		SubMesh subMeshes[MAYABRIDGE_CONFIG_MAX_SUBMESHES];
+	/// World matrices, 16 floats per node, of nodes _first to _count. The
+	/// ones before _first must already be in _world. Parents come before
+	/// their children, so after patching local matrices one pass from the
+	/// lowest node patched brings every descendant along.
+	///
+	inline void propagateHierarchy(const HierarchyNode* _nodes, uint32_t _count, uint32_t _first, float* _world)
+	{
+		for (uint32_t ii = _first; ii < _count; ++ii)
+		{
+			const HierarchyNode& node = _nodes[ii];
+			if (node.parent == UINT32_MAX)
+			{
+				memcpy(&_world[ii * 16], node.local, sizeof(node.local));
+			}
+			else
+			{
+				multiplyMatrices(&_world[node.parent * 16], node.local, &_world[ii * 16]);
+			}
+		}
+	}
+
+	/// One DAG instance of a model, placed by the transform above the shape.
+	/// Its world bounds are Mesh::bounds moved by the world matrix of the node.
+	///
+	struct Instance
+	{
+		uint32_t node; //!< Hierarchy node.
 	};
 
+	/// One mesh shape and every DAG path it is instanced at. The transform
+	/// of the model is the first instance.
+	///
 	struct Model
 	{
 		Model()
@@ -154,65 +781,367 @@ namespace mb
 
 		void reset()
 		{
-			strcpy_s(name, "");
+			id = 0;
+			name = 0;
 
 			memset(position, 0, sizeof(float) * 3);
-			memset(rotation, 0, sizeof(float) * 3);
+			memset(rotation, 0, sizeof(float) * 4);
 			memset(scale, 0, sizeof(float) * 3);
+			memset(&bounds, 0, sizeof(bounds));
+			node = UINT32_MAX;
+			numInstances = 1;
+			instancesOffset = 0;
 
 			mesh.reset();
 		}
 
-		char name[256];
+		/// Only for models with more than one instance.
+		const Instance* getInstances(const void* _base) const
+		{
+			return resolve<Instance>(_base, instancesOffset);
+		}
+
+		uint32_t id; //!< Unique for the lifetime of the session, 0 if the slot is empty.
+		uint32_t name; //!< String id, see Scene::getString.
 
+		/// World transform of the first instance and bounds around every
+		/// instance, as of this snapshot. Transform batches only patch the
+		/// hierarchy, in between follow the world matrix of `node`.
 		float position[3];
 		float rotation[4];
 		float scale[3];
+		Bounds bounds; //!< Mesh::bounds in world space around every instance, zero without a mesh.
+
+		uint32_t node;            //!< Hierarchy node of the first instance.
+		uint32_t numInstances;    //!< Draw the mesh once per instance.
+		uint64_t instancesOffset; //!< Instance table when there is more than one, 0 otherwise.
 
 		Mesh mesh;
 	};
 
+	/// Local matrix of one hierarchy node, published in batches when only
+	/// transforms changed so moving a parent sends the parent alone. Patch
+	/// the nodes, then propagateHierarchy from the lowest one.
+	///
+	struct Transform
+	{
+		uint32_t node;      //!< Hierarchy node.
+		uint32_t hierarchy; //!< Scene::hierarchyId, skip the record if the nodes were renumbered since.
+		float local[16];
+	};
+
 	struct Camera
 	{
+		Camera()
+		{
+			reset();
+		}
+
+		void reset()
+		{
+			memset(view, 0, sizeof(float) * 16);
+			memset(proj, 0, sizeof(float) * 16);
+		}
+
+		float view[16];
+		float proj[16];
 	};
 
-	/// Data that's changed every update.
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared atomics must be lock free to work across processes");
+
+	/// The camera changes every viewport redraw, so it is published through
+	/// its own seqlock instead of the scene records.
 	///
-	struct SharedData
+	struct alignas(64) SharedCamera
 	{
-		SharedData()
+		SharedCamera()
 		{
-			resetModels();
-			resetMaterials();
+			sequence.store(0, std::memory_order_relaxed);
+			camera.reset();
 		}
 
-		void resetModels()
+		/// Copies the newest camera into _out. Returns false if a publish kept
+		/// racing the copy, or if Maya hasn't published one since _sequence.
+		///
+		bool acquire(Camera& _out, uint64_t& _sequence) const
 		{
-			numModels = 0;
-			for (auto& model : models)
+			for (uint32_t ii = 0; ii < MAYABRIDGE_CONFIG_ACQUIRE_RETRIES; ++ii)
 			{
-				model.reset();
+				uint64_t begin = sequence.load(std::memory_order_acquire);
+				if (begin & 1)
+				{
+					continue;
+				}
+				if (begin == _sequence)
+				{
+					return false;
+				}
+
+				memcpy(&_out, &camera, sizeof(Camera));
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				if (sequence.load(std::memory_order_relaxed) == begin)
+				{
+					_sequence = begin;
+					return true;
+				}
 			}
+
+			return false;
+		}
+
+		std::atomic<uint64_t> sequence; //!< Odd while Maya is publishing.
+		Camera camera;
+	};
+
+	/// A change, resolved against a scene snapshot at least as new as
+	/// `sequence`. Slots keep their index for as long as the model lives, so
+	/// events for a slot that was reused in the meantime resolve to the newest
+	/// model in it.
+	///
+	struct Event
+	{
+		template<typename T>
+		const T* getPayload(const void* _base) const
+		{
+			return resolve<T>(_base, payload);
 		}
 
-		void resetMaterials()
+		uint32_t type;
+		uint32_t index;    //!< Model or material slot.
+		uint64_t sequence; //!< Scene (or camera) sequence the change was published in.
+		uint64_t payload;  //!< Offset of data carried by the event, 0 if none. Valid until the event is consumed.
+	};
+
+	/// Single producer, single consumer ring of events. Maya appends without
+	/// ever waiting, when the ring is full events are dropped and a
+	/// MAYABRIDGE_EVENT_RESYNC follows once there is room again.
+	///
+	struct EventRing
+	{
+		EventRing()
 		{
-			numMaterials = 0;
-			for (auto& material : materials)
+			head.store(0, std::memory_order_relaxed);
+			tail.store(0, std::memory_order_relaxed);
+		}
+
+		/// Copies up to _max pending events without consuming them.
+		///
+		uint32_t peek(Event* _out, uint32_t _max) const
+		{
+			uint64_t end = head.load(std::memory_order_acquire);
+			uint64_t begin = tail.load(std::memory_order_relaxed);
+
+			uint32_t count = uint32_t(end - begin < _max ? end - begin : _max);
+			for (uint32_t ii = 0; ii < count; ++ii)
 			{
-				material.reset();
+				_out[ii] = events[(begin + ii) & (MAYABRIDGE_CONFIG_EVENT_RING_SIZE - 1)];
 			}
+			return count;
 		}
 
-		Camera camera;
+		/// Hands the slots of the first _count peeked events back to Maya.
+		///
+		void consume(uint32_t _count)
+		{
+			uint64_t begin = tail.load(std::memory_order_relaxed);
+			tail.store(begin + _count, std::memory_order_release);
+		}
+
+		alignas(64) std::atomic<uint64_t> head; //!< Written by Maya.
+		alignas(64) std::atomic<uint64_t> tail; //!< Written by the consumer.
+
+		alignas(64) Event events[MAYABRIDGE_CONFIG_EVENT_RING_SIZE];
+	};
+
+	static_assert((MAYABRIDGE_CONFIG_EVENT_RING_SIZE & (MAYABRIDGE_CONFIG_EVENT_RING_SIZE - 1)) == 0, "Event ring size must be a power of two");
+
+	/// Throughput of the bridge, for tuning the update budget.
+	///
+	struct Stats
+	{
+		Stats()
+		{
+			memset(this, 0, sizeof(Stats));
+		}
+
+		float budgetMs;            //!< Time Maya spends extracting per update tick.
+
+		uint64_t busyTicks;        //!< Ticks that had work queued.
+		uint64_t overBudgetTicks;  //!< Ticks where a single item took longer than the budget.
+		uint64_t busyMicroseconds; //!< Total time spent extracting.
+
+		uint64_t modelsProcessed;
+		uint64_t materialsProcessed;
+
+		uint64_t meshesWritten;
+		uint64_t meshBytesWritten;
+		uint64_t meshesSkipped;    //!< Meshes whose content was already in the buffer.
+
+		uint32_t queuedModels;     //!< Backlog left after the last tick.
+		uint32_t queuedMaterials;
+		uint32_t pendingMeshes;    //!< Meshes still converting on the workers.
+	};
+
+	/// The published scene. Maya edits private copies and publishes them
+	/// whole, the consumer only ever sees complete copies. Records live in
+	/// chunks of MAYABRIDGE_SCENE_CHUNK_RECORDS in the arena, so the scene
+	/// grows with the arena rather than with a fixed number of slots.
+	///
+	struct Scene
+	{
+		Scene()
+		{
+			size = 0;
+
+			numModels = 0;
+			numMaterials = 0;
+			modelsOffset = 0;
+			materialsOffset = 0;
+
+			numNodes = 0;
+			hierarchyId = 0;
+			nodesOffset = 0;
+
+			numStrings = 0;
+			snapshotPath = 0;
+			stringsOffset = 0;
+		}
+
+		const Model& getModel(const void* _base, uint32_t _index) const
+		{
+			const uint64_t* chunks = resolve<uint64_t>(_base, modelsOffset);
+			return resolve<Model>(_base, chunks[_index / MAYABRIDGE_SCENE_CHUNK_RECORDS])[_index % MAYABRIDGE_SCENE_CHUNK_RECORDS];
+		}
+
+		const Material& getMaterial(const void* _base, uint32_t _index) const
+		{
+			const uint64_t* chunks = resolve<uint64_t>(_base, materialsOffset);
+			return resolve<Material>(_base, chunks[_index / MAYABRIDGE_SCENE_CHUNK_RECORDS])[_index % MAYABRIDGE_SCENE_CHUNK_RECORDS];
+		}
+
+		/// Transform hierarchy of every model, parents first.
+		const HierarchyNode* getNodes(const void* _base) const
+		{
+			return resolve<HierarchyNode>(_base, nodesOffset);
+		}
+
+		/// Interned string _id, 0 is the empty string. Every string is stored
+		/// once, so two ids are equal exactly when the strings are.
+		const char* getString(const void* _base, uint32_t _id) const
+		{
+			const uint64_t* chunks = resolve<uint64_t>(_base, stringsOffset);
+			return resolve<char>(_base, resolve<uint64_t>(_base, chunks[_id / MAYABRIDGE_SCENE_CHUNK_RECORDS])[_id % MAYABRIDGE_SCENE_CHUNK_RECORDS]);
+		}
+
+		uint64_t size;
 
-		uint32_t numModels;
+		Stats stats;
+
+		uint32_t numModels;       //!< Slots in use, removed models leave an empty slot (id 0).
 		uint32_t numMaterials;
+		uint64_t modelsOffset;    //!< Offsets of the model chunks.
+		uint64_t materialsOffset; //!< Offsets of the material chunks.
+
+		uint32_t numNodes;
+		uint32_t hierarchyId;  //!< Changes whenever node indices are reassigned.
+		uint64_t nodesOffset;
 
-		Model models[MAYABRIDGE_CONFIG_MAX_MODELS];
-		Material materials[MAYABRIDGE_CONFIG_MAX_MATERIALS];
+		uint32_t numStrings;
+		uint32_t snapshotPath;  //!< String id of the last snapshot file written, 0 if none.
+		uint64_t stringsOffset; //!< Offsets of the chunks of string offsets.
 	};
 
-} // namespace mb
+	/// Header at the start of the shared scene buffer. The Scene is small
+	/// and published through a seqlock, everything sized by the scene content,
+	/// the records included, lives in blobs after the header and is addressed
+	/// by offsets from the start of the buffer.
+	///
+	/// Published bytes are never written again, blobs are only ever written
+	/// before they are published and string pages are only appended to. A
+	/// blob that is replaced is only reused once the reader has moved past
+	/// every snapshot that referenced it, which the reader announces through
+	/// readSequence.
+	///
+	/// Snapshot files written by the bridge are the same buffer frozen at one
+	/// publish, with nothing in the event ring. Map one with
+	/// SharedBuffer::initFromFile and acquire the scene as usual.
+	///
+	struct SharedData
+	{
+		SharedData()
+		{
+			magic = MAYABRIDGE_SCENE_MAGIC;
+			version = MAYABRIDGE_SCENE_VERSION;
+			capacity = 0;
+
+			// Start past 0, which is what an idle reader announces.
+			sequence.store(2, std::memory_order_relaxed);
+			readSequence.store(0, std::memory_order_relaxed);
+			request.store(MAYABRIDGE_MESSAGE_NONE, std::memory_order_relaxed);
+		}
+
+		bool isValid() const
+		{
+			return magic == MAYABRIDGE_SCENE_MAGIC && version == MAYABRIDGE_SCENE_VERSION;
+		}
 
+		/// Copies the newest complete scene into _out and pins the blobs it
+		/// references until the next acquire or release. Never waits on Maya,
+		/// returns false if a publish kept racing the copy.
+		///
+		bool acquire(Scene& _out)
+		{
+			for (uint32_t ii = 0; ii < MAYABRIDGE_CONFIG_ACQUIRE_RETRIES; ++ii)
+			{
+				uint64_t begin = sequence.load(std::memory_order_acquire);
+				if (begin & 1)
+				{
+					continue;
+				}
+
+				// Announce before reading, then make sure Maya hadn't already
+				// published past it and reclaimed what this snapshot references.
+				readSequence.store(begin, std::memory_order_seq_cst);
+				if (sequence.load(std::memory_order_seq_cst) != begin)
+				{
+					continue;
+				}
+
+				memcpy(&_out, &scene, sizeof(Scene));
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				if (sequence.load(std::memory_order_relaxed) == begin)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		/// Unpins the blobs of the last acquired scene.
+		///
+		void release()
+		{
+			readSequence.store(0, std::memory_order_seq_cst);
+		}
+
+		uint32_t magic;
+		uint32_t version;
+
+		uint64_t capacity;
+
+		alignas(64) std::atomic<uint32_t> request; //!< MAYABRIDGE_MESSAGE_*, written by the consumer.
+
+		SharedCamera camera;
+		EventRing events;
+
+		alignas(64) std::atomic<uint64_t> sequence;     //!< Odd while Maya is publishing.
+		alignas(64) std::atomic<uint64_t> readSequence; //!< Snapshot the reader holds, 0 if none.
+
+		alignas(64) Scene scene;
+	};
+
+} // namespace mb
 
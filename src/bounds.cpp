@@ -0,0 +1,128 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "bounds.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAYABRIDGE_BOUNDS_SSE2 1
+#include <emmintrin.h>
+#else
+#define MAYABRIDGE_BOUNDS_SSE2 0
+#endif
+
+namespace mb
+{
+	/// Both passes over the positions _position(ii) returns. Positions are
+	/// the first member of Vertex, so a four float load stays inside it.
+	///
+	template<typename PositionFn>
+	static void computeBounds(size_t _count, PositionFn _position, Bounds& _bounds)
+	{
+		memset(&_bounds, 0, sizeof(Bounds));
+		if (_count == 0)
+		{
+			return;
+		}
+
+#if MAYABRIDGE_BOUNDS_SSE2
+		__m128 min = _mm_set1_ps(FLT_MAX);
+		__m128 max = _mm_set1_ps(-FLT_MAX);
+		for (size_t ii = 0; ii < _count; ++ii)
+		{
+			__m128 p = _mm_loadu_ps(_position(ii));
+			min = _mm_min_ps(min, p);
+			max = _mm_max_ps(max, p);
+		}
+
+		float lanes[4];
+		_mm_storeu_ps(lanes, min);
+		memcpy(_bounds.min, lanes, sizeof(_bounds.min));
+		_mm_storeu_ps(lanes, max);
+		memcpy(_bounds.max, lanes, sizeof(_bounds.max));
+
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			_bounds.center[kk] = (_bounds.min[kk] + _bounds.max[kk]) * 0.5f;
+		}
+
+		// Four vertices at a time, transposed so each lane is one vertex
+		__m128 cx = _mm_set1_ps(_bounds.center[0]);
+		__m128 cy = _mm_set1_ps(_bounds.center[1]);
+		__m128 cz = _mm_set1_ps(_bounds.center[2]);
+		__m128 radiusSq = _mm_setzero_ps();
+
+		size_t ii = 0;
+		for (; ii + 4 <= _count; ii += 4)
+		{
+			__m128 p0 = _mm_loadu_ps(_position(ii + 0));
+			__m128 p1 = _mm_loadu_ps(_position(ii + 1));
+			__m128 p2 = _mm_loadu_ps(_position(ii + 2));
+			__m128 p3 = _mm_loadu_ps(_position(ii + 3));
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+			__m128 dx = _mm_sub_ps(p0, cx);
+			__m128 dy = _mm_sub_ps(p1, cy);
+			__m128 dz = _mm_sub_ps(p2, cz);
+			__m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			radiusSq = _mm_max_ps(radiusSq, distanceSq);
+		}
+
+		_mm_storeu_ps(lanes, radiusSq);
+		float maxSq = lanes[0];
+		for (int kk = 1; kk < 4; ++kk)
+		{
+			maxSq = lanes[kk] > maxSq ? lanes[kk] : maxSq;
+		}
+#else
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			_bounds.min[kk] = FLT_MAX;
+			_bounds.max[kk] = -FLT_MAX;
+		}
+		for (size_t ii = 0; ii < _count; ++ii)
+		{
+			const float* p = _position(ii);
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				_bounds.min[kk] = p[kk] < _bounds.min[kk] ? p[kk] : _bounds.min[kk];
+				_bounds.max[kk] = p[kk] > _bounds.max[kk] ? p[kk] : _bounds.max[kk];
+			}
+		}
+
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			_bounds.center[kk] = (_bounds.min[kk] + _bounds.max[kk]) * 0.5f;
+		}
+
+		float maxSq = 0.0f;
+		size_t ii = 0;
+#endif // MAYABRIDGE_BOUNDS_SSE2
+
+		for (; ii < _count; ++ii)
+		{
+			const float* p = _position(ii);
+			float d[3] = { p[0] - _bounds.center[0], p[1] - _bounds.center[1], p[2] - _bounds.center[2] };
+			float distanceSq = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+			maxSq = distanceSq > maxSq ? distanceSq : maxSq;
+		}
+
+		_bounds.radius = sqrtf(maxSq);
+	}
+
+	void computeBounds(const Vertex* _vertices, uint32_t _numVertices, Bounds& _bounds)
+	{
+		computeBounds(_numVertices, [_vertices](size_t _ii) { return _vertices[_ii].position; }, _bounds);
+	}
+
+	void computeBounds(const Vertex* _vertices, const uint32_t* _indices, size_t _numIndices, Bounds& _bounds)
+	{
+		computeBounds(_numIndices, [_vertices, _indices](size_t _ii) { return _vertices[_indices[_ii]].position; }, _bounds);
+	}
+
+} // namespace mb
@@ -0,0 +1,21 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include "maya-bridge/shared_data.h"
+
+namespace mb
+{
+	/// Box around the positions of _vertices, and the sphere at its center
+	/// through the farthest vertex. SSE2 where available.
+	///
+	void computeBounds(const Vertex* _vertices, uint32_t _numVertices, Bounds& _bounds);
+
+	/// Same for the vertices an index range uses.
+	///
+	void computeBounds(const Vertex* _vertices, const uint32_t* _indices, size_t _numIndices, Bounds& _bounds);
+
+} // namespace mb
@@ -8,19 +8,26 @@
 #include <maya/MFnDependencyNode.h>
 #include <maya/MItDependencyNodes.h>
 #include <maya/MGlobal.h>
+#include <maya/MImage.h>
 #include <maya/MMessage.h>
 #include <maya/MItDag.h>
 #include <maya/MDGMessage.h>
+#include <maya/MDagMessage.h>
+#include <maya/MNodeMessage.h>
+#include <maya/MPolyMessage.h>
 #include <maya/MUiMessage.h>
 #include <maya/MSceneMessage.h>
 #include <maya/MTimerMessage.h>
 #include <maya/MFnDagNode.h>
+#include <maya/MFileIO.h>
 #include <maya/MDagPath.h>
+#include <maya/MDagPathArray.h>
 #include <maya/MFnTransform.h>
 #include <maya/MStreamUtils.h>
 #include <maya/MMatrix.h>
 #include <maya/MFnMesh.h>
 #include <maya/MPointArray.h>
+#include <maya/MFloatPointArray.h>
 #include <maya/MFloatVectorArray.h>
 #include <maya/MFloatArray.h>
 #include <maya/MItMeshPolygon.h>
@@ -38,10 +45,12 @@
 #include <maya/MGlobal.h>
 
 #include <cassert>
+#include <chrono>
 #include <map>
 #include <unordered_set>
 #include <unordered_map>
 #include <set>
+#include <string.h>
 
 namespace mb
 {
@@ -61,6 +70,63 @@ namespace mb
 		bridge->removeModel(_node);
 	}
 
+	/// Channels a transform computes its own matrix from. A moving parent
+	/// dirties the world matrix of its children, but none of these.
+	///
+	static bool isLocalTransformAttribute(const MString& _name)
+	{
+		static const char* s_prefixes[] = { "translate", "rotate", "scale", "shear", "offsetParentMatrix", "inheritsTransform" };
+		for (const char* prefix : s_prefixes)
+		{
+			if (strncmp(_name.asChar(), prefix, strlen(prefix)) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static void callbackTransformDirty(MObject& _node, MPlug& _plug, void* _clientData)
+	{
+		TransformNode* node = (TransformNode*)_clientData;
+		assert(node != NULL);
+
+		if (isLocalTransformAttribute(MFnAttribute(_plug.attribute()).name()))
+		{
+			node->bridge->markTransformDirty(*node);
+		}
+	}
+
+	static void callbackParentChanged(MDagPath& _child, MDagPath& _parent, void* _clientData)
+	{
+		Bridge* bridge = (Bridge*)_clientData;
+		assert(bridge != NULL);
+
+		bridge->markHierarchyDirty(_child);
+	}
+
+	static void callbackMeshDirty(MObject& _node, MPlug& _plug, void* _clientData)
+	{
+		ModelNode* node = (ModelNode*)_clientData;
+		assert(node != NULL);
+
+		// Selection and display changes dirty the mesh too, only geometry and
+		// UV tweaks count. Whether it can go out as a delta is decided later.
+		MString name = MFnAttribute(_plug.attribute()).name();
+		if (name == "inMesh" || name == "outMesh" || name == "pnts" || name == "pntx" || name == "pnty" || name == "pntz" || name == "uvPt")
+		{
+			node->bridge->markMeshDirty(*node, false);
+		}
+	}
+
+	static void callbackTopologyChanged(MObject& _node, void* _clientData)
+	{
+		ModelNode* node = (ModelNode*)_clientData;
+		assert(node != NULL);
+
+		node->bridge->markMeshDirty(*node, true);
+	}
+
 	static void callbackPanelPreRender(const MString& _panel, void* _clientData)
 	{
 		Bridge* bridge = (Bridge*)_clientData;
@@ -111,11 +177,23 @@ namespace mb
 			&status
 		));
 
+		// Reparenting and instancing move nodes of the published hierarchy.
+		m_callbackArray.append(MDagMessage::addParentAddedCallback(
+			callbackParentChanged,
+			this,
+			&status
+		));
+		m_callbackArray.append(MDagMessage::addParentRemovedCallback(
+			callbackParentChanged,
+			this,
+			&status
+		));
+
 		// Added camera panel callback.
 		m_callbackArray.append(MUiMessage::add3dViewPreRenderMsgCallback(
-			"",
-			callbackPanelPreRender,
 			"modelPanel1",
+			callbackPanelPreRender,
+			this,
 			&status
 		));
 
@@ -132,6 +210,7 @@ namespace mb
 
 	void Bridge::removeCallbacks()
 	{
+		untrackAllModels();
 		MMessage::removeCallbacks(m_callbackArray);
 
 		MStreamUtils::stdOutStream() << "Removed plugin callbacks!" << "\n";
@@ -141,21 +220,35 @@ namespace mb
 	{
 		MFnDagNode fnDagNode = MFnDagNode(_obj);
 
-		strcpy_s(_model.name, fnDagNode.fullPathName().asChar());
+		_model.name = m_writer.internString(fnDagNode.fullPathName().asChar());
 
-		MStreamUtils::stdOutStream() << "  Name: " << _model.name << " " << "\n";
+		MStreamUtils::stdOutStream() << "  Name: " << m_writer.getString(_model.name) << " " << "\n";
 	}
 
-	void Bridge::processTransform(Model& _model, const MObject& _obj)
+	/// MMatrix rows are the columns of the column-major layout the hierarchy uses.
+	///
+	static void copyMatrix(const MMatrix& _matrix, float* _out)
 	{
-		MStreamUtils::stdOutStream() << "  Processing transform..." << "\n";
-
-		MFnTransform fnTransform(_obj);
+		for (uint32_t jj = 0; jj < 4; ++jj)
+		{
+			for (uint32_t kk = 0; kk < 4; ++kk)
+			{
+				_out[jj * 4 + kk] = static_cast<float>(_matrix(jj, kk));
+			}
+		}
+	}
 
-		MDagPath dagPath;
-		MDagPath::getAPathTo(_obj, dagPath);
+	/// Matrix of _path relative to its parent path. Taken from the world
+	/// matrices so inheritsTransform and the offset parent matrix are in it.
+	///
+	static void getLocalMatrix(const MDagPath& _path, float* _local)
+	{
+		copyMatrix(_path.inclusiveMatrix() * _path.exclusiveMatrixInverse(), _local);
+	}
 
-		MMatrix worldMatrix = dagPath.inclusiveMatrix();
+	static void extractTransform(const float* _worldMatrix, Model& _model)
+	{
+		MMatrix worldMatrix(reinterpret_cast<const float(*)[4]>(_worldMatrix));
 		MTransformationMatrix matrix(worldMatrix);
 
 		// Extract translation
@@ -180,183 +273,477 @@ namespace mb
 		_model.scale[2] =  static_cast<float>(scale[2]);
 	}
 
-	void Bridge::processMeshes(Model& _model, const MObject& _obj)
+	void Bridge::processInstances(uint32_t _index)
 	{
-		MFnDagNode fnDagNode = MFnDagNode(_obj);
+		ModelNode* node = _index < m_modelNodes.size() ? m_modelNodes[_index].get() : NULL;
+		if (node == NULL)
+		{
+			return;
+		}
 
-		uint32_t meshCounter = 0;
-		for (uint32_t ii = 0; ii < fnDagNode.childCount(); ++ii)
+		// Every DAG path to the shape is an instance of the model, placed by
+		// the transform above it
+		MDagPathArray paths;
+		if (node->mesh.isValid())
 		{
-			MObject child = fnDagNode.child(ii);
-			if (child.hasFn(MFn::kMesh) || child.hasFn(MFn::kMeshData) || child.hasFn(MFn::kMeshGeom))
+			MDagPath::getAllPathsTo(node->mesh.object(), paths);
+			for (uint32_t ii = 0; ii < paths.length(); ++ii)
+			{
+				paths[ii].pop();
+			}
+		}
+		if (paths.length() == 0 && node->node.isValid())
+		{
+			MDagPath dagPath;
+			MDagPath::getAPathTo(node->node.object(), dagPath);
+			paths.append(dagPath);
+		}
+
+		size_t numNodes = m_transformNodes.size();
+		std::vector<Instance> instances(paths.length());
+		for (uint32_t ii = 0; ii < paths.length(); ++ii)
+		{
+			instances[ii].node = trackTransform(paths[ii]);
+		}
+		if (m_transformNodes.size() != numNodes)
+		{
+			m_writer.updateHierarchy(false);
+		}
+
+		bool changed = instances.size() != node->instances.size();
+		for (size_t ii = 0; ii < instances.size() && !changed; ++ii)
+		{
+			changed = instances[ii].node != node->instances[ii].node;
+		}
+		node->instances.swap(instances);
+
+		Model& model = m_writer.editModel(_index);
+		model.node = node->instances.empty() ? UINT32_MAX : node->instances[0].node;
+
+		// Models that are or were instanced carry a table
+		if (changed && (node->instances.size() > 1 || model.numInstances > 1))
+		{
+			if (!m_writer.setInstances(_index, node->instances.data(), uint32_t(node->instances.size())))
 			{
-				MFnMesh fnMesh(child);
-				processMesh(_model, fnMesh);
-				break;
+				MStreamUtils::stdOutStream() << "Shared scene buffer is full! Raise mayaBridgeSceneCapacityMb and reload the plugin." << "\n";
 			}
 		}
+
+		updateWorld(_index);
 	}
 
-	void Bridge::processMesh(Model& _model, MFnMesh& fnMesh)
+	void Bridge::updateWorld(uint32_t _index)
 	{
-		MStreamUtils::stdOutStream() << "  Processing mesh..." << "\n";
-		Mesh& mesh = _model.mesh;
-
-		// Get positions
-		MPointArray points;
-		fnMesh.getPoints(points);
+		Model& model = m_writer.editModel(_index);
+		ModelNode* node = _index < m_modelNodes.size() ? m_modelNodes[_index].get() : NULL;
+		memset(&model.bounds, 0, sizeof(model.bounds));
+		if (node == NULL || node->instances.empty())
+		{
+			return;
+		}
 
-		// Get tangents & bitangents
-		MFloatVectorArray tangents, bitangents;
-		fnMesh.getTangents(tangents);
-		fnMesh.getBinormals(bitangents);
+		extractTransform(&m_worldMatrices[node->instances[0].node * 16], model);
+		if (model.mesh.numVertices == 0)
+		{
+			return;
+		}
 
-		// Get UV sets
-		MStringArray uvSetNames;
-		fnMesh.getUVSetNames(uvSetNames);
+		// Box around every instance box, then a sphere around every instance
+		// sphere
+		Bounds& bounds = model.bounds;
+		for (uint32_t ii = 0; ii < node->instances.size(); ++ii)
+		{
+			Bounds instance;
+			transformBounds(model.mesh.bounds, &m_worldMatrices[node->instances[ii].node * 16], instance);
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				bounds.min[kk] = ii == 0 || instance.min[kk] < bounds.min[kk] ? instance.min[kk] : bounds.min[kk];
+				bounds.max[kk] = ii == 0 || instance.max[kk] > bounds.max[kk] ? instance.max[kk] : bounds.max[kk];
+			}
+		}
 
-		MStreamUtils::stdOutStream() << "    Found uvsets: " << uvSetNames.length() << "\n";
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			bounds.center[kk] = (bounds.min[kk] + bounds.max[kk]) * 0.5f;
+		}
+		for (const Instance& instance : node->instances)
+		{
+			Bounds world;
+			transformBounds(model.mesh.bounds, &m_worldMatrices[instance.node * 16], world);
+			float d[3] = { world.center[0] - bounds.center[0], world.center[1] - bounds.center[1], world.center[2] - bounds.center[2] };
+			float radius = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) + world.radius;
+			bounds.radius = radius > bounds.radius ? radius : bounds.radius;
+		}
+	}
 
-		// Handle vertex attributes
-		mesh.numVertices = points.length();
-		for (uint32_t i = 0; i < mesh.numVertices; ++i)
+	uint32_t Bridge::findMeshModel(const MObject& _mesh) const
+	{
+		if (_mesh.isNull())
 		{
-			Vertex& vertex = mesh.vertices[i];
-			vertex.position[0] = float(points[i].x);
-			vertex.position[1] = float(points[i].y);
-			vertex.position[2] = float(points[i].z);
-			vertex.tangent[0] = tangents[i].x;
-			vertex.tangent[1] = tangents[i].y;
-			vertex.tangent[2] = tangents[i].z;
-			vertex.bitangent[0] = bitangents[i].x;
-			vertex.bitangent[1] = bitangents[i].y;
-			vertex.bitangent[2] = bitangents[i].z;
+			return UINT32_MAX;
 		}
 
-		// Handle per-face vertex attributes
-		MItMeshPolygon faceIter(fnMesh.object());
-		for (; !faceIter.isDone(); faceIter.next())
+		MObjectHandle handle(_mesh);
+		auto range = m_meshModels.equal_range(handle.hashCode());
+		for (auto it = range.first; it != range.second; ++it)
 		{
-			int vertexCount = faceIter.polygonVertexCount();
-			for (int i = 0; i < vertexCount; ++i)
+			const std::unique_ptr<ModelNode>& node = m_modelNodes[it->second];
+			if (node && node->mesh == handle)
 			{
-				int vertexIndex = faceIter.vertexIndex(i);
+				return it->second;
+			}
+		}
+
+		return UINT32_MAX;
+	}
 
-				float2 uv;
-				faceIter.getUV(i, uv, &uvSetNames[0]);
+	static MObject findMesh(const MObject& _obj)
+	{
+		MFnDagNode fnDagNode(_obj);
 
-				MVector normal;
-				faceIter.getNormal(i, normal);
-				
-				Vertex& vertex = mesh.vertices[vertexIndex];
-				vertex.texcoord[0] = uv[0];
-				vertex.texcoord[1] = 1.0f - uv[1];
-				vertex.normal[0] = static_cast<float>(normal.x);
-				vertex.normal[1] = static_cast<float>(normal.y);
-				vertex.normal[2] = static_cast<float>(normal.z);
+		for (uint32_t ii = 0; ii < fnDagNode.childCount(); ++ii)
+		{
+			MObject child = fnDagNode.child(ii);
+			if (child.hasFn(MFn::kMesh) || child.hasFn(MFn::kMeshData) || child.hasFn(MFn::kMeshGeom))
+			{
+				return child;
 			}
 		}
 
-		// Extract indices and materials
-		processSubMeshes(mesh, fnMesh);
+		return MObject();
+	}
+
+	void Bridge::processMeshes(uint32_t _index, const MObject& _obj, bool _notify)
+	{
+		MObject mesh = findMesh(_obj);
+		if (!mesh.isNull())
+		{
+			MFnMesh fnMesh(mesh);
+
+			std::shared_ptr<MeshSnapshot> snapshot = std::make_shared<MeshSnapshot>();
+			processMesh(*snapshot, fnMesh);
+			submitMesh(_index, snapshot, _notify);
+		}
+	}
+
+	void Bridge::processMesh(MeshSnapshot& _snapshot, MFnMesh& fnMesh)
+	{
+		MStreamUtils::stdOutStream() << "  Processing mesh..." << "\n";
+
+		MStreamUtils::stdOutStream() << "    Found uvsets: " << fnMesh.numUVSets() << "\n";
+
+		processPoints(_snapshot.positions, _snapshot.normals, fnMesh);
+		processFaceVertices(_snapshot, fnMesh);
+
+		// Extract faces and materials
+		processSubMeshes(_snapshot, fnMesh);
+	}
+
+	void Bridge::processFaceVertices(MeshSnapshot& _snapshot, MFnMesh& fnMesh)
+	{
+		// Get which normal each face-vertex uses
+		MIntArray normalCounts, normalIds;
+		fnMesh.getNormalIds(normalCounts, normalIds);
+		_snapshot.faceVertexNormalIds.resize(normalIds.length());
+		normalIds.get(_snapshot.faceVertexNormalIds.data());
+
+		// Get UV sets
+		MStringArray uvSetNames;
+		fnMesh.getUVSetNames(uvSetNames);
 
-		//
-		MStreamUtils::stdOutStream() << "    Num Vertices: " << mesh.numVertices << "\n";
-		MStreamUtils::stdOutStream() << "    Num SubMeshes: " << mesh.numSubMeshes << "\n";
-		for (uint32_t ii = 0; ii < mesh.numSubMeshes; ++ii)
+		if (uvSetNames.length() != 0)
 		{
-			MStreamUtils::stdOutStream() << "      [" << ii << "] Num Indices: " <<  mesh.subMeshes[ii].numIndices << " | Material: " << mesh.subMeshes[ii].material << " \n";
+			MFloatArray us, vs;
+			fnMesh.getUVs(us, vs, &uvSetNames[0]);
+			_snapshot.us.resize(us.length());
+			us.get(_snapshot.us.data());
+			_snapshot.vs.resize(vs.length());
+			vs.get(_snapshot.vs.data());
+
+			MIntArray uvCounts, uvIds;
+			fnMesh.getAssignedUVs(uvCounts, uvIds, &uvSetNames[0]);
+			_snapshot.faceUVCounts.resize(uvCounts.length());
+			uvCounts.get(_snapshot.faceUVCounts.data());
+			_snapshot.faceUVIds.resize(uvIds.length());
+			uvIds.get(_snapshot.faceUVIds.data());
 		}
 	}
 
-	void Bridge::processSubMeshes(Mesh& mesh, MFnMesh& fnMesh)
+	void Bridge::processPoints(std::vector<float>& _positions, std::vector<float>& _normals, MFnMesh& fnMesh)
 	{
+		// Get positions, already single precision internally
 		MStatus status;
+		const float* rawPoints = fnMesh.getRawPoints(&status);
+		if (status == MS::kSuccess && rawPoints != nullptr)
+		{
+			_positions.assign(rawPoints, rawPoints + fnMesh.numVertices() * 3);
+		}
+		else
+		{
+			MFloatPointArray points;
+			fnMesh.getPoints(points);
+			_positions.resize(points.length() * 3);
+			for (uint32_t ii = 0; ii < points.length(); ++ii)
+			{
+				_positions[ii * 3 + 0] = points[ii].x;
+				_positions[ii * 3 + 1] = points[ii].y;
+				_positions[ii * 3 + 2] = points[ii].z;
+			}
+		}
 
+		// Get normals
+		MFloatVectorArray normals;
+		fnMesh.getNormals(normals);
+		_normals.resize(normals.length() * 3);
+		normals.get(reinterpret_cast<float(*)[3]>(_normals.data()));
+	}
+
+	void Bridge::processSubMeshes(MeshSnapshot& _snapshot, MFnMesh& fnMesh)
+	{
 		// Get polygon counts and vertices
 		MIntArray vertexCount, vertexIndices;
 		fnMesh.getVertices(vertexCount, vertexIndices);
+		_snapshot.faceVertexCounts.resize(vertexCount.length());
+		vertexCount.get(_snapshot.faceVertexCounts.data());
+		_snapshot.faceVertexIndices.resize(vertexIndices.length());
+		vertexIndices.get(_snapshot.faceVertexIndices.data());
+
+		// Get Maya's triangulation, which handles concave polygons
+		MIntArray triangleCounts, triangleVertices;
+		fnMesh.getTriangles(triangleCounts, triangleVertices);
+		_snapshot.triangleCounts.resize(triangleCounts.length());
+		triangleCounts.get(_snapshot.triangleCounts.data());
+		_snapshot.triangleVertices.resize(triangleVertices.length());
+		triangleVertices.get(_snapshot.triangleVertices.data());
 
 		// Get material per face
 		MObjectArray shaders;
 		MIntArray faceShaderIndices;
 		fnMesh.getConnectedShaders(0, shaders, faceShaderIndices);
+		_snapshot.faceShaders.resize(faceShaderIndices.length());
+		faceShaderIndices.get(_snapshot.faceShaders.data());
 
-		std::unordered_map<int, SubMesh> subMeshMap;
-		int vertexIndexOffset = 0;
-
-		for (uint32_t faceIdx = 0; faceIdx < faceShaderIndices.length(); ++faceIdx) 
+		// Resolve the surface shader of each shading group
+		_snapshot.materials.resize(shaders.length());
+		for (uint32_t ii = 0; ii < shaders.length(); ++ii)
 		{
-			uint32_t shaderIndex = faceShaderIndices[faceIdx];
-			int faceVertexCount = vertexCount[faceIdx];
+			MFnDependencyNode shadingGroupFn(shaders[ii]);
 
-			// Ensure shader index is valid
-			if (shaderIndex < 0 || shaderIndex >= shaders.length()) 
+			MStatus status;
+			MPlug surfaceShaderPlug = shadingGroupFn.findPlug("surfaceShader", false, &status);
+
+			if (status == MS::kSuccess)
 			{
-				continue;
+				MPlugArray shaderConnections;
+				surfaceShaderPlug.connectedTo(shaderConnections, true, false, &status);
+				if (shaderConnections.length() != 0)
+				{
+					MObject shaderNode = shaderConnections[0].node();
+					MFnDependencyNode shaderFn(shaderNode);
+					_snapshot.materials[ii] = shaderFn.name().asChar();
+				}
 			}
+		}
+	}
 
-			// Create or get submesh for this shader
-			if (subMeshMap.find(shaderIndex) == subMeshMap.end()) 
+	void Bridge::submitMesh(uint32_t _index, std::shared_ptr<MeshSnapshot> _snapshot, bool _notify)
+	{
+		uint32_t id = m_writer.getModel(_index).id;
+		uint64_t hash = m_writer.getModel(_index).mesh.hash;
+		uint32_t vertexFormat = m_vertexFormat;
+		uint32_t vertexLayout = m_vertexLayout;
+		bool optimize = m_optimizeMeshes;
+		bool meshlets = m_meshlets;
+		uint32_t lodMinTriangles = m_lodMinTriangles;
+		m_numPendingMeshes += 1;
+
+		// A quiet rebuild keeps the vertex order the consumer patches deltas
+		// into. Deltas only touch positions and normals of the source, never
+		// the order, so the worker can read it while they keep going out.
+		std::shared_ptr<const MeshSource> previous;
+		if (_index < m_modelNodes.size() && m_modelNodes[_index])
+		{
+			m_modelNodes[_index]->meshPending = true;
+			if (!_notify)
 			{
-				SubMesh subMesh;
-
-				MFnDependencyNode shadingGroupFn(shaders[shaderIndex]);
+				previous = m_modelNodes[_index]->source;
+			}
+		}
 
-				MStatus status;
-				MPlug surfaceShaderPlug = shadingGroupFn.findPlug("surfaceShader", false, &status);
+		// Convert, triangulate and pack on a worker, the main thread picks the
+		// finished mesh up in update and publishes it.
+		m_jobs.submit([this, _index, id, hash, vertexFormat, vertexLayout, optimize, meshlets, lodMinTriangles, _snapshot, previous, _notify]()
+		{
+			MeshData data;
+			data.vertexFormat = vertexFormat;
+			data.vertexLayout = vertexLayout;
+			data.optimize = optimize;
+			data.meshlets = meshlets;
+			data.lodLevels = lodMinTriangles != 0 ? MAYABRIDGE_MAX_LODS - 1 : 0;
+			std::shared_ptr<MeshSource> source = std::make_shared<MeshSource>();
+			buildMesh(*_snapshot, data, source.get(), previous.get());
+
+			CompletedMesh completed;
+			completed.index = _index;
+			completed.id = id;
+			completed.source = source;
+			completed.written = false;
+			completed.unchanged = data.hash == hash;
+			completed.reused = false;
+			completed.proxy = false;
+
+			// Without the old order the consumer's copy can't be caught up
+			// quietly, deltas would patch the wrong vertices
+			completed.notify = _notify || !previous || source->remap != previous->remap || source->indices != previous->indices;
+
+			// Only write content the buffer doesn't have yet
+			if (!completed.unchanged)
+			{
+				completed.reused = m_writer.reuseMesh(completed.mesh, data);
 
-				if (status == MS::kSuccess)
+				if (!completed.reused && data.lodLevels != 0 && data.indices.size() / 3 >= lodMinTriangles)
 				{
-					MPlugArray shaderConnections;
-					surfaceShaderPlug.connectedTo(shaderConnections, true, false, &status);
-					if (shaderConnections.length() != 0)
+					// Simplifying a big mesh takes a while, one the model has no
+					// mesh for yet gets a proxy in the meantime.
+					if (hash == 0)
 					{
-						MObject shaderNode = shaderConnections[0].node();
-						MFnDependencyNode shaderFn(shaderNode);
-						strcpy_s(subMesh.material, shaderFn.name().asChar());
+						MeshData proxyData;
+						buildProxyMesh(data, MAYABRIDGE_CONFIG_LOD_PROXY_GRID, proxyData);
+
+						CompletedMesh proxy = completed;
+						proxy.source = NULL;
+						proxy.proxy = true;
+						proxy.written = m_writer.writeMesh(proxy.mesh, proxyData);
+						if (proxy.written)
+						{
+							std::lock_guard<std::mutex> lock(m_completedMutex);
+							m_completedMeshes.push_back(proxy);
+						}
 					}
+
+					buildLods(data, data.lodLevels);
+				}
+
+				completed.written = completed.reused || m_writer.writeMesh(completed.mesh, data);
+			}
+
+			std::lock_guard<std::mutex> lock(m_completedMutex);
+			m_completedMeshes.push_back(completed);
+		});
+	}
+
+	bool Bridge::processCompletedMeshes()
+	{
+		std::vector<CompletedMesh> completedMeshes;
+		{
+			std::lock_guard<std::mutex> lock(m_completedMutex);
+			completedMeshes.swap(m_completedMeshes);
+		}
+
+		Stats& stats = m_writer.getScene().stats;
+
+		bool write = false;
+		for (size_t ii = 0; ii < completedMeshes.size(); ++ii)
+		{
+			const CompletedMesh& completed = completedMeshes[ii];
+
+			// Proxies don't count, the full mesh they stand in for is still pending
+			if (!completed.proxy)
+			{
+				m_numPendingMeshes -= 1;
+			}
+
+			// Skip a proxy whose full mesh is already here
+			bool superseded = false;
+			for (size_t jj = ii + 1; jj < completedMeshes.size() && completed.proxy && !superseded; ++jj)
+			{
+				superseded = completedMeshes[jj].index == completed.index && completedMeshes[jj].id == completed.id;
+			}
+
+			// The model was removed, or the scene reloaded, while converting.
+			uint32_t id = completed.index < m_writer.getNumModels() ? m_writer.getModel(completed.index).id : 0;
+			if (id != completed.id || superseded)
+			{
+				// A reused mesh was published before and may still be read
+				Mesh mesh = completed.mesh;
+				if (completed.reused)
+				{
+					m_writer.freeMesh(mesh);
+				}
+				else if (completed.written)
+				{
+					m_writer.discardMesh(mesh);
 				}
+				continue;
+			}
+
+			const Model& model = m_writer.getModel(completed.index);
+			ModelNode* node = completed.index < m_modelNodes.size() ? m_modelNodes[completed.index].get() : NULL;
+			if (completed.proxy)
+			{
+				m_writer.setMesh(completed.index, completed.mesh);
+				updateWorld(completed.index);
+				write = true;
+
+				stats.meshesWritten += 1;
+				stats.meshBytesWritten += completed.mesh.blobSize;
 
-				subMeshMap[shaderIndex] = subMesh;
+				MStreamUtils::stdOutStream() << "Sent proxy mesh: " << m_writer.getString(model.name) << "\n";
+				continue;
 			}
-			SubMesh& subMesh = subMeshMap[shaderIndex];
 
-			// Triangulate n-gon faces
-			if (faceVertexCount == 3) 
+			if (node != NULL)
 			{
-				// Simple triangle
-				subMesh.indices[subMesh.numIndices++] = vertexIndices[vertexIndexOffset];
-				subMesh.indices[subMesh.numIndices++] = vertexIndices[vertexIndexOffset + 1];
-				subMesh.indices[subMesh.numIndices++] = vertexIndices[vertexIndexOffset + 2];
+				node->meshPending = false;
 			}
-			else if (faceVertexCount > 3) 
+
+			if (completed.unchanged)
 			{
-				// Triangulate by fan method
-				for (int j = 1; j < faceVertexCount - 1; ++j) 
+				stats.meshesSkipped += 1;
+				if (node != NULL)
 				{
-					subMesh.indices[subMesh.numIndices++] = vertexIndices[vertexIndexOffset];
-					subMesh.indices[subMesh.numIndices++] = vertexIndices[vertexIndexOffset + j];
-					subMesh.indices[subMesh.numIndices++] = vertexIndices[vertexIndexOffset + j + 1];
+					node->source = completed.source;
 				}
+				continue;
 			}
 
-			vertexIndexOffset += faceVertexCount;
-		}
+			if (!completed.written)
+			{
+				MStreamUtils::stdOutStream() << "Shared scene buffer is full! Raise mayaBridgeSceneCapacityMb and reload the plugin." << "\n";
+				continue;
+			}
 
-		// Copy sub-meshes to Mesh
-		for (auto& pair : subMeshMap) 
-		{
-			mesh.subMeshes[mesh.numSubMeshes++] = pair.second;
+			m_writer.setMesh(completed.index, completed.mesh, completed.notify);
+			updateWorld(completed.index);
+			if (node != NULL)
+			{
+				node->source = completed.source;
+			}
+			write = true;
+
+			if (completed.reused)
+			{
+				stats.meshesSkipped += 1;
+			}
+			else
+			{
+				stats.meshesWritten += 1;
+				stats.meshBytesWritten += completed.mesh.blobSize;
+			}
+
+			MStreamUtils::stdOutStream() << "Converted mesh: " << m_writer.getString(model.name) << "\n";
+			MStreamUtils::stdOutStream() << "    Num Vertices: " << completed.mesh.numVertices << "\n";
+			MStreamUtils::stdOutStream() << "    Num SubMeshes: " << completed.mesh.numSubMeshes << "\n";
 		}
+
+		return write;
 	}
 
 	void Bridge::processMaterial(Material& _material, const MObject& _obj)
 	{
 		MFnDependencyNode shaderFn(_obj);
-		strcpy_s(_material.name, shaderFn.name().asChar());
 
-		MStreamUtils::stdOutStream() << "  Name: " << _material.name << " \n";
+		MStreamUtils::stdOutStream() << "  Name: " << m_writer.getString(_material.name) << " \n";
 
 		if (_obj.hasFn(MFn::kStandardSurface))
 		{
@@ -412,7 +799,7 @@ namespace mb
 			MStreamUtils::stdOutStream() << "    Found Emissive Map..." << "\n";
 	}
 
-	bool Bridge::processTexture(const MPlug& _plug, char* _outPath)
+	bool Bridge::processTexture(const MPlug& _plug, uint32_t& _outPath)
 	{
 		MPlugArray textureConnections;
 		_plug.connectedTo(textureConnections, true, false);
@@ -428,14 +815,14 @@ namespace mb
 		{
 			MString texturePath;
 			fileTexturePlug.getValue(texturePath);
-			strcpy_s(_outPath, 256, texturePath.asChar());
+			_outPath = m_writer.internString(texturePath.asChar());
 			return true;
 		}
 
 		return false;
 	}
 
-	bool Bridge::processTextureNormal(MFnDependencyNode& shaderFn, char* _outPath)
+	bool Bridge::processTextureNormal(MFnDependencyNode& shaderFn, uint32_t& _outPath)
 	{
 		MPlug normalPlug = shaderFn.findPlug("normalCamera", false);
 		MPlugArray normalConnections;
@@ -457,9 +844,143 @@ namespace mb
 		return false;
 	}
 
+	void Bridge::requestTextures(uint32_t _index)
+	{
+		if (!m_textureCache.isEnabled())
+		{
+			return;
+		}
+
+		const Material& material = m_writer.getMaterial(_index);
+		const uint32_t paths[MAYABRIDGE_TEXTURE_COUNT] =
+		{
+			material.baseColorTexture,
+			material.metallicTexture,
+			material.roughnessTexture,
+			material.normalTexture,
+			material.occlusionTexture,
+			material.emissiveTexture,
+		};
+
+		for (uint32_t slot = 0; slot < MAYABRIDGE_TEXTURE_COUNT; ++slot)
+		{
+			if (paths[slot] == 0)
+			{
+				continue;
+			}
+
+			// Shared by every material using the file in the same way
+			uint64_t key = (uint64_t(paths[slot]) << 32) | slot;
+			auto it = m_textures.find(key);
+			if (it != m_textures.end())
+			{
+				TextureEntry& entry = it->second;
+				if (entry.cache != 0)
+				{
+					m_writer.editMaterial(_index).textureCache[slot] = entry.cache;
+				}
+				else if (entry.pending)
+				{
+					entry.materials.push_back(_index);
+				}
+				continue;
+			}
+
+			TextureEntry& entry = m_textures[key];
+			entry.path = m_writer.getString(paths[slot]);
+			entry.slot = slot;
+			entry.cache = 0;
+			entry.pending = true;
+			entry.materials.push_back(_index);
+
+			// Hashing the file is all a cache hit costs, the workers do it
+			std::string path = entry.path;
+			uint32_t generation = m_textureGeneration;
+			bool bc7 = m_textureBc7;
+			m_jobs.submit([this, key, path, slot, generation, bc7]()
+			{
+				CompletedTexture completed;
+				completed.entry = key;
+				completed.generation = generation;
+				completed.key = 0;
+				completed.read = m_textureCache.getKey(path, slot, bc7, completed.key);
+				completed.cached = completed.read && m_textureCache.contains(completed.key);
+				completed.decoded = false;
+
+				std::lock_guard<std::mutex> lock(m_completedMutex);
+				m_completedTextures.push_back(completed);
+			});
+		}
+	}
+
+	bool Bridge::processCompletedTextures()
+	{
+		std::vector<CompletedTexture> completedTextures;
+		{
+			std::lock_guard<std::mutex> lock(m_completedMutex);
+			completedTextures.swap(m_completedTextures);
+		}
+
+		bool write = false;
+		for (const CompletedTexture& completed : completedTextures)
+		{
+			// The scene reloaded while the workers had it
+			auto it = m_textures.find(completed.entry);
+			if (completed.generation != m_textureGeneration || it == m_textures.end())
+			{
+				continue;
+			}
+
+			TextureEntry& entry = it->second;
+			if (!completed.cached && completed.read && !completed.decoded)
+			{
+				m_queueTextureDecode.push(completed);
+				continue;
+			}
+
+			entry.pending = false;
+			if (completed.cached)
+			{
+				entry.cache = m_writer.internString(m_textureCache.getPath(completed.key).c_str());
+			}
+			if (entry.cache == 0)
+			{
+				MStreamUtils::stdOutStream() << "Failed to preprocess texture: " << entry.path << "\n";
+				entry.materials.clear();
+				continue;
+			}
+
+			for (uint32_t material : entry.materials)
+			{
+				m_writer.editMaterial(material).textureCache[entry.slot] = entry.cache;
+				m_writer.stageEvent(MAYABRIDGE_EVENT_MATERIAL_CHANGED, material);
+			}
+			entry.materials.clear();
+			write = true;
+
+			MStreamUtils::stdOutStream() << "Cached texture: " << entry.path << "\n";
+		}
+
+		return write;
+	}
+
 	Bridge::Bridge()
 		: m_writeBuffer(NULL)
-		, m_readBuffer(NULL)
+		, m_sceneCapacity(MAYABRIDGE_CONFIG_SCENE_CAPACITY)
+		, m_hierarchyDirty(false)
+		, m_updateBudgetMs(MAYABRIDGE_CONFIG_UPDATE_BUDGET_MS)
+		, m_vertexFormat(MAYABRIDGE_CONFIG_VERTEX_FORMAT)
+		, m_vertexLayout(MAYABRIDGE_CONFIG_VERTEX_LAYOUT)
+		, m_optimizeMeshes(MAYABRIDGE_CONFIG_OPTIMIZE_MESHES != 0)
+		, m_meshlets(MAYABRIDGE_CONFIG_MESHLETS != 0)
+		, m_lodMinTriangles(MAYABRIDGE_CONFIG_LOD_MIN_TRIANGLES)
+		, m_numPendingMeshes(0)
+		, m_reloading(false)
+		, m_textureBc7(MAYABRIDGE_CONFIG_TEXTURE_BC7 != 0)
+		, m_textureGeneration(0)
+		, m_snapshotOnSave(MAYABRIDGE_CONFIG_SNAPSHOT_ON_SAVE != 0)
+		, m_snapshotPending(false)
+		, m_snapshotWriting(false)
 	{
 	}
 
@@ -471,26 +992,130 @@ namespace mb
 	{
 		MStatus status = MS::kSuccess;
 
+		// Size of the scene mapping, only committed as the scene grows into it
+		bool exists = false;
+		int sceneCapacityMb = MGlobal::optionVarIntValue("mayaBridgeSceneCapacityMb", &exists);
+		if (exists && sceneCapacityMb > 0)
+		{
+			m_sceneCapacity = uint64_t(sceneCapacityMb) << 20;
+		}
+		MStreamUtils::stdOutStream() << "Scene capacity: " << (m_sceneCapacity >> 20) << "MB" << "\n";
+
 		// Initialize the shared memory
 		m_writeBuffer = new SharedBuffer();
-		if (!m_writeBuffer->init("maya-bridge-write", sizeof(mb::SharedData)))
+		if (!m_writeBuffer->init("maya-bridge-write", m_sceneCapacity, MAYABRIDGE_BUFFER_HUGE_PAGES))
 		{
 			MStreamUtils::stdOutStream() << "Failed to sync shared memory!" << "\n";
 			return status;
 		}
 
-		m_readBuffer = new SharedBuffer();
-		if (!m_readBuffer->init("maya-bridge-read", sizeof(uint32_t)))
+		if (!m_writer.init(*m_writeBuffer))
 		{
 			MStreamUtils::stdOutStream() << "Failed to sync shared memory!" << "\n";
 			return status;
 		}
 
-		// Add callbacks
-		addCallbacks();
+		// Per tick extraction budget, can be overridden with an optionVar
+		double budgetMs = MGlobal::optionVarDoubleValue("mayaBridgeUpdateBudgetMs", &exists);
+		if (exists && budgetMs > 0.0)
+		{
+			m_updateBudgetMs = float(budgetMs);
+		}
+		MStreamUtils::stdOutStream() << "Update budget: " << m_updateBudgetMs << "ms" << "\n";
 
-		return status;
-	}
+		// Vertex format, the consumer can also ask for another one
+		int vertexFormat = MGlobal::optionVarIntValue("mayaBridgeVertexFormat", &exists);
+		if (exists && vertexFormat >= 0 && uint32_t(vertexFormat) < MAYABRIDGE_VERTEX_FORMAT_COUNT)
+		{
+			m_vertexFormat = uint32_t(vertexFormat);
+		}
+		MStreamUtils::stdOutStream() << "Vertex format: " << m_vertexFormat << "\n";
+
+		// Interleaved or one stream per attribute group, for the whole session
+		int vertexLayout = MGlobal::optionVarIntValue("mayaBridgeVertexLayout", &exists);
+		if (exists && vertexLayout >= 0 && uint32_t(vertexLayout) < MAYABRIDGE_VERTEX_LAYOUT_COUNT)
+		{
+			m_vertexLayout = uint32_t(vertexLayout);
+		}
+		MStreamUtils::stdOutStream() << "Vertex layout: " << m_vertexLayout << "\n";
+
+		// Cache optimization of the index buffers
+		int optimizeMeshes = MGlobal::optionVarIntValue("mayaBridgeOptimizeMeshes", &exists);
+		if (exists)
+		{
+			m_optimizeMeshes = optimizeMeshes != 0;
+		}
+		MStreamUtils::stdOutStream() << "Optimize meshes: " << (m_optimizeMeshes ? "on" : "off") << "\n";
+
+		// Meshlets for mesh shader consumers
+		int meshlets = MGlobal::optionVarIntValue("mayaBridgeMeshlets", &exists);
+		if (exists)
+		{
+			m_meshlets = meshlets != 0;
+		}
+		MStreamUtils::stdOutStream() << "Meshlets: " << (m_meshlets ? "on" : "off") << "\n";
+
+		// Levels of detail for heavy meshes, 0 turns them off
+		int lodMinTriangles = MGlobal::optionVarIntValue("mayaBridgeLodMinTriangles", &exists);
+		if (exists && lodMinTriangles >= 0)
+		{
+			m_lodMinTriangles = uint32_t(lodMinTriangles);
+		}
+		MStreamUtils::stdOutStream() << "LOD min triangles: " << m_lodMinTriangles << "\n";
+
+		// Texture preprocessing, off without a cache directory
+		std::string textureCache = MAYABRIDGE_CONFIG_TEXTURE_CACHE_DIR;
+		MString textureCacheVar = MGlobal::optionVarStringValue("mayaBridgeTextureCache", &exists);
+		if (exists)
+		{
+			textureCache = textureCacheVar.asChar();
+		}
+		if (!m_textureCache.init(textureCache))
+		{
+			MStreamUtils::stdOutStream() << "Failed to create texture cache: " << textureCache << "\n";
+		}
+		int textureBc7 = MGlobal::optionVarIntValue("mayaBridgeTextureBc7", &exists);
+		if (exists)
+		{
+			m_textureBc7 = textureBc7 != 0;
+		}
+		MStreamUtils::stdOutStream() << "Texture cache: " << (m_textureCache.isEnabled() ? textureCache : "off") << "\n";
+
+		// Snapshot files for consumers to start from
+		int snapshotOnSave = MGlobal::optionVarIntValue("mayaBridgeSnapshotOnSave", &exists);
+		if (exists)
+		{
+			m_snapshotOnSave = snapshotOnSave != 0;
+		}
+		MString snapshotPath = MGlobal::optionVarStringValue("mayaBridgeSnapshotPath", &exists);
+		if (exists)
+		{
+			m_snapshotPath = snapshotPath.asChar();
+		}
+		MStreamUtils::stdOutStream() << "Snapshot on save: " << (m_snapshotOnSave ? "on" : "off") << "\n";
+
+		// Stream recording for profiling consumers without Maya
+		std::string recordPath = MAYABRIDGE_CONFIG_RECORD_PATH;
+		MString recordPathVar = MGlobal::optionVarStringValue("mayaBridgeRecordPath", &exists);
+		if (exists)
+		{
+			recordPath = recordPathVar.asChar();
+		}
+		if (!recordPath.empty() && !m_writer.startRecording(recordPath.c_str()))
+		{
+			MStreamUtils::stdOutStream() << "Failed to create stream recording: " << recordPath << "\n";
+		}
+		MStreamUtils::stdOutStream() << "Stream recording: " << (m_writer.isRecording() ? recordPath : "off") << "\n";
+
+		// Start the mesh conversion workers
+		m_jobs.init();
+		MStreamUtils::stdOutStream() << "Worker threads: " << m_jobs.getNumThreads() << "\n";
+
+		// Add callbacks
+		addCallbacks();
+
+		return status;
+	}
 
 	MStatus Bridge::uninitialize()
 	{
@@ -499,86 +1124,702 @@ namespace mb
 		// Remove callbacks
 		removeCallbacks();
 
+		// Wait for the workers, they write into the shared memory
+		m_jobs.shutdown();
+
+		// Flush the recording while the writer is still around
+		m_writer.stopRecording();
+
 		// Shutdown the shared memory
 		m_writeBuffer->shutdown();
 		delete m_writeBuffer;
 
-		m_readBuffer->shutdown();
-		delete m_readBuffer;
-
 		// Destroy plugin
 		return status;
 	}
 
 	void Bridge::update()
 	{
-		uint32_t status = UINT32_MAX;
-		m_readBuffer->read(&status, sizeof(uint32_t));
+		bool write = false;
 
-		if (status == MAYABRIDGE_MESSAGE_RECEIVED)
+		// Requests from the consumer, a new vertex format or layout needs every mesh again
+		uint32_t request = m_writer.takeRequest();
+		if ((request & MAYABRIDGE_MESSAGE_MASK) == MAYABRIDGE_MESSAGE_VERTEX_FORMAT)
+		{
+			uint32_t vertexFormat = request & ~MAYABRIDGE_MESSAGE_MASK;
+			if (vertexFormat < MAYABRIDGE_VERTEX_FORMAT_COUNT && vertexFormat != m_vertexFormat)
+			{
+				MStreamUtils::stdOutStream() << "Vertex format: " << vertexFormat << "\n";
+				m_vertexFormat = vertexFormat;
+				request = MAYABRIDGE_MESSAGE_RELOAD_SCENE;
+			}
+		}
+		else if ((request & MAYABRIDGE_MESSAGE_MASK) == MAYABRIDGE_MESSAGE_VERTEX_LAYOUT)
 		{
-			bool write = false;
-			
-			// Process
-			if (!m_queueMaterialAdded.empty())
+			uint32_t vertexLayout = request & ~MAYABRIDGE_MESSAGE_MASK;
+			if (vertexLayout < MAYABRIDGE_VERTEX_LAYOUT_COUNT && vertexLayout != m_vertexLayout)
 			{
-				MStreamUtils::stdOutStream() << "Processing material..." << "\n";
+				MStreamUtils::stdOutStream() << "Vertex layout: " << vertexLayout << "\n";
+				m_vertexLayout = vertexLayout;
+				request = MAYABRIDGE_MESSAGE_RELOAD_SCENE;
+			}
+		}
+
+		if (request == MAYABRIDGE_MESSAGE_WRITE_SNAPSHOT)
+		{
+			m_snapshotPending = true;
+		}
+
+		if (request == MAYABRIDGE_MESSAGE_RELOAD_SCENE)
+		{
+			m_writer.reset();
+			untrackAllModels();
+
+			m_queueModelAdded = {};
+			m_queueModelRemoved = {};
+			m_queueMaterialAdded = {};
+			m_queueMaterialRemoved = {};
+
+			// Texture entries point at material slots and path ids of the old scene
+			m_textures.clear();
+			m_queueTextureDecode = {};
+			m_textureGeneration += 1;
 
-				MObject& object = m_queueMaterialAdded.front();
-				if (!object.isNull())
+			addAllMaterials();
+			addAllModels();
+			m_reloading = true;
+			write = true;
+		}
+
+		Scene& scene = m_writer.getScene();
+
+		// Removals are cheap, drain them all
+		while (!m_queueModelRemoved.empty())
+		{
+			MObject& object = m_queueModelRemoved.front();
+			for (uint32_t ii = 0; ii < m_modelNodes.size(); ++ii)
+			{
+				if (m_modelNodes[ii] && m_modelNodes[ii]->node == object)
 				{
-					Material& material = m_shared.materials[m_shared.numMaterials];
+					// An instanced shape outlives the transform the model was
+					// found through, carry on with one of its other instances
+					ModelNode& node = *m_modelNodes[ii];
+					MDagPathArray paths;
+					if (node.mesh.isValid())
+					{
+						MDagPath::getAllPathsTo(node.mesh.object(), paths);
+					}
+					MObject next;
+					for (uint32_t jj = 0; jj < paths.length() && next.isNull(); ++jj)
+					{
+						MDagPath path = paths[jj];
+						path.pop();
+						next = path.node() == object ? MObject() : path.node();
+					}
+					if (!next.isNull())
+					{
+						node.node = MObjectHandle(next);
+						m_hierarchyDirty = true;
+						processName(m_writer.editModel(ii), next);
+						write = true;
+						break;
+					}
 
-					processMaterial(material, object);
+					MStreamUtils::stdOutStream() << "Removing model: " << m_writer.getString(m_writer.getModel(ii).name) << "\n";
 
-					m_shared.numMaterials += 1;
-					m_queueMaterialAdded.pop();
+					m_writer.removeModel(ii);
+					untrackModel(ii);
+					m_hierarchyDirty = true;
 					write = true;
+					break;
 				}
 			}
-			else if (!m_queueModelAdded.empty())
+			m_queueModelRemoved.pop();
+		}
+
+		// Publish meshes, textures and snapshot files the workers have finished
+		write |= processCompletedMeshes();
+		write |= processCompletedTextures();
+		write |= processCompletedSnapshots();
+
+		// Edited meshes go out as deltas, or are converted again
+		processDirtyMeshes();
+
+		// Drain as much as fits in the budget, but always make progress.
+		// Textures only decode once the scene is out.
+		Stats& stats = scene.stats;
+		if (!m_queueMaterialAdded.empty() || !m_queueModelAdded.empty() || !m_queueTextureDecode.empty())
+		{
+			typedef std::chrono::steady_clock Clock;
+
+			std::chrono::microseconds budget(int64_t(m_updateBudgetMs * 1000.0f));
+			Clock::time_point start = Clock::now();
+			Clock::time_point deadline = start + budget;
+
+			uint32_t numProcessed = 0;
+			bool overBudget = false;
+			do
 			{
-				MStreamUtils::stdOutStream() << "Processing model..." << "\n";
+				Clock::time_point itemStart = Clock::now();
 
-				MObject& object = m_queueModelAdded.front();
-				if (!object.isNull())
+				if (!m_queueMaterialAdded.empty())
 				{
-					Model& model = m_shared.models[m_shared.numModels];
+					write |= processQueuedMaterial();
+					stats.materialsProcessed += 1;
+				}
+				else if (!m_queueModelAdded.empty())
+				{
+					write |= processQueuedModel();
+					stats.modelsProcessed += 1;
+				}
+				else
+				{
+					write |= processQueuedTexture();
+				}
+				numProcessed += 1;
 
-					processName(model, object);
-					processTransform(model, object);
-					processMeshes(model, object);
+				overBudget |= Clock::now() - itemStart > budget;
+			}
+			while ((!m_queueMaterialAdded.empty() || !m_queueModelAdded.empty() || !m_queueTextureDecode.empty()) && Clock::now() < deadline);
 
-					m_shared.numModels += 1;
-					m_queueModelAdded.pop();
-					write = true;
+			uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+			stats.busyTicks += 1;
+			stats.overBudgetTicks += overBudget ? 1 : 0;
+			stats.busyMicroseconds += elapsed;
+			stats.queuedMaterials = uint32_t(m_queueMaterialAdded.size());
+			stats.queuedModels = uint32_t(m_queueModelAdded.size());
+
+			MStreamUtils::stdOutStream() << "Processed " << numProcessed << " items in " << elapsed << "us, "
+				<< stats.queuedMaterials + stats.queuedModels << " left" << "\n";
+		}
+		stats.budgetMs = m_updateBudgetMs;
+		stats.pendingMeshes = m_numPendingMeshes;
+
+		// Every tracked path is walked again, so not while the scene is loading
+		if (m_hierarchyDirty && m_queueModelAdded.empty())
+		{
+			rebuildHierarchy();
+			write = true;
+		}
+
+		// Transforms that only moved go out as a batch of local matrices,
+		// unless the whole scene is published anyway
+		if (processDirtyTransforms())
+		{
+			if (write)
+			{
+				m_writer.updateHierarchy(false);
+			}
+			else
+			{
+				m_writer.publishTransforms(m_dirtyTransforms.data(), uint32_t(m_dirtyTransforms.size()));
+			}
+		}
+		m_dirtyTransforms.clear();
+
+		// Meshes of the old scene that the reload didn't pick up again
+		if (m_reloading && m_queueModelAdded.empty() && m_numPendingMeshes == 0)
+		{
+			m_writer.trimMeshCache();
+			m_reloading = false;
+		}
+
+		// Publish, the consumer picks the events up whenever it gets to them
+		if (write)
+		{
+			m_writer.publish();
+		}
+
+		// A snapshot file waits for the scene to be out, so it holds all of it
+		if (m_snapshotPending && !m_snapshotWriting && m_queueMaterialAdded.empty() && m_queueModelAdded.empty() && m_numPendingMeshes == 0 && !m_hierarchyDirty)
+		{
+			m_snapshotPending = false;
+			writeSnapshot();
+		}
+	}
+
+	void Bridge::writeSnapshot()
+	{
+		std::string path = m_snapshotPath;
+		if (path.empty())
+		{
+			path = std::string(MFileIO::currentFile().asChar()) + ".mbscene";
+		}
+
+		// Only the copy is on the main thread, the disk is left to a worker
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::shared_ptr<SnapshotData> snapshot = std::make_shared<SnapshotData>();
+		m_writer.captureSnapshot(path.c_str(), *snapshot);
+		uint64_t captureMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+		m_snapshotWriting = true;
+		m_jobs.submit([this, snapshot, captureMs]()
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			CompletedSnapshot completed;
+			completed.path = snapshot->path;
+			completed.written = SceneWriter::writeSnapshot(*snapshot);
+			completed.captureMs = captureMs;
+			completed.writeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+			std::lock_guard<std::mutex> lock(m_completedMutex);
+			m_completedSnapshots.push_back(completed);
+		});
+	}
+
+	bool Bridge::processCompletedSnapshots()
+	{
+		std::vector<CompletedSnapshot> completedSnapshots;
+		{
+			std::lock_guard<std::mutex> lock(m_completedMutex);
+			completedSnapshots.swap(m_completedSnapshots);
+		}
+
+		bool write = false;
+		for (const CompletedSnapshot& completed : completedSnapshots)
+		{
+			m_snapshotWriting = false;
+			if (!completed.written)
+			{
+				MStreamUtils::stdOutStream() << "Failed to write snapshot: " << completed.path << "\n";
+				continue;
+			}
+
+			m_writer.stageEvent(MAYABRIDGE_EVENT_SNAPSHOT_WRITTEN);
+			write = true;
+
+			MStreamUtils::stdOutStream() << "Wrote snapshot: " << completed.path << " in " << completed.captureMs << "ms + " << completed.writeMs << "ms on a worker" << "\n";
+		}
+
+		return write;
+	}
+
+	bool Bridge::processQueuedMaterial()
+	{
+		MStreamUtils::stdOutStream() << "Processing material..." << "\n";
+
+		MObject object = m_queueMaterialAdded.front();
+		m_queueMaterialAdded.pop();
+
+		if (object.isNull())
+		{
+			return false;
+		}
+
+		MFnDependencyNode shaderFn(object);
+		uint32_t index = m_writer.addMaterial(shaderFn.name().asChar());
+
+		processMaterial(m_writer.editMaterial(index), object);
+		requestTextures(index);
+		return true;
+	}
+
+	bool Bridge::processQueuedTexture()
+	{
+		CompletedTexture completed = m_queueTextureDecode.front();
+		m_queueTextureDecode.pop();
+
+		auto it = m_textures.find(completed.entry);
+		if (it == m_textures.end())
+		{
+			return false;
+		}
+		TextureEntry& entry = it->second;
+
+		MStreamUtils::stdOutStream() << "Decoding texture: " << entry.path << "\n";
+
+		// MImage reads whatever Maya can, but only on the main thread. Its
+		// rows start at the bottom.
+		MImage image;
+		unsigned int width = 0;
+		unsigned int height = 0;
+		if (image.readFromFile(entry.path.c_str(), MImage::kByte) != MS::kSuccess || image.depth() != 4)
+		{
+			MStreamUtils::stdOutStream() << "Failed to decode texture: " << entry.path << "\n";
+			entry.pending = false;
+			entry.materials.clear();
+			return false;
+		}
+		image.getSize(width, height);
+		image.verticalFlip();
+
+		std::shared_ptr<TextureImage> decoded = std::make_shared<TextureImage>();
+		decoded->width = width;
+		decoded->height = height;
+		decoded->pixels.assign(image.pixels(), image.pixels() + size_t(width) * height * 4);
+
+		// Mips, compression and the cache write go to the workers
+		completed.decoded = true;
+		uint32_t slot = entry.slot;
+		bool bc7 = m_textureBc7;
+		m_jobs.submit([this, completed, decoded, slot, bc7]() mutable
+		{
+			if (decoded->width != 0 && decoded->height != 0)
+			{
+				uint32_t flags = 0;
+				uint32_t format = chooseTextureFormat(slot, *decoded, bc7, flags);
+
+				std::vector<uint8_t> file;
+				encodeTexture(*decoded, format, flags, file);
+				completed.cached = m_textureCache.store(completed.key, file);
+			}
+
+			std::lock_guard<std::mutex> lock(m_completedMutex);
+			m_completedTextures.push_back(completed);
+		});
+
+		return false;
+	}
+
+	bool Bridge::processQueuedModel()
+	{
+		MStreamUtils::stdOutStream() << "Processing model..." << "\n";
+
+		MObject object = m_queueModelAdded.front();
+		m_queueModelAdded.pop();
+
+		// Another path to a shape that is already a model only adds an instance
+		uint32_t existing = object.isNull() ? UINT32_MAX : findMeshModel(findMesh(object));
+		if (existing != UINT32_MAX)
+		{
+			MStreamUtils::stdOutStream() << "  Instance of: " << m_writer.getString(m_writer.getModel(existing).name) << "\n";
+
+			processInstances(existing);
+			return true;
+		}
+
+		uint32_t index = object.isNull() ? UINT32_MAX : m_writer.addModel();
+		if (index == UINT32_MAX)
+		{
+			return false;
+		}
+
+		Model& model = m_writer.editModel(index);
+
+		trackModel(index, object);
+
+		processName(model, object);
+		MStreamUtils::stdOutStream() << "  Processing transform..." << "\n";
+		processInstances(index);
+		processMeshes(index, object);
+		return true;
+	}
+
+	void Bridge::trackModel(uint32_t _index, const MObject& _obj)
+	{
+		if (_index >= m_modelNodes.size())
+		{
+			m_modelNodes.resize(_index + 1);
+		}
+
+		std::unique_ptr<ModelNode> node(new ModelNode());
+		node->bridge = this;
+		node->index = _index;
+		node->node = MObjectHandle(_obj);
+		node->meshDirty = false;
+		node->topologyDirty = false;
+		node->meshPending = false;
+		node->deformed = false;
+		node->numResyncs = 0;
+
+		// Component edits and deformers dirty the mesh, topology edits also
+		// tell us the vertex numbering changed
+		MStatus status;
+		MCallbackId callbackId;
+		MObject mesh = findMesh(_obj);
+		if (!mesh.isNull())
+		{
+			node->mesh = MObjectHandle(mesh);
+			m_meshModels.insert(std::make_pair(node->mesh.hashCode(), _index));
+
+			callbackId = MNodeMessage::addNodeDirtyPlugCallback(mesh, callbackMeshDirty, node.get(), &status);
+			if (status == MS::kSuccess)
+			{
+				node->callbacks.append(callbackId);
+			}
+
+			callbackId = MPolyMessage::addPolyTopologyChangedCallback(mesh, callbackTopologyChanged, node.get(), &status);
+			if (status == MS::kSuccess)
+			{
+				node->callbacks.append(callbackId);
+			}
+		}
+
+		m_modelNodes[_index] = std::move(node);
+	}
+
+	void Bridge::untrackModel(uint32_t _index)
+	{
+		std::unique_ptr<ModelNode>& node = m_modelNodes[_index];
+		if (node)
+		{
+			MMessage::removeCallbacks(node->callbacks);
+
+			auto range = m_meshModels.equal_range(node->mesh.hashCode());
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				if (it->second == _index)
+				{
+					m_meshModels.erase(it);
+					break;
 				}
 			}
-			
-			// Write
-			if (write)
+		}
+		node.reset();
+	}
+
+	void Bridge::untrackAllModels()
+	{
+		for (uint32_t ii = 0; ii < m_modelNodes.size(); ++ii)
+		{
+			untrackModel(ii);
+		}
+		m_modelNodes.clear();
+		m_meshModels.clear();
+		m_dirtyMeshes.clear();
+
+		untrackTransforms();
+		m_hierarchyDirty = false;
+	}
+
+	uint32_t Bridge::trackTransform(const MDagPath& _path)
+	{
+		// Parents are tracked first, so they always have the lower index
+		uint32_t parent = UINT32_MAX;
+		if (_path.length() > 1)
+		{
+			MDagPath parentPath(_path);
+			parentPath.pop();
+			parent = trackTransform(parentPath);
+		}
+
+		// A path is its parent path and the node at the end of it
+		MObjectHandle handle(_path.node());
+		uint64_t key = (uint64_t(parent) << 32) | handle.hashCode();
+		auto range = m_transformPaths.equal_range(key);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (m_transformNodes[it->second]->node == handle)
 			{
-				m_writeBuffer->write(&m_shared, sizeof(mb::SharedData));
+				return it->second;
+			}
+		}
+
+		uint32_t index = uint32_t(m_transformNodes.size());
+
+		std::unique_ptr<TransformNode> node(new TransformNode());
+		node->bridge = this;
+		node->index = index;
+		node->path = _path;
+		node->node = handle;
+		node->dirty = false;
+
+		MStatus status;
+		MCallbackId callbackId = MNodeMessage::addNodeDirtyPlugCallback(_path.node(), callbackTransformDirty, node.get(), &status);
+		if (status == MS::kSuccess)
+		{
+			node->callbacks.append(callbackId);
+		}
+
+		m_transformPaths.insert(std::make_pair(key, index));
+		m_transformHashes.insert(handle.hashCode());
+		m_transformNodes.push_back(std::move(node));
+
+		std::vector<HierarchyNode>& hierarchy = m_writer.getHierarchy();
+		HierarchyNode hierarchyNode;
+		getLocalMatrix(_path, hierarchyNode.local);
+		hierarchyNode.parent = parent;
+		hierarchyNode.padding = 0;
+		hierarchy.push_back(hierarchyNode);
+
+		m_worldMatrices.resize(hierarchy.size() * 16);
+		propagateHierarchy(hierarchy.data(), uint32_t(hierarchy.size()), index, m_worldMatrices.data());
+		return index;
+	}
+
+	void Bridge::untrackTransforms()
+	{
+		for (const std::unique_ptr<TransformNode>& node : m_transformNodes)
+		{
+			MMessage::removeCallbacks(node->callbacks);
+		}
+		m_transformNodes.clear();
+		m_transformPaths.clear();
+		m_transformHashes.clear();
+		m_worldMatrices.clear();
+		m_dirtyTransforms.clear();
+		m_writer.getHierarchy().clear();
+	}
 
-				status = MAYABRIDGE_MESSAGE_NONE;
-				m_readBuffer->write(&status, sizeof(uint32_t));
+	void Bridge::rebuildHierarchy()
+	{
+		// Nodes nothing uses anymore are dropped and the rest renumbered, an
+		// instance table only changes if its numbers do
+		untrackTransforms();
+		for (uint32_t ii = 0; ii < m_modelNodes.size(); ++ii)
+		{
+			if (m_modelNodes[ii])
+			{
+				processInstances(ii);
 			}
 		}
-		else if (status == MAYABRIDGE_MESSAGE_RELOAD_SCENE)
+
+		m_writer.updateHierarchy(true);
+		m_hierarchyDirty = false;
+	}
+
+	bool Bridge::processDirtyTransforms()
+	{
+		std::vector<HierarchyNode>& hierarchy = m_writer.getHierarchy();
+
+		// Nodes that were only dirtied, without their matrix changing, are dropped
+		uint32_t first = UINT32_MAX;
+		uint32_t count = 0;
+		for (uint32_t index : m_dirtyTransforms)
 		{
-			m_shared.resetMaterials();
-			m_shared.resetModels();
+			TransformNode& node = *m_transformNodes[index];
+			node.dirty = false;
+			if (!node.path.isValid())
+			{
+				continue;
+			}
 
-			addAllMaterials();
-			addAllModels();
+			float local[16];
+			getLocalMatrix(node.path, local);
+			if (memcmp(local, hierarchy[index].local, sizeof(local)) == 0)
+			{
+				continue;
+			}
 
-			status = MAYABRIDGE_MESSAGE_RECEIVED;
-			m_readBuffer->write(&status, sizeof(uint32_t));
+			memcpy(hierarchy[index].local, local, sizeof(local));
+			first = index < first ? index : first;
+			m_dirtyTransforms[count++] = index;
 		}
-		else
+		m_dirtyTransforms.resize(count);
+
+		if (count == 0)
+		{
+			return false;
+		}
+
+		// One pass brings every descendant along, which also tells which
+		// models have to catch up
+		uint32_t numNodes = uint32_t(hierarchy.size());
+		propagateHierarchy(hierarchy.data(), numNodes, first, m_worldMatrices.data());
+
+		std::vector<bool> moved(numNodes, false);
+		for (uint32_t index : m_dirtyTransforms)
 		{
-			m_shared.resetMaterials();
-			m_shared.resetModels();
+			moved[index] = true;
+		}
+		for (uint32_t ii = first; ii < numNodes; ++ii)
+		{
+			moved[ii] = moved[ii] || (hierarchy[ii].parent != UINT32_MAX && moved[hierarchy[ii].parent]);
+		}
+
+		for (uint32_t ii = 0; ii < m_modelNodes.size(); ++ii)
+		{
+			const std::unique_ptr<ModelNode>& node = m_modelNodes[ii];
+			for (size_t jj = 0; node && jj < node->instances.size(); ++jj)
+			{
+				if (moved[node->instances[jj].node])
+				{
+					updateWorld(ii);
+					break;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void Bridge::processDirtyMeshes()
+	{
+		typedef std::chrono::steady_clock Clock;
+		Clock::time_point now = Clock::now();
+
+		// Meshes that stopped changing get their published copy rebuilt, so
+		// snapshots have what was only sent as deltas. Quietly, unless the
+		// consumer resynced and rebuilt from the stale copy in the meantime.
+		for (std::unique_ptr<ModelNode>& node : m_modelNodes)
+		{
+			if (!node || !node->deformed || node->meshDirty || node->meshPending)
+			{
+				continue;
+			}
+			if (now - node->lastDelta < std::chrono::milliseconds(MAYABRIDGE_CONFIG_MESH_SETTLE_MS))
+			{
+				continue;
+			}
+
+			node->deformed = false;
+			if (node->node.isValid())
+			{
+				processMeshes(node->index, node->node.object(), m_writer.getNumResyncs() != node->numResyncs);
+			}
+		}
+
+		std::vector<uint32_t> dirtyMeshes;
+		dirtyMeshes.swap(m_dirtyMeshes);
+
+		for (uint32_t index : dirtyMeshes)
+		{
+			if (index >= m_modelNodes.size() || !m_modelNodes[index])
+			{
+				continue;
+			}
+
+			// Wait for the running conversion, it may or may not have the edit
+			ModelNode& node = *m_modelNodes[index];
+			if (node.meshPending)
+			{
+				m_dirtyMeshes.push_back(index);
+				continue;
+			}
+
+			node.meshDirty = false;
+			if (!node.node.isValid() || !node.mesh.isValid())
+			{
+				continue;
+			}
+
+			// Points that moved go out as vertex runs. UV edits don't change
+			// the topology but can't be sent that way, buildVertexDelta refuses
+			// them and the mesh is converted again.
+			bool sent = false;
+			if (!node.topologyDirty && node.source)
+			{
+				MFnMesh fnMesh(node.mesh.object());
+
+				MeshSnapshot snapshot;
+				processPoints(snapshot.positions, snapshot.normals, fnMesh);
+				processFaceVertices(snapshot, fnMesh);
+
+				VertexDeltaData delta;
+				if (buildVertexDelta(*node.source, snapshot, delta))
+				{
+					sent = delta.runs.empty() || m_writer.publishVertices(index, delta);
+
+					if (sent && !delta.runs.empty())
+					{
+						if (!node.deformed)
+						{
+							node.deformed = true;
+							node.numResyncs = m_writer.getNumResyncs();
+						}
+						node.lastDelta = now;
+					}
+				}
+			}
+			node.topologyDirty = false;
+
+			// Otherwise the mesh is converted and sent whole
+			if (!sent)
+			{
+				node.deformed = false;
+				processMeshes(index, node.node.object());
+			}
 		}
 	}
 
@@ -615,7 +1856,7 @@ namespace mb
 			return;
 		}
 
-		Camera& camera = m_shared.camera;
+		Camera camera;
 
 		for (uint32_t ii = 0; ii < 16; ++ii)
 		{
@@ -626,7 +1867,14 @@ namespace mb
 			camera.proj[ii] = static_cast<float>(proj[ii / 4][ii % 4]);
 		}
 
-		m_writeBuffer->write(&m_shared, sizeof(mb::SharedData));
+		// Most redraws aren't caused by the camera moving.
+		if (memcmp(&camera, &m_camera, sizeof(Camera)) == 0)
+		{
+			return;
+		}
+
+		m_camera = camera;
+		m_writer.publishCamera(camera);
 	}
 
 	void Bridge::addModel(const MObject& _obj)
@@ -660,6 +1908,38 @@ namespace mb
 		m_queueModelRemoved.push(_obj);
 	}
 
+	void Bridge::markTransformDirty(TransformNode& _node)
+	{
+		// Dragging fires this for every intermediate value, only the last one
+		// before the next update matters
+		if (!_node.dirty)
+		{
+			_node.dirty = true;
+			m_dirtyTransforms.push_back(_node.index);
+		}
+	}
+
+	void Bridge::markHierarchyDirty(const MDagPath& _child)
+	{
+		// New nodes are tracked with their model, only what is already
+		// published can move in the hierarchy
+		MObject child = _child.node();
+		if (m_transformHashes.count(MObjectHandle(child).hashCode()) != 0 || findMeshModel(child) != UINT32_MAX)
+		{
+			m_hierarchyDirty = true;
+		}
+	}
+
+	void Bridge::markMeshDirty(ModelNode& _node, bool _topology)
+	{
+		_node.topologyDirty |= _topology;
+		if (!_node.meshDirty)
+		{
+			_node.meshDirty = true;
+			m_dirtyMeshes.push_back(_node.index);
+		}
+	}
+
 	void Bridge::addAllModels()
 	{
 		MItDag dagIt = MItDag(MItDag::kBreadthFirst, MFn::kInvalid);
@@ -714,16 +1994,11 @@ namespace mb
 
 	void Bridge::save()
 	{
-		uint32_t status = UINT32_MAX;
-		m_readBuffer->read(&status, sizeof(uint32_t));
+		m_writer.stageEvent(MAYABRIDGE_EVENT_SAVE_SCENE);
+		m_writer.publish();
+		m_snapshotPending |= m_snapshotOnSave;
 
-		if (status != MAYABRIDGE_MESSAGE_RELOAD_SCENE)
-		{
-			status = MAYABRIDGE_MESSAGE_SAVE_SCENE;
-			m_readBuffer->write(&status, sizeof(uint32_t));
-
-			MStreamUtils::stdOutStream() << "Saving..." << "\n";
-		}
+		MStreamUtils::stdOutStream() << "Saving..." << "\n";
 	}
 
 } // namespace mb
@@ -7,15 +7,88 @@
 
 #include "maya-bridge/shared_buffer.h"
 #include "maya-bridge/shared_data.h"
+#include "scene_writer.h"
+#include "mesh_builder.h"
+#include "mesh_simplifier.h"
+#include "texture_cache.h"
+#include "texture_encoder.h"
+#include "job_system.h"
 
+#include <maya/MDagPath.h>
 #include <maya/MObject.h>        
+#include <maya/MObjectHandle.h>
 #include <maya/MStatus.h>        
 #include <maya/MString.h>        
 #include <maya/MCallbackIdArray.h>
 
+///
+#ifndef MAYABRIDGE_CONFIG_UPDATE_BUDGET_MS
+#define MAYABRIDGE_CONFIG_UPDATE_BUDGET_MS 4.0f
+#endif // MAYABRIDGE_CONFIG_UPDATE_BUDGET_MS
+
+/// Reorder the triangles and vertices of converted meshes for the GPU
+/// vertex caches, costs a little more time on the workers.
+#ifndef MAYABRIDGE_CONFIG_OPTIMIZE_MESHES
+#define MAYABRIDGE_CONFIG_OPTIMIZE_MESHES 1
+#endif // MAYABRIDGE_CONFIG_OPTIMIZE_MESHES
+
+/// Split converted meshes into meshlets with culling bounds, for mesh
+/// shader renderers.
+#ifndef MAYABRIDGE_CONFIG_MESHLETS
+#define MAYABRIDGE_CONFIG_MESHLETS 0
+#endif // MAYABRIDGE_CONFIG_MESHLETS
+
+/// Meshes with at least this many triangles get simplified levels of detail
+/// built on the workers, 0 turns them off. The first time such a mesh is
+/// sent a coarse proxy goes out ahead of it, so it shows up right away.
+#ifndef MAYABRIDGE_CONFIG_LOD_MIN_TRIANGLES
+#define MAYABRIDGE_CONFIG_LOD_MIN_TRIANGLES 20000
+#endif // MAYABRIDGE_CONFIG_LOD_MIN_TRIANGLES
+
+/// Cells along the longest side of the grid proxy meshes are merged on.
+#ifndef MAYABRIDGE_CONFIG_LOD_PROXY_GRID
+#define MAYABRIDGE_CONFIG_LOD_PROXY_GRID 64
+#endif // MAYABRIDGE_CONFIG_LOD_PROXY_GRID
+
+/// How long a mesh has to stay unchanged after being sent as vertex deltas
+/// before the published copy is rebuilt from it.
+#ifndef MAYABRIDGE_CONFIG_MESH_SETTLE_MS
+#define MAYABRIDGE_CONFIG_MESH_SETTLE_MS 250
+#endif // MAYABRIDGE_CONFIG_MESH_SETTLE_MS
+
+/// Directory referenced textures are preprocessed into, see TextureCache.
+/// Empty leaves decoding the texture files to the consumer.
+#ifndef MAYABRIDGE_CONFIG_TEXTURE_CACHE_DIR
+#define MAYABRIDGE_CONFIG_TEXTURE_CACHE_DIR ""
+#endif // MAYABRIDGE_CONFIG_TEXTURE_CACHE_DIR
+
+/// Compress color textures to BC7 rather than BC1 and BC3, better quality
+/// for more time on the workers.
+#ifndef MAYABRIDGE_CONFIG_TEXTURE_BC7
+#define MAYABRIDGE_CONFIG_TEXTURE_BC7 1
+#endif // MAYABRIDGE_CONFIG_TEXTURE_BC7
+
+/// Write a snapshot file of the scene whenever the Maya scene is saved,
+/// next to it unless a path is set. Consumers map it to start up without
+/// waiting for the scene.
+#ifndef MAYABRIDGE_CONFIG_SNAPSHOT_ON_SAVE
+#define MAYABRIDGE_CONFIG_SNAPSHOT_ON_SAVE 1
+#endif // MAYABRIDGE_CONFIG_SNAPSHOT_ON_SAVE
+
+/// Record every publication of the session to this file, for replaying
+/// it without Maya with the stream_replay tool. Empty records nothing.
+#ifndef MAYABRIDGE_CONFIG_RECORD_PATH
+#define MAYABRIDGE_CONFIG_RECORD_PATH ""
+#endif // MAYABRIDGE_CONFIG_RECORD_PATH
+
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace mb
 {
@@ -24,22 +97,134 @@ namespace mb
 		Node();
 	};
 
+	/// Mesh a worker has packed into the shared arena, waiting for the main
+	/// thread to publish it.
+	///
+	struct CompletedMesh
+	{
+		uint32_t index; //!< Model slot.
+		uint32_t id;    //!< Model id when the mesh was submitted.
+		Mesh mesh;
+		std::shared_ptr<MeshSource> source;
+		bool written;
+		bool unchanged; //!< Same content as the mesh the model already has, nothing was written.
+		bool reused;    //!< Took a parked mesh instead of writing one.
+		bool notify;    //!< False when catching the published copy up with delivered deltas.
+		bool proxy;     //!< Stand-in sent while the full mesh is still being simplified.
+	};
+
+	/// Texture file referenced by a slot of some materials, preprocessed into
+	/// the texture cache once for all of them.
+	///
+	struct TextureEntry
+	{
+		std::string path;
+		uint32_t slot;                   //!< MAYABRIDGE_TEXTURE_*
+		uint32_t cache;                  //!< String id of the cached file, 0 until it is ready.
+		bool pending;                    //!< Still on its way, false once cached or failed.
+		std::vector<uint32_t> materials; //!< Material slots waiting for it.
+	};
+
+	/// Texture a worker is done with, found in the cache or found missing
+	/// and waiting for the main thread to decode it.
+	///
+	struct CompletedTexture
+	{
+		uint64_t entry;      //!< TextureEntry by path id and slot.
+		uint32_t generation; //!< Scene reloads when it was submitted.
+		uint64_t key;        //!< TextureCache key.
+		bool read;           //!< The file could be read.
+		bool cached;
+		bool decoded;        //!< Decoding and encoding were tried already.
+	};
+
+	struct CompletedSnapshot
+	{
+		std::string path;
+		bool written;
+		uint64_t captureMs; //!< On the main thread.
+		uint64_t writeMs;   //!< On the worker.
+	};
+
+	class Bridge;
+
+	/// Maya nodes behind a model slot. Also the client data of the callbacks
+	/// watching them, so it must not move while the model lives.
+	///
+	struct ModelNode
+	{
+		Bridge* bridge;
+		uint32_t index;                    //!< Model slot.
+		MObjectHandle node;                //!< Transform the model was found through.
+		MObjectHandle mesh;                //!< Mesh shape under the transform.
+		MCallbackIdArray callbacks;
+
+		bool meshDirty;                    //!< Mesh changed since the last update.
+		bool topologyDirty;                //!< Mesh has to be sent whole.
+		bool meshPending;                  //!< A conversion is running on the workers.
+
+		std::shared_ptr<MeshSource> source; //!< What the published mesh was built from.
+		bool deformed;                     //!< Deltas went out that the published mesh doesn't have.
+		uint64_t numResyncs;               //!< Resyncs sent when the first of those deltas went out.
+		std::chrono::steady_clock::time_point lastDelta;
+
+		std::vector<Instance> instances;   //!< Last published, the first is the model transform.
+	};
+
+	/// Transform at one DAG path, behind a node of the published hierarchy.
+	/// Also the client data of the callback watching its local matrix.
+	///
+	struct TransformNode
+	{
+		Bridge* bridge;
+		uint32_t index;                    //!< Hierarchy node.
+		MDagPath path;
+		MObjectHandle node;
+		MCallbackIdArray callbacks;
+
+		bool dirty;                        //!< Local matrix changed since the last update.
+	};
+
 	class Bridge
 	{
 		void addCallbacks();
 		void removeCallbacks();
 
 		void processName(Model& _model, const MObject& _obj);
-		void processTransform(Model& _model, const MObject& _obj);
-		void processMeshes(Model& _model, const MObject& _obj);
-		void processMesh(Model& _model, MFnMesh& fnMesh);
-		void processSubMeshes(Mesh& mesh, MFnMesh& fnMesh);
+		void processInstances(uint32_t _index);
+		void updateWorld(uint32_t _index);
+		uint32_t findMeshModel(const MObject& _mesh) const;
+		void processMeshes(uint32_t _index, const MObject& _obj, bool _notify = true);
+		void processMesh(MeshSnapshot& _snapshot, MFnMesh& fnMesh);
+		void processPoints(std::vector<float>& _positions, std::vector<float>& _normals, MFnMesh& fnMesh);
+		void processFaceVertices(MeshSnapshot& _snapshot, MFnMesh& fnMesh);
+		void processSubMeshes(MeshSnapshot& _snapshot, MFnMesh& fnMesh);
+
+		void submitMesh(uint32_t _index, std::shared_ptr<MeshSnapshot> _snapshot, bool _notify);
+		bool processCompletedMeshes();
 
 		void processMaterial(Material& _material, const MObject& _obj);
 		void processStandardSurface(Material& _material, MFnDependencyNode& shaderFn);
 		void processPhong(Material& _material, MFnDependencyNode& shaderFn);
-		bool processTexture(const MPlug& _plug, char* _outPath);
-		bool processTextureNormal(MFnDependencyNode& shaderFn, char* _outPath);
+		bool processTexture(const MPlug& _plug, uint32_t& _outPath);
+		bool processTextureNormal(MFnDependencyNode& shaderFn, uint32_t& _outPath);
+		void requestTextures(uint32_t _index);
+		bool processCompletedTextures();
+
+		bool processQueuedMaterial();
+		bool processQueuedModel();
+		bool processQueuedTexture();
+
+		void trackModel(uint32_t _index, const MObject& _obj);
+		void untrackModel(uint32_t _index);
+		void untrackAllModels();
+		uint32_t trackTransform(const MDagPath& _path);
+		void untrackTransforms();
+		void rebuildHierarchy();
+		bool processDirtyTransforms();
+		void processDirtyMeshes();
+		void writeSnapshot();
+		bool processCompletedSnapshots();
 
 	public:
 		Bridge();
@@ -54,6 +239,9 @@ namespace mb
 		void addModel(const MObject& _obj);
 		void removeModel(const MObject& _obj);
 		void addAllModels();
+		void markTransformDirty(TransformNode& _node);
+		void markHierarchyDirty(const MDagPath& _child);
+		void markMeshDirty(ModelNode& _node, bool _topology);
 
 		void addMaterial(const MObject& _obj);
 		void removeMaterial(const MObject& _obj);
@@ -63,16 +251,53 @@ namespace mb
 
 	private:
 		SharedBuffer* m_writeBuffer;
-		SharedBuffer* m_readBuffer;
-		SharedData m_shared;
+		uint64_t m_sceneCapacity;
+		SceneWriter m_writer;
+		Camera m_camera;
 
 		MCallbackIdArray m_callbackArray;
 
+		std::vector<std::unique_ptr<ModelNode>> m_modelNodes; //!< Node of each model slot, null if empty.
+		std::unordered_multimap<unsigned int, uint32_t> m_meshModels; //!< Model slot of each tracked mesh shape, by MObjectHandle::hashCode.
+		std::vector<std::unique_ptr<TransformNode>> m_transformNodes; //!< Node of each hierarchy node.
+		std::unordered_multimap<uint64_t, uint32_t> m_transformPaths; //!< Hierarchy node by parent node and MObjectHandle::hashCode.
+		std::unordered_set<unsigned int> m_transformHashes; //!< MObjectHandle::hashCode of every tracked transform.
+		std::vector<float> m_worldMatrices; //!< 16 per hierarchy node.
+		bool m_hierarchyDirty;              //!< Tracked nodes were reparented, the hierarchy is rebuilt.
+		std::vector<uint32_t> m_dirtyTransforms; //!< Hierarchy nodes.
+		std::vector<uint32_t> m_dirtyMeshes;
+		float m_updateBudgetMs;
+		uint32_t m_vertexFormat;
+		uint32_t m_vertexLayout;
+		bool m_optimizeMeshes;
+		bool m_meshlets;
+		uint32_t m_lodMinTriangles;
+
+		JobSystem m_jobs;
+		std::mutex m_completedMutex;
+		std::vector<CompletedMesh> m_completedMeshes;
+		uint32_t m_numPendingMeshes;
+		bool m_reloading;
+
+		TextureCache m_textureCache;
+		bool m_textureBc7;
+		std::unordered_map<uint64_t, TextureEntry> m_textures; //!< By path id and slot.
+		std::vector<CompletedTexture> m_completedTextures;     //!< Guarded by m_completedMutex.
+		uint32_t m_textureGeneration;
+
+		bool m_snapshotOnSave;
+		bool m_snapshotPending;     //!< Written once the scene is out.
+		bool m_snapshotWriting;     //!< A worker is writing one, the next waits for it.
+		std::vector<CompletedSnapshot> m_completedSnapshots; //!< Guarded by m_completedMutex.
+		std::string m_snapshotPath; //!< Empty for next to the Maya scene.
+
 		std::queue<MObject> m_queueModelAdded;
 		std::queue<MObject> m_queueModelRemoved;
 
 		std::queue<MObject> m_queueMaterialAdded;
 		std::queue<MObject> m_queueMaterialRemoved;
+
+		std::queue<CompletedTexture> m_queueTextureDecode;
 	};
 
 } // namespace mb
\ No newline at end of file
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "hash.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAYABRIDGE_HASH_SSE2 1
+#include <emmintrin.h>
+#else
+#define MAYABRIDGE_HASH_SSE2 0
+#endif
+
+namespace mb
+{
+	static const uint64_t s_prime32_1 = UINT64_C(0x9e3779b1);
+	static const uint64_t s_prime32_2 = UINT64_C(0x85ebca77);
+	static const uint64_t s_prime32_3 = UINT64_C(0xc2b2ae3d);
+	static const uint64_t s_prime64_1 = UINT64_C(0x9e3779b185ebca87);
+	static const uint64_t s_prime64_2 = UINT64_C(0xc2b2ae3d27d4eb4f);
+	static const uint64_t s_prime64_3 = UINT64_C(0x165667b19e3779f9);
+	static const uint64_t s_prime64_4 = UINT64_C(0x85ebca77c2b2ae63);
+	static const uint64_t s_prime64_5 = UINT64_C(0x27d4eb2f165667c5);
+
+	static const uint64_t s_secret[8] =
+	{
+		UINT64_C(0xbe4ba423396cfeb8), UINT64_C(0x1cad21f72c81017c),
+		UINT64_C(0xdb979083e96dd4de), UINT64_C(0x1f67b3b7a4a44072),
+		UINT64_C(0x78e5c0cc4ee679cb), UINT64_C(0x2172ffcc7dd05a82),
+		UINT64_C(0x8e2443f7744608b8), UINT64_C(0x4c263a81e69035e0),
+	};
+
+	static const size_t s_stripeSize = 64;
+	static const size_t s_stripesPerBlock = 16;
+
+	static uint64_t mul128Fold64(uint64_t _lhs, uint64_t _rhs)
+	{
+		// Portable 64x64->128 multiply, folded by xor of the halves.
+		uint64_t lo_lo = (_lhs & 0xffffffff) * (_rhs & 0xffffffff);
+		uint64_t hi_lo = (_lhs >> 32) * (_rhs & 0xffffffff);
+		uint64_t lo_hi = (_lhs & 0xffffffff) * (_rhs >> 32);
+		uint64_t hi_hi = (_lhs >> 32) * (_rhs >> 32);
+
+		uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+		uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+		uint64_t lower = (cross << 32) | (lo_lo & 0xffffffff);
+		return upper ^ lower;
+	}
+
+	static uint64_t avalanche(uint64_t _hash)
+	{
+		_hash ^= _hash >> 37;
+		_hash *= UINT64_C(0x165667919e3779f9);
+		_hash ^= _hash >> 32;
+		return _hash;
+	}
+
+	/// acc[i] += lo32(k) * hi32(k), acc[i ^ 1] += data[i], with k = data[i] ^ key[i].
+	///
+	static void accumulate(uint64_t* _acc, const uint8_t* _stripe, const uint64_t* _keys)
+	{
+#if MAYABRIDGE_HASH_SSE2
+		__m128i* acc = reinterpret_cast<__m128i*>(_acc);
+		for (int ii = 0; ii < 4; ++ii)
+		{
+			__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_stripe) + ii);
+			__m128i key = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(_keys) + ii));
+			__m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+			__m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+			__m128i value = _mm_loadu_si128(acc + ii);
+			_mm_storeu_si128(acc + ii, _mm_add_epi64(value, _mm_add_epi64(product, swapped)));
+		}
+#else
+		for (int ii = 0; ii < 8; ++ii)
+		{
+			uint64_t data;
+			memcpy(&data, _stripe + ii * 8, sizeof(data));
+			uint64_t key = data ^ _keys[ii];
+			_acc[ii ^ 1] += data;
+			_acc[ii] += (key & 0xffffffff) * (key >> 32);
+		}
+#endif // MAYABRIDGE_HASH_SSE2
+	}
+
+	static void scramble(uint64_t* _acc, const uint64_t* _keys)
+	{
+		for (int ii = 0; ii < 8; ++ii)
+		{
+			uint64_t acc = _acc[ii];
+			acc ^= acc >> 47;
+			acc ^= _keys[ii];
+			_acc[ii] = acc * s_prime32_1;
+		}
+	}
+
+	uint64_t hashBytes(const void* _data, size_t _size, uint64_t _seed)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(_data);
+
+		uint64_t keys[8];
+		for (int ii = 0; ii < 8; ++ii)
+		{
+			keys[ii] = s_secret[ii] + ((ii & 1) ? 0 - _seed : _seed);
+		}
+
+		uint64_t acc[8] =
+		{
+			s_prime32_3, s_prime64_1, s_prime64_2, s_prime64_3,
+			s_prime64_4, s_prime32_2, s_prime64_5, s_prime32_1,
+		};
+
+		// Whole stripes, scrambled every block so the lanes don't saturate.
+		size_t numStripes = _size / s_stripeSize;
+		for (size_t ii = 0; ii < numStripes; ++ii)
+		{
+			accumulate(acc, data + ii * s_stripeSize, keys);
+			if ((ii + 1) % s_stripesPerBlock == 0)
+			{
+				scramble(acc, keys);
+			}
+		}
+
+		// The tail is zero padded to a stripe, the length goes into the merge.
+		size_t tail = _size - numStripes * s_stripeSize;
+		if (tail != 0)
+		{
+			uint8_t stripe[s_stripeSize] = {};
+			memcpy(stripe, data + numStripes * s_stripeSize, tail);
+			accumulate(acc, stripe, keys);
+		}
+
+		uint64_t hash = uint64_t(_size) * s_prime64_1 + _seed;
+		for (int ii = 0; ii < 4; ++ii)
+		{
+			hash += mul128Fold64(acc[ii * 2] ^ s_secret[(ii * 2 + 3) & 7], acc[ii * 2 + 1] ^ s_secret[(ii * 2 + 4) & 7]);
+		}
+		return avalanche(hash);
+	}
+
+} // namespace mb
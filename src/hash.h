@@ -0,0 +1,19 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
+
+namespace mb
+{
+	/// 64-bit content hash in the style of XXH3: 64 byte stripes accumulated
+	/// in eight lanes, SSE2 where available. Values are stable across
+	/// platforms, but don't match XXH3 itself.
+	///
+	uint64_t hashBytes(const void* _data, size_t _size, uint64_t _seed = 0);
+
+} // namespace mb
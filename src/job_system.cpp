@@ -0,0 +1,86 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "job_system.h"
+
+namespace mb
+{
+	void JobSystem::workerMain()
+	{
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this] { return m_quit || !m_jobs.empty(); });
+				if (m_quit)
+				{
+					return;
+				}
+
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+
+			job();
+		}
+	}
+
+	JobSystem::JobSystem()
+		: m_quit(false)
+	{
+	}
+
+	JobSystem::~JobSystem()
+	{
+		shutdown();
+	}
+
+	void JobSystem::init(uint32_t _numThreads)
+	{
+		if (_numThreads == 0)
+		{
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			_numThreads = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		m_quit = false;
+		for (uint32_t ii = 0; ii < _numThreads; ++ii)
+		{
+			m_threads.emplace_back(&JobSystem::workerMain, this);
+		}
+	}
+
+	void JobSystem::shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+			m_jobs.clear();
+		}
+		m_condition.notify_all();
+
+		for (std::thread& thread : m_threads)
+		{
+			thread.join();
+		}
+		m_threads.clear();
+	}
+
+	void JobSystem::submit(std::function<void()> _job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(std::move(_job));
+		}
+		m_condition.notify_one();
+	}
+
+	uint32_t JobSystem::getNumThreads() const
+	{
+		return uint32_t(m_threads.size());
+	}
+
+} // namespace mb
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///
+#ifndef MAYABRIDGE_CONFIG_WORKER_THREADS
+#define MAYABRIDGE_CONFIG_WORKER_THREADS 0 // One less than the hardware threads
+#endif // MAYABRIDGE_CONFIG_WORKER_THREADS
+
+namespace mb
+{
+	/// Fixed pool of worker threads running jobs in submission order. Jobs
+	/// must not touch the Maya API, which is only safe on the main thread.
+	///
+	class JobSystem
+	{
+		void workerMain();
+
+	public:
+		JobSystem();
+		~JobSystem();
+
+		void init(uint32_t _numThreads = MAYABRIDGE_CONFIG_WORKER_THREADS);
+
+		/// Waits for running jobs, jobs that haven't started are dropped.
+		void shutdown();
+
+		void submit(std::function<void()> _job);
+
+		uint32_t getNumThreads() const;
+
+	private:
+		std::vector<std::thread> m_threads;
+
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::deque<std::function<void()>> m_jobs;
+		bool m_quit;
+	};
+
+} // namespace mb
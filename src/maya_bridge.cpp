@@ -3,16 +3,19 @@
  * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
  */
 
+#if defined(_WIN32)
 #ifndef NT_PLUGIN
 #define NT_PLUGIN
 #endif
+#define EXPORT __declspec(dllexport)
+#else
+#define EXPORT __attribute__((visibility("default")))
+#endif // defined(_WIN32)
 
 #ifndef REQUIRE_IOSTREAM
 #define REQUIRE_IOSTREAM
 #endif
 
-#define EXPORT __declspec(dllexport)
-
 #include "bridge.h"
 
 #include <maya/MFnPlugin.h>         
@@ -0,0 +1,507 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "mesh_builder.h"
+#include "bounds.h"
+#include "hash.h"
+#include "mesh_optimizer.h"
+#include "meshlet_builder.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace mb
+{
+	/// Face-vertices that share vertex, normal and uv are the same vertex.
+	///
+	struct VertexKey
+	{
+		int vertex;
+		int normal;
+		int uv;
+	};
+
+	static uint32_t hashKey(const VertexKey& _key)
+	{
+		uint32_t hash = uint32_t(_key.vertex) * 0x9e3779b1u;
+		hash ^= uint32_t(_key.normal) * 0x85ebca77u;
+		hash ^= uint32_t(_key.uv) * 0xc2b2ae3du;
+		return hash ^ (hash >> 15);
+	}
+
+	/// Welds face-vertices into unique vertices with an open addressing table,
+	/// _remap receives the vertex of every face-vertex.
+	///
+	static uint32_t weldVertices(const std::vector<VertexKey>& _keys, std::vector<uint32_t>& _remap, std::vector<uint32_t>& _firstKey)
+	{
+		uint32_t tableSize = 1;
+		while (tableSize < _keys.size() * 2)
+		{
+			tableSize <<= 1;
+		}
+		std::vector<uint32_t> table(tableSize, UINT32_MAX);
+
+		_remap.resize(_keys.size());
+		_firstKey.clear();
+
+		for (uint32_t ii = 0; ii < _keys.size(); ++ii)
+		{
+			const VertexKey& key = _keys[ii];
+
+			uint32_t slot = hashKey(key) & (tableSize - 1);
+			for (;;)
+			{
+				uint32_t vertex = table[slot];
+				if (vertex == UINT32_MAX)
+				{
+					vertex = uint32_t(_firstKey.size());
+					table[slot] = vertex;
+					_firstKey.push_back(ii);
+					_remap[ii] = vertex;
+					break;
+				}
+
+				const VertexKey& other = _keys[_firstKey[vertex]];
+				if (other.vertex == key.vertex && other.normal == key.normal && other.uv == key.uv)
+				{
+					_remap[ii] = vertex;
+					break;
+				}
+
+				slot = (slot + 1) & (tableSize - 1);
+			}
+		}
+
+		return uint32_t(_firstKey.size());
+	}
+
+	static void normalize(float* _v)
+	{
+		float length = sqrtf(_v[0] * _v[0] + _v[1] * _v[1] + _v[2] * _v[2]);
+		if (length > 1e-12f)
+		{
+			_v[0] /= length;
+			_v[1] /= length;
+			_v[2] /= length;
+		}
+	}
+
+	/// Per-vertex tangent frames from the uv gradients of the triangles,
+	/// orthogonalized against the normal.
+	///
+	static void generateTangents(MeshData& _mesh)
+	{
+		std::vector<float> bitangents(_mesh.vertices.size() * 3, 0.0f);
+
+		for (size_t ii = 0; ii + 2 < _mesh.indices.size(); ii += 3)
+		{
+			uint32_t i0 = _mesh.indices[ii + 0];
+			uint32_t i1 = _mesh.indices[ii + 1];
+			uint32_t i2 = _mesh.indices[ii + 2];
+			const Vertex& v0 = _mesh.vertices[i0];
+			const Vertex& v1 = _mesh.vertices[i1];
+			const Vertex& v2 = _mesh.vertices[i2];
+
+			float e1[3] = { v1.position[0] - v0.position[0], v1.position[1] - v0.position[1], v1.position[2] - v0.position[2] };
+			float e2[3] = { v2.position[0] - v0.position[0], v2.position[1] - v0.position[1], v2.position[2] - v0.position[2] };
+			float du1 = v1.texcoord[0] - v0.texcoord[0];
+			float dv1 = v1.texcoord[1] - v0.texcoord[1];
+			float du2 = v2.texcoord[0] - v0.texcoord[0];
+			float dv2 = v2.texcoord[1] - v0.texcoord[1];
+
+			float det = du1 * dv2 - du2 * dv1;
+			if (fabsf(det) < 1e-20f)
+			{
+				continue;
+			}
+			float r = 1.0f / det;
+
+			float t[3], b[3];
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				t[kk] = (e1[kk] * dv2 - e2[kk] * dv1) * r;
+				b[kk] = (e2[kk] * du1 - e1[kk] * du2) * r;
+			}
+
+			for (uint32_t index : { i0, i1, i2 })
+			{
+				Vertex& vertex = _mesh.vertices[index];
+				for (int kk = 0; kk < 3; ++kk)
+				{
+					vertex.tangent[kk] += t[kk];
+					bitangents[index * 3 + kk] += b[kk];
+				}
+			}
+		}
+
+		for (size_t ii = 0; ii < _mesh.vertices.size(); ++ii)
+		{
+			Vertex& vertex = _mesh.vertices[ii];
+			const float* n = vertex.normal;
+			float* t = vertex.tangent;
+
+			// Gram-Schmidt against the normal, keep the handedness of the uvs.
+			float d = n[0] * t[0] + n[1] * t[1] + n[2] * t[2];
+			t[0] -= n[0] * d;
+			t[1] -= n[1] * d;
+			t[2] -= n[2] * d;
+			normalize(t);
+
+			float c[3] =
+			{
+				n[1] * t[2] - n[2] * t[1],
+				n[2] * t[0] - n[0] * t[2],
+				n[0] * t[1] - n[1] * t[0],
+			};
+			const float* b = &bitangents[ii * 3];
+			float handedness = (c[0] * b[0] + c[1] * b[1] + c[2] * b[2]) < 0.0f ? -1.0f : 1.0f;
+
+			vertex.bitangent[0] = c[0] * handedness;
+			vertex.bitangent[1] = c[1] * handedness;
+			vertex.bitangent[2] = c[2] * handedness;
+		}
+	}
+
+	/// Submeshes hash what they draw, the mesh hashes everything that ends
+	/// up in its blob.
+	///
+	static void hashMesh(MeshData& _mesh)
+	{
+		uint64_t seed = (uint64_t(_mesh.lodLevels) << 56) | (uint64_t(_mesh.meshlets) << 48) | (uint64_t(_mesh.vertexLayout) << 32) | _mesh.vertexFormat;
+		uint64_t verticesHash = hashBytes(_mesh.vertices.data(), sizeof(Vertex) * _mesh.vertices.size(), seed);
+
+		std::vector<uint64_t> hashes;
+		hashes.push_back(verticesHash);
+		for (SubMeshData& subMesh : _mesh.subMeshes)
+		{
+			subMesh.hash = hashBytes(&_mesh.indices[subMesh.firstIndex], sizeof(uint32_t) * subMesh.numIndices, verticesHash);
+
+			hashes.push_back(subMesh.hash);
+			hashes.push_back(hashBytes(subMesh.material.data(), subMesh.material.size()));
+		}
+
+		_mesh.hash = hashBytes(hashes.data(), sizeof(uint64_t) * hashes.size());
+	}
+
+	void buildMesh(const MeshSnapshot& _snapshot, MeshData& _mesh, MeshSource* _source, const MeshSource* _previous)
+	{
+		uint32_t numFaces = uint32_t(_snapshot.faceVertexCounts.size());
+		uint32_t numFaceVertices = uint32_t(_snapshot.faceVertexIndices.size());
+		bool hasNormals = _snapshot.faceVertexNormalIds.size() == numFaceVertices;
+
+		// Key every face-vertex, polygons without uvs get -1
+		std::vector<VertexKey> keys(numFaceVertices);
+		uint32_t faceVertexOffset = 0;
+		uint32_t uvOffset = 0;
+		for (uint32_t faceIdx = 0; faceIdx < numFaces; ++faceIdx)
+		{
+			int faceVertexCount = _snapshot.faceVertexCounts[faceIdx];
+			int faceUVCount = faceIdx < _snapshot.faceUVCounts.size() ? _snapshot.faceUVCounts[faceIdx] : 0;
+			bool hasUVs = faceUVCount == faceVertexCount && uvOffset + faceUVCount <= _snapshot.faceUVIds.size();
+
+			for (int jj = 0; jj < faceVertexCount; ++jj)
+			{
+				uint32_t faceVertex = faceVertexOffset + jj;
+				VertexKey& key = keys[faceVertex];
+				key.vertex = _snapshot.faceVertexIndices[faceVertex];
+				key.normal = hasNormals ? _snapshot.faceVertexNormalIds[faceVertex] : -1;
+				key.uv = hasUVs ? _snapshot.faceUVIds[uvOffset + jj] : -1;
+			}
+
+			faceVertexOffset += faceVertexCount;
+			uvOffset += faceUVCount;
+		}
+
+		// Split face-vertices at uv seams and hard edges
+		std::vector<uint32_t> remap;
+		std::vector<uint32_t> firstKey;
+		uint32_t numVertices = weldVertices(keys, remap, firstKey);
+
+		_mesh.vertices.assign(numVertices, Vertex());
+		for (uint32_t ii = 0; ii < numVertices; ++ii)
+		{
+			const VertexKey& key = keys[firstKey[ii]];
+			Vertex& vertex = _mesh.vertices[ii];
+
+			const float* position = &_snapshot.positions[key.vertex * 3];
+			vertex.position[0] = position[0];
+			vertex.position[1] = position[1];
+			vertex.position[2] = position[2];
+
+			if (key.normal >= 0)
+			{
+				const float* normal = &_snapshot.normals[key.normal * 3];
+				vertex.normal[0] = normal[0];
+				vertex.normal[1] = normal[1];
+				vertex.normal[2] = normal[2];
+			}
+
+			if (key.uv >= 0)
+			{
+				vertex.texcoord[0] = _snapshot.us[key.uv];
+				vertex.texcoord[1] = 1.0f - _snapshot.vs[key.uv];
+			}
+		}
+
+		// Bucket triangles by shader, in shader order. Counting first lets every
+		// triangle be written straight to its final place in the index array.
+		uint32_t numShaders = uint32_t(_snapshot.materials.size());
+		bool hasTriangles = _snapshot.triangleCounts.size() == numFaces;
+
+		std::vector<uint32_t> shaderIndices(numShaders + 1, 0);
+		for (uint32_t faceIdx = 0; faceIdx < numFaces && hasTriangles; ++faceIdx)
+		{
+			int shaderIndex = faceIdx < _snapshot.faceShaders.size() ? _snapshot.faceShaders[faceIdx] : -1;
+
+			// Ensure shader index is valid
+			if (shaderIndex >= 0 && shaderIndex < int(numShaders))
+			{
+				shaderIndices[shaderIndex + 1] += _snapshot.triangleCounts[faceIdx] * 3;
+			}
+		}
+		for (uint32_t ii = 0; ii < numShaders; ++ii)
+		{
+			shaderIndices[ii + 1] += shaderIndices[ii];
+		}
+
+		_mesh.indices.resize(shaderIndices[numShaders]);
+
+		std::vector<uint32_t> cursors(shaderIndices.begin(), shaderIndices.end() - 1);
+		faceVertexOffset = 0;
+		uint32_t triangleVertexOffset = 0;
+		for (uint32_t faceIdx = 0; faceIdx < numFaces && hasTriangles; ++faceIdx)
+		{
+			int shaderIndex = faceIdx < _snapshot.faceShaders.size() ? _snapshot.faceShaders[faceIdx] : -1;
+			int faceVertexCount = _snapshot.faceVertexCounts[faceIdx];
+			int numTriangleVertices = _snapshot.triangleCounts[faceIdx] * 3;
+
+			const int* faceVertices = &_snapshot.faceVertexIndices[faceVertexOffset];
+			const int* triangleVertices = &_snapshot.triangleVertices[triangleVertexOffset];
+
+			if (shaderIndex >= 0 && shaderIndex < int(numShaders))
+			{
+				uint32_t* indices = &_mesh.indices[cursors[shaderIndex]];
+				cursors[shaderIndex] += numTriangleVertices;
+
+				// Triangles reference mesh vertices, map them back to the
+				// face-vertex so the split vertex of this polygon is used.
+				for (int jj = 0; jj < numTriangleVertices; ++jj)
+				{
+					int local = 0;
+					while (local < faceVertexCount - 1 && faceVertices[local] != triangleVertices[jj])
+					{
+						++local;
+					}
+					indices[jj] = remap[faceVertexOffset + local];
+				}
+			}
+
+			faceVertexOffset += faceVertexCount;
+			triangleVertexOffset += numTriangleVertices;
+		}
+
+		// Skip shaders that aren't assigned to any face
+		for (uint32_t ii = 0; ii < numShaders; ++ii)
+		{
+			uint32_t numIndices = shaderIndices[ii + 1] - shaderIndices[ii];
+			if (numIndices != 0)
+			{
+				SubMeshData subMesh;
+				subMesh.firstIndex = shaderIndices[ii];
+				subMesh.numIndices = numIndices;
+				subMesh.material = _snapshot.materials[ii];
+				_mesh.subMeshes.push_back(std::move(subMesh));
+			}
+		}
+
+		if (_source != NULL)
+		{
+			_source->faceIndices = _mesh.indices;
+		}
+
+		// The same topology keeps the order it was published in, the numbering
+		// must not depend on where the vertices are. Counts alone aren't the
+		// same topology, a moved seam re-welds vertices and keeps them.
+		bool keepOrder = _previous != NULL
+			&& _previous->remap.size() == numVertices
+			&& _previous->uvs.size() == numVertices
+			&& _previous->faceIndices == _mesh.indices;
+		for (uint32_t ii = 0; ii < numVertices && keepOrder; ++ii)
+		{
+			const VertexKey& key = keys[firstKey[ii]];
+			uint32_t vertex = _previous->remap[ii];
+			keepOrder = vertex < numVertices
+				&& _previous->vertices[vertex] == key.vertex
+				&& _previous->normals[vertex] == key.normal
+				&& _previous->uvs[vertex] == key.uv;
+		}
+
+		// Reorder triangles for the post-transform cache and overdraw, then
+		// number the vertices in the order they are first used.
+		std::vector<uint32_t> vertexRemap;
+		if (keepOrder)
+		{
+			vertexRemap = _previous->remap;
+			_mesh.indices = _previous->indices;
+		}
+		else if (_mesh.optimize)
+		{
+			for (const SubMeshData& subMesh : _mesh.subMeshes)
+			{
+				optimizeVertexCache(&_mesh.indices[subMesh.firstIndex], subMesh.numIndices, numVertices, MAYABRIDGE_CONFIG_VERTEX_CACHE_SIZE, _mesh.vertices[0].position, sizeof(Vertex));
+			}
+
+			optimizeVertexFetch(_mesh.indices.data(), _mesh.indices.size(), numVertices, vertexRemap);
+		}
+
+		if (!vertexRemap.empty())
+		{
+			std::vector<Vertex> vertices(numVertices);
+			std::vector<uint32_t> keys(numVertices);
+			for (uint32_t ii = 0; ii < numVertices; ++ii)
+			{
+				vertices[vertexRemap[ii]] = _mesh.vertices[ii];
+				keys[vertexRemap[ii]] = firstKey[ii];
+			}
+			_mesh.vertices.swap(vertices);
+			firstKey.swap(keys);
+		}
+
+		// Meshlets follow the triangle order, so they come after the optimization
+		if (_mesh.meshlets)
+		{
+			for (SubMeshData& subMesh : _mesh.subMeshes)
+			{
+				subMesh.firstMeshlet = uint32_t(_mesh.meshletRecords.size());
+				buildMeshlets(_mesh.vertices.data(), numVertices, &_mesh.indices[subMesh.firstIndex], subMesh.numIndices, _mesh.meshletRecords, _mesh.meshletVertices, _mesh.meshletTriangles);
+				subMesh.numMeshlets = uint32_t(_mesh.meshletRecords.size()) - subMesh.firstMeshlet;
+			}
+		}
+
+		computeBounds(_mesh.vertices.data(), numVertices, _mesh.bounds);
+		for (SubMeshData& subMesh : _mesh.subMeshes)
+		{
+			computeBounds(_mesh.vertices.data(), &_mesh.indices[subMesh.firstIndex], subMesh.numIndices, subMesh.bounds);
+		}
+
+		generateTangents(_mesh);
+		hashMesh(_mesh);
+
+		if (_source != NULL)
+		{
+			_source->vertices.resize(numVertices);
+			_source->normals.resize(numVertices);
+			_source->uvs.resize(numVertices);
+			for (uint32_t ii = 0; ii < numVertices; ++ii)
+			{
+				const VertexKey& key = keys[firstKey[ii]];
+				_source->vertices[ii] = key.vertex;
+				_source->normals[ii] = key.normal;
+				_source->uvs[ii] = key.uv;
+			}
+
+			_source->positions = _snapshot.positions;
+			_source->normalValues = _snapshot.normals;
+
+			_source->normalIds = _snapshot.faceVertexNormalIds;
+			_source->us = _snapshot.us;
+			_source->vs = _snapshot.vs;
+			_source->faceUVCounts = _snapshot.faceUVCounts;
+			_source->faceUVIds = _snapshot.faceUVIds;
+
+			_source->remap.resize(numVertices);
+			for (uint32_t ii = 0; ii < numVertices; ++ii)
+			{
+				_source->remap[ii] = vertexRemap.empty() ? ii : vertexRemap[ii];
+			}
+			_source->indices = _mesh.indices;
+		}
+	}
+
+	bool buildVertexDelta(MeshSource& _source, MeshSnapshot& _snapshot, VertexDeltaData& _delta)
+	{
+		// Runs are merged across short gaps, resending a few unchanged
+		// vertices is cheaper than a run record for each.
+		const uint32_t maxGap = 4;
+
+		std::vector<float>& positions = _snapshot.positions;
+		std::vector<float>& normals = _snapshot.normals;
+		if (positions.size() != _source.positions.size() || normals.size() != _source.normalValues.size())
+		{
+			return false;
+		}
+
+		// UV edits and hardened edges dirty the mesh like a deformation does,
+		// but split or re-weld vertices and change what they hold
+		if (_snapshot.faceVertexNormalIds != _source.normalIds
+			|| _snapshot.us != _source.us
+			|| _snapshot.vs != _source.vs
+			|| _snapshot.faceUVCounts != _source.faceUVCounts
+			|| _snapshot.faceUVIds != _source.faceUVIds)
+		{
+			return false;
+		}
+
+		_delta.runs.clear();
+		_delta.vertices.clear();
+
+		uint32_t numVertices = uint32_t(_source.vertices.size());
+		uint32_t runEnd = 0;
+		for (uint32_t ii = 0; ii < numVertices; ++ii)
+		{
+			const float* oldPosition = &_source.positions[_source.vertices[ii] * 3];
+			const float* newPosition = &positions[_source.vertices[ii] * 3];
+			bool changed = memcmp(oldPosition, newPosition, sizeof(float) * 3) != 0;
+
+			int normal = _source.normals[ii];
+			if (!changed && normal >= 0)
+			{
+				changed = memcmp(&_source.normalValues[normal * 3], &normals[normal * 3], sizeof(float) * 3) != 0;
+			}
+
+			if (!changed)
+			{
+				continue;
+			}
+
+			// Extend the last run over the gap, or start a new one
+			if (!_delta.runs.empty() && ii - runEnd <= maxGap)
+			{
+				_delta.runs.back().count = ii + 1 - _delta.runs.back().first;
+			}
+			else
+			{
+				_delta.runs.push_back({ ii, 1 });
+			}
+			runEnd = ii + 1;
+		}
+
+		for (const VertexRun& run : _delta.runs)
+		{
+			for (uint32_t ii = run.first; ii < run.first + run.count; ++ii)
+			{
+				DeltaVertex vertex;
+				memcpy(vertex.position, &positions[_source.vertices[ii] * 3], sizeof(vertex.position));
+
+				int normal = _source.normals[ii];
+				if (normal >= 0)
+				{
+					memcpy(vertex.normal, &normals[normal * 3], sizeof(vertex.normal));
+				}
+				else
+				{
+					memset(vertex.normal, 0, sizeof(vertex.normal));
+				}
+
+				_delta.vertices.push_back(vertex);
+			}
+		}
+
+		_source.positions.swap(positions);
+		_source.normalValues.swap(normals);
+		return true;
+	}
+
+} // namespace mb
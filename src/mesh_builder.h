@@ -0,0 +1,82 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include "scene_writer.h"
+
+#include <string>
+#include <vector>
+
+namespace mb
+{
+	/// Raw arrays copied out of an MFnMesh on the main thread, so the rest of
+	/// the conversion can run on a worker without touching the Maya API.
+	///
+	struct MeshSnapshot
+	{
+		std::vector<float> positions;         //!< xyz per vertex.
+		std::vector<float> normals;           //!< xyz per normal id.
+		std::vector<float> us;                //!< u per uv id.
+		std::vector<float> vs;                //!< v per uv id.
+
+		std::vector<int> faceVertexCounts;    //!< Vertices per polygon.
+		std::vector<int> faceVertexIndices;   //!< Vertex of each face-vertex.
+		std::vector<int> faceVertexNormalIds; //!< Normal of each face-vertex.
+		std::vector<int> faceUVCounts;        //!< UVs per polygon, 0 if it has none.
+		std::vector<int> faceUVIds;           //!< UV of each face-vertex of the polygons that have them.
+		std::vector<int> triangleCounts;      //!< Triangles per polygon.
+		std::vector<int> triangleVertices;    //!< Vertex of each triangle corner.
+
+		std::vector<int> faceShaders;         //!< Shader of each polygon, -1 if none.
+		std::vector<std::string> materials;   //!< Material name of each shader.
+	};
+
+	/// Where the vertices of a built mesh came from, so later edits that keep
+	/// the topology can be turned into vertex deltas.
+	///
+	struct MeshSource
+	{
+		std::vector<int> vertices;         //!< Snapshot vertex of each mesh vertex.
+		std::vector<int> normals;          //!< Snapshot normal of each mesh vertex, -1 if none.
+		std::vector<int> uvs;              //!< Snapshot uv of each mesh vertex, -1 if none.
+
+		std::vector<float> positions;      //!< Values the mesh currently holds.
+		std::vector<float> normalValues;
+
+		std::vector<int> normalIds;        //!< Snapshot arrays that only a full rebuild takes over.
+		std::vector<float> us;
+		std::vector<float> vs;
+		std::vector<int> faceUVCounts;
+		std::vector<int> faceUVIds;
+
+		std::vector<uint32_t> remap;       //!< Published vertex of each welded vertex.
+		std::vector<uint32_t> indices;     //!< Published index array, in published vertices.
+		std::vector<uint32_t> faceIndices; //!< Index array in face order, in welded vertices.
+	};
+
+	/// Splits face-vertices into unique vertices, triangulates, buckets the
+	/// triangles by shader, optimizes their order if _mesh.optimize is set,
+	/// builds meshlets if _mesh.meshlets is set and generates tangent frames. _mesh.vertexFormat and
+	/// _mesh.vertexLayout are kept, they are part of the content hash.
+	///
+	/// With _previous from a build of the same topology, its vertex and
+	/// triangle order is kept instead of optimizing again. The overdraw sort
+	/// depends on positions, so a deformed mesh would otherwise come out
+	/// numbered differently than the copy the consumer patches with deltas.
+	/// The topology is the same when every welded vertex and triangle is,
+	/// equal counts alone don't say that.
+	///
+	void buildMesh(const MeshSnapshot& _snapshot, MeshData& _mesh, MeshSource* _source = NULL, const MeshSource* _previous = NULL);
+
+	/// Collects the mesh vertices whose position or normal differ from
+	/// _source, and takes the new positions and normals of _snapshot over
+	/// into _source. Only those are read besides the normal ids and UVs.
+	/// Returns false if the arrays don't fit the topology _source was built
+	/// from or the normal ids or UVs changed, which a delta can't carry.
+	///
+	bool buildVertexDelta(MeshSource& _source, MeshSnapshot& _snapshot, VertexDeltaData& _delta);
+
+} // namespace mb
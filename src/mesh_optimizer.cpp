@@ -0,0 +1,299 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace mb
+{
+	/// Triangles using each vertex, as ranges of one array.
+	///
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+	};
+
+	static void buildAdjacency(Adjacency& _adjacency, const uint32_t* _indices, size_t _numIndices, uint32_t _numVertices)
+	{
+		_adjacency.offsets.assign(_numVertices + 1, 0);
+		for (size_t ii = 0; ii < _numIndices; ++ii)
+		{
+			_adjacency.offsets[_indices[ii] + 1] += 1;
+		}
+		for (uint32_t ii = 0; ii < _numVertices; ++ii)
+		{
+			_adjacency.offsets[ii + 1] += _adjacency.offsets[ii];
+		}
+
+		_adjacency.triangles.resize(_numIndices);
+		std::vector<uint32_t> cursors(_adjacency.offsets.begin(), _adjacency.offsets.end() - 1);
+		for (size_t ii = 0; ii < _numIndices; ++ii)
+		{
+			_adjacency.triangles[cursors[_indices[ii]]++] = uint32_t(ii / 3);
+		}
+	}
+
+	/// Sorts the clusters starting at _clusters so the ones whose surface
+	/// faces away from the mesh center draw first and occlude the rest.
+	///
+	static void sortClusters(uint32_t* _indices, size_t _numIndices, const std::vector<uint32_t>& _clusters, const float* _positions, size_t _positionStride)
+	{
+		const uint8_t* base = reinterpret_cast<const uint8_t*>(_positions);
+		auto position = [&](uint32_t _vertex) { return reinterpret_cast<const float*>(base + _vertex * _positionStride); };
+
+		struct Cluster
+		{
+			uint32_t first;
+			uint32_t count;
+			float centroid[3]; //!< Area weighted.
+			float normal[3];   //!< Sum of the unnormalized triangle normals.
+			float area;
+			float sortKey;
+		};
+
+		size_t numTriangles = _numIndices / 3;
+		std::vector<Cluster> clusters(_clusters.size());
+
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		float totalArea = 0.0f;
+
+		// Clusters are consecutive, so one pass over the triangles fills them all
+		for (size_t ii = 0; ii < _clusters.size(); ++ii)
+		{
+			Cluster& cluster = clusters[ii];
+			memset(&cluster, 0, sizeof(Cluster));
+			cluster.first = _clusters[ii];
+			cluster.count = uint32_t((ii + 1 < _clusters.size() ? _clusters[ii + 1] : numTriangles) - cluster.first);
+
+			for (uint32_t tt = cluster.first; tt < cluster.first + cluster.count; ++tt)
+			{
+				const float* p0 = position(_indices[tt * 3 + 0]);
+				const float* p1 = position(_indices[tt * 3 + 1]);
+				const float* p2 = position(_indices[tt * 3 + 2]);
+
+				float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				float normal[3] =
+				{
+					e1[1] * e2[2] - e1[2] * e2[1],
+					e1[2] * e2[0] - e1[0] * e2[2],
+					e1[0] * e2[1] - e1[1] * e2[0],
+				};
+				float area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+				for (int kk = 0; kk < 3; ++kk)
+				{
+					cluster.centroid[kk] += (p0[kk] + p1[kk] + p2[kk]) * (area / 3.0f);
+					cluster.normal[kk] += normal[kk];
+				}
+				cluster.area += area;
+			}
+
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				center[kk] += cluster.centroid[kk];
+			}
+			totalArea += cluster.area;
+		}
+
+		for (Cluster& cluster : clusters)
+		{
+			float length = sqrtf(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+			if (cluster.area > 0.0f && length > 0.0f)
+			{
+				for (int kk = 0; kk < 3; ++kk)
+				{
+					cluster.sortKey += (cluster.centroid[kk] / cluster.area - center[kk] / totalArea) * cluster.normal[kk] / length;
+				}
+			}
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& _a, const Cluster& _b)
+		{
+			return _a.sortKey > _b.sortKey;
+		});
+
+		std::vector<uint32_t> sorted;
+		sorted.reserve(_numIndices);
+		for (const Cluster& cluster : clusters)
+		{
+			sorted.insert(sorted.end(), _indices + cluster.first * 3, _indices + (cluster.first + cluster.count) * 3);
+		}
+		memcpy(_indices, sorted.data(), sizeof(uint32_t) * _numIndices);
+	}
+
+	void optimizeVertexCache(uint32_t* _indices, size_t _numIndices, uint32_t _numVertices, uint32_t _cacheSize, const float* _positions, size_t _positionStride)
+	{
+		size_t numTriangles = _numIndices / 3;
+		if (numTriangles == 0)
+		{
+			return;
+		}
+
+		Adjacency adjacency;
+		buildAdjacency(adjacency, _indices, numTriangles * 3, _numVertices);
+
+		std::vector<uint32_t> live(_numVertices);
+		for (uint32_t ii = 0; ii < _numVertices; ++ii)
+		{
+			live[ii] = adjacency.offsets[ii + 1] - adjacency.offsets[ii];
+		}
+
+		std::vector<uint32_t> cacheTime(_numVertices, 0);
+		std::vector<uint8_t> emitted(numTriangles, 0);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> clusters;
+
+		std::vector<uint32_t> output;
+		output.reserve(numTriangles * 3);
+
+		uint32_t time = _cacheSize + 1;
+		uint32_t cursor = 0;
+		uint32_t fan = _indices[0];
+		clusters.push_back(0);
+
+		while (fan != UINT32_MAX)
+		{
+			// Emit every triangle around the fanning vertex
+			candidates.clear();
+			for (uint32_t ii = adjacency.offsets[fan]; ii < adjacency.offsets[fan + 1]; ++ii)
+			{
+				uint32_t triangle = adjacency.triangles[ii];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+
+				for (int kk = 0; kk < 3; ++kk)
+				{
+					uint32_t vertex = _indices[triangle * 3 + kk];
+					output.push_back(vertex);
+					deadEnd.push_back(vertex);
+					candidates.push_back(vertex);
+					live[vertex] -= 1;
+
+					if (time - cacheTime[vertex] > _cacheSize)
+					{
+						cacheTime[vertex] = time;
+						time += 1;
+					}
+				}
+				emitted[triangle] = 1;
+			}
+
+			// Next fan around the candidate that is still in the cache and has
+			// the fewest triangles left, so it stays there while they are emitted
+			uint32_t next = UINT32_MAX;
+			uint32_t bestPriority = 0;
+			for (uint32_t vertex : candidates)
+			{
+				if (live[vertex] == 0)
+				{
+					continue;
+				}
+
+				uint32_t priority = 0;
+				if (time - cacheTime[vertex] + 2 * live[vertex] <= _cacheSize)
+				{
+					priority = time - cacheTime[vertex];
+				}
+				if (next == UINT32_MAX || priority > bestPriority)
+				{
+					next = vertex;
+					bestPriority = priority;
+				}
+			}
+
+			if (next == UINT32_MAX)
+			{
+				// Dead end, back up to a recent vertex or jump to the next live one
+				while (!deadEnd.empty() && next == UINT32_MAX)
+				{
+					uint32_t vertex = deadEnd.back();
+					deadEnd.pop_back();
+					next = live[vertex] != 0 ? vertex : UINT32_MAX;
+				}
+				while (cursor < _numVertices && next == UINT32_MAX)
+				{
+					next = live[cursor] != 0 ? cursor : UINT32_MAX;
+					cursor += 1;
+				}
+
+				// The cache is cold here, so the order of what follows doesn't
+				// matter for it and it can be moved around for overdraw.
+				if (next != UINT32_MAX && output.size() / 3 != clusters.back())
+				{
+					clusters.push_back(uint32_t(output.size() / 3));
+				}
+			}
+
+			fan = next;
+		}
+
+		memcpy(_indices, output.data(), sizeof(uint32_t) * output.size());
+
+		if (_positions != NULL && clusters.size() > 1)
+		{
+			sortClusters(_indices, output.size(), clusters, _positions, _positionStride);
+		}
+	}
+
+	void optimizeVertexFetch(uint32_t* _indices, size_t _numIndices, uint32_t _numVertices, std::vector<uint32_t>& _remap)
+	{
+		_remap.assign(_numVertices, UINT32_MAX);
+
+		uint32_t next = 0;
+		for (size_t ii = 0; ii < _numIndices; ++ii)
+		{
+			uint32_t& remapped = _remap[_indices[ii]];
+			if (remapped == UINT32_MAX)
+			{
+				remapped = next++;
+			}
+			_indices[ii] = remapped;
+		}
+
+		for (uint32_t& remapped : _remap)
+		{
+			if (remapped == UINT32_MAX)
+			{
+				remapped = next++;
+			}
+		}
+	}
+
+	float getAcmr(const uint32_t* _indices, size_t _numIndices, uint32_t _numVertices, uint32_t _cacheSize)
+	{
+		size_t numTriangles = _numIndices / 3;
+		if (numTriangles == 0)
+		{
+			return 0.0f;
+		}
+
+		// A vertex is cached if fewer than _cacheSize misses happened since it was loaded
+		std::vector<uint32_t> cacheTime(_numVertices, 0);
+		uint32_t time = _cacheSize + 1;
+		uint32_t misses = 0;
+
+		for (size_t ii = 0; ii < numTriangles * 3; ++ii)
+		{
+			uint32_t vertex = _indices[ii];
+			if (time - cacheTime[vertex] > _cacheSize)
+			{
+				cacheTime[vertex] = time;
+				time += 1;
+				misses += 1;
+			}
+		}
+
+		return float(misses) / float(numTriangles);
+	}
+
+} // namespace mb
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include <stddef.h> // size_t
+#include <stdint.h> // uint32_t
+
+#include <vector>
+
+/// Post-transform cache size the triangle order is tuned for. Small enough
+/// to be a win on every GPU, larger caches only benefit more.
+#ifndef MAYABRIDGE_CONFIG_VERTEX_CACHE_SIZE
+#define MAYABRIDGE_CONFIG_VERTEX_CACHE_SIZE 16
+#endif // MAYABRIDGE_CONFIG_VERTEX_CACHE_SIZE
+
+namespace mb
+{
+	/// Reorders the triangles of one index range for post-transform cache
+	/// reuse (Tipsify, Sander et al. 2007). With _positions, the clusters
+	/// Tipsify produces are then sorted so the ones facing away from the
+	/// mesh center come first, which reduces overdraw.
+	///
+	void optimizeVertexCache(uint32_t* _indices, size_t _numIndices, uint32_t _numVertices, uint32_t _cacheSize = MAYABRIDGE_CONFIG_VERTEX_CACHE_SIZE, const float* _positions = NULL, size_t _positionStride = 0);
+
+	/// Numbers vertices in the order the indices first use them, so vertex
+	/// fetch walks memory forward. Rewrites _indices and fills _remap with
+	/// the new index of every old vertex, unreferenced vertices go last.
+	///
+	void optimizeVertexFetch(uint32_t* _indices, size_t _numIndices, uint32_t _numVertices, std::vector<uint32_t>& _remap);
+
+	/// Average cache misses per triangle of a FIFO cache, 0.5 is the best a
+	/// regular grid can do and 3 is no reuse at all.
+	///
+	float getAcmr(const uint32_t* _indices, size_t _numIndices, uint32_t _numVertices, uint32_t _cacheSize = MAYABRIDGE_CONFIG_VERTEX_CACHE_SIZE);
+
+} // namespace mb
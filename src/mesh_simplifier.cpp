@@ -0,0 +1,528 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "mesh_simplifier.h"
+#include "bounds.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <unordered_map>
+
+namespace mb
+{
+	/// Sum of squared distances to planes, weighted by the area of the
+	/// triangles they come from.
+	///
+	struct Quadric
+	{
+		double a2, ab, ac, ad;
+		double b2, bc, bd;
+		double c2, cd;
+		double d2;
+		double area;
+	};
+
+	static void addPlane(Quadric& _quadric, const float* _p0, const float* _p1, const float* _p2)
+	{
+		double e1[3] = { double(_p1[0]) - _p0[0], double(_p1[1]) - _p0[1], double(_p1[2]) - _p0[2] };
+		double e2[3] = { double(_p2[0]) - _p0[0], double(_p2[1]) - _p0[1], double(_p2[2]) - _p0[2] };
+		double n[3] =
+		{
+			e1[1] * e2[2] - e1[2] * e2[1],
+			e1[2] * e2[0] - e1[0] * e2[2],
+			e1[0] * e2[1] - e1[1] * e2[0],
+		};
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0)
+		{
+			return;
+		}
+
+		double a = n[0] / length;
+		double b = n[1] / length;
+		double c = n[2] / length;
+		double d = -(a * _p0[0] + b * _p0[1] + c * _p0[2]);
+		double w = length * 0.5;
+
+		_quadric.a2 += w * a * a; _quadric.ab += w * a * b; _quadric.ac += w * a * c; _quadric.ad += w * a * d;
+		_quadric.b2 += w * b * b; _quadric.bc += w * b * c; _quadric.bd += w * b * d;
+		_quadric.c2 += w * c * c; _quadric.cd += w * c * d;
+		_quadric.d2 += w * d * d;
+		_quadric.area += w;
+	}
+
+	static void addQuadric(Quadric& _quadric, const Quadric& _other)
+	{
+		_quadric.a2 += _other.a2; _quadric.ab += _other.ab; _quadric.ac += _other.ac; _quadric.ad += _other.ad;
+		_quadric.b2 += _other.b2; _quadric.bc += _other.bc; _quadric.bd += _other.bd;
+		_quadric.c2 += _other.c2; _quadric.cd += _other.cd;
+		_quadric.d2 += _other.d2;
+		_quadric.area += _other.area;
+	}
+
+	/// Mean squared distance of _p to the planes of both quadrics.
+	///
+	static float evaluate(const Quadric& _q0, const Quadric& _q1, const float* _p)
+	{
+		double x = _p[0];
+		double y = _p[1];
+		double z = _p[2];
+		double area = _q0.area + _q1.area;
+
+		double error = 0.0;
+		for (const Quadric* q : { &_q0, &_q1 })
+		{
+			error += q->a2 * x * x + 2.0 * q->ab * x * y + 2.0 * q->ac * x * z + 2.0 * q->ad * x
+				+ q->b2 * y * y + 2.0 * q->bc * y * z + 2.0 * q->bd * y
+				+ q->c2 * z * z + 2.0 * q->cd * z
+				+ q->d2;
+		}
+
+		return area > 0.0 && error > 0.0 ? float(error / area) : 0.0f;
+	}
+
+	static void triangleNormal(const float* _p0, const float* _p1, const float* _p2, float* _normal)
+	{
+		float e1[3] = { _p1[0] - _p0[0], _p1[1] - _p0[1], _p1[2] - _p0[2] };
+		float e2[3] = { _p2[0] - _p0[0], _p2[1] - _p0[1], _p2[2] - _p0[2] };
+		_normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		_normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		_normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	static uint32_t hashPosition(const float* _position)
+	{
+		uint32_t bits[3];
+		memcpy(bits, _position, sizeof(bits));
+		uint32_t hash = bits[0] * 0x9e3779b1u;
+		hash ^= bits[1] * 0x85ebca77u;
+		hash ^= bits[2] * 0xc2b2ae3du;
+		return hash ^ (hash >> 15);
+	}
+
+	struct Collapse
+	{
+		float cost;
+		uint32_t from;
+		uint32_t to;
+	};
+
+	void buildLodChain(const Vertex* _vertices, uint32_t _numVertices, const uint32_t* _indices, size_t _numIndices, uint32_t _numLevels, std::vector<LodLevel>& _levels)
+	{
+		// Give up on a level that removes less than this
+		const float minReduction = 0.75f;
+		const uint32_t maxPasses = 64;
+
+		size_t numTriangles = _numIndices / 3;
+		if (numTriangles == 0 || _numLevels == 0)
+		{
+			return;
+		}
+
+		// Vertices split at seams share a position, collapses move positions
+		std::vector<uint32_t> positionOf(_numVertices, UINT32_MAX);
+		std::vector<uint32_t> firstVertex;
+		std::vector<uint8_t> locked;
+
+		uint32_t tableSize = 1;
+		while (tableSize < _numIndices)
+		{
+			tableSize <<= 1;
+		}
+		std::vector<uint32_t> table(tableSize, UINT32_MAX);
+
+		for (size_t ii = 0; ii < numTriangles * 3; ++ii)
+		{
+			uint32_t vertex = _indices[ii];
+			if (positionOf[vertex] != UINT32_MAX)
+			{
+				continue;
+			}
+
+			const float* position = _vertices[vertex].position;
+			uint32_t slot = hashPosition(position) & (tableSize - 1);
+			for (;;)
+			{
+				uint32_t canonical = table[slot];
+				if (canonical == UINT32_MAX)
+				{
+					canonical = uint32_t(firstVertex.size());
+					table[slot] = canonical;
+					firstVertex.push_back(vertex);
+					locked.push_back(0);
+					positionOf[vertex] = canonical;
+					break;
+				}
+
+				if (memcmp(_vertices[firstVertex[canonical]].position, position, sizeof(float) * 3) == 0)
+				{
+					// More than one vertex here, a seam
+					positionOf[vertex] = canonical;
+					locked[canonical] = 1;
+					break;
+				}
+
+				slot = (slot + 1) & (tableSize - 1);
+			}
+		}
+
+		uint32_t numPositions = uint32_t(firstVertex.size());
+		auto position = [&](uint32_t _canonical) { return _vertices[firstVertex[_canonical]].position; };
+
+		// Every corner keeps its position and the vertex it draws with
+		std::vector<uint32_t> corners;
+		std::vector<uint32_t> cornerVertices;
+		corners.reserve(numTriangles * 3);
+		cornerVertices.reserve(numTriangles * 3);
+		for (size_t ii = 0; ii < numTriangles * 3; ii += 3)
+		{
+			uint32_t p0 = positionOf[_indices[ii + 0]];
+			uint32_t p1 = positionOf[_indices[ii + 1]];
+			uint32_t p2 = positionOf[_indices[ii + 2]];
+			if (p0 == p1 || p1 == p2 || p2 == p0)
+			{
+				continue;
+			}
+
+			corners.insert(corners.end(), { p0, p1, p2 });
+			cornerVertices.insert(cornerVertices.end(), { _indices[ii + 0], _indices[ii + 1], _indices[ii + 2] });
+		}
+
+		// Edges with one triangle are borders, more than two aren't manifold
+		std::vector<uint64_t> edges;
+		edges.reserve(corners.size());
+		for (size_t ii = 0; ii < corners.size(); ii += 3)
+		{
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				uint32_t a = corners[ii + kk];
+				uint32_t b = corners[ii + (kk + 1) % 3];
+				edges.push_back(a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t ii = 0; ii < edges.size();)
+		{
+			size_t end = ii + 1;
+			while (end < edges.size() && edges[end] == edges[ii])
+			{
+				++end;
+			}
+			if (end - ii != 2)
+			{
+				locked[uint32_t(edges[ii] >> 32)] = 1;
+				locked[uint32_t(edges[ii])] = 1;
+			}
+			ii = end;
+		}
+
+		std::vector<Quadric> quadrics(numPositions);
+		memset(quadrics.data(), 0, sizeof(Quadric) * numPositions);
+		for (size_t ii = 0; ii < corners.size(); ii += 3)
+		{
+			const float* p0 = position(corners[ii + 0]);
+			const float* p1 = position(corners[ii + 1]);
+			const float* p2 = position(corners[ii + 2]);
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				addPlane(quadrics[corners[ii + kk]], p0, p1, p2);
+			}
+		}
+
+		std::vector<uint32_t> remap(numPositions);
+		std::vector<uint32_t> remapVertex(numPositions);
+		std::vector<uint8_t> touched(numPositions);
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> adjacency;
+		std::vector<Collapse> collapses;
+
+		size_t levelTriangles = corners.size() / 3;
+		size_t target = levelTriangles / 4;
+		float maxError = 0.0f;
+
+		for (uint32_t pass = 0; pass < maxPasses && _levels.size() < _numLevels; ++pass)
+		{
+			size_t liveTriangles = corners.size() / 3;
+
+			// Triangles around every position
+			offsets.assign(numPositions + 1, 0);
+			for (uint32_t corner : corners)
+			{
+				offsets[corner + 1] += 1;
+			}
+			for (uint32_t ii = 0; ii < numPositions; ++ii)
+			{
+				offsets[ii + 1] += offsets[ii];
+			}
+			adjacency.resize(corners.size());
+			{
+				std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+				for (size_t ii = 0; ii < corners.size(); ++ii)
+				{
+					adjacency[cursors[corners[ii]]++] = uint32_t(ii / 3);
+				}
+			}
+
+			// Cheaper direction of every edge, interior edges show up once as a < b
+			collapses.clear();
+			for (size_t ii = 0; ii < corners.size(); ii += 3)
+			{
+				for (int kk = 0; kk < 3; ++kk)
+				{
+					uint32_t a = corners[ii + kk];
+					uint32_t b = corners[ii + (kk + 1) % 3];
+					if (a > b || (locked[a] && locked[b]))
+					{
+						continue;
+					}
+
+					float costA = locked[a] ? INFINITY : evaluate(quadrics[a], quadrics[b], position(b));
+					float costB = locked[b] ? INFINITY : evaluate(quadrics[a], quadrics[b], position(a));
+					collapses.push_back(costA <= costB ? Collapse{ costA, a, b } : Collapse{ costB, b, a });
+				}
+			}
+
+			if (collapses.empty())
+			{
+				break;
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& _a, const Collapse& _b)
+			{
+				return _a.cost < _b.cost || (_a.cost == _b.cost && (_a.from < _b.from || (_a.from == _b.from && _a.to < _b.to)));
+			});
+
+			// Each collapse takes about two triangles, past what the target
+			// needs only take ones not much worse than the last one needed.
+			size_t needed = std::min(collapses.size() - 1, (liveTriangles - std::min(liveTriangles, target)) / 2);
+			float passLimit = collapses[needed].cost * 1.5f;
+
+			for (uint32_t ii = 0; ii < numPositions; ++ii)
+			{
+				remap[ii] = ii;
+			}
+			memset(touched.data(), 0, touched.size());
+
+			uint32_t numCollapsed = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.cost > passLimit || liveTriangles <= target)
+				{
+					break;
+				}
+				if (touched[collapse.from] || touched[collapse.to])
+				{
+					continue;
+				}
+
+				// Reject collapses that flip a triangle, and find the vertex
+				// of the target on this side of any seam through it.
+				const float* to = position(collapse.to);
+				uint32_t toVertex = UINT32_MAX;
+				uint32_t removed = 0;
+				bool flips = false;
+				for (uint32_t jj = offsets[collapse.from]; jj < offsets[collapse.from + 1] && !flips; ++jj)
+				{
+					uint32_t triangle = adjacency[jj];
+					uint32_t c[3];
+					for (int kk = 0; kk < 3; ++kk)
+					{
+						c[kk] = remap[corners[triangle * 3 + kk]];
+					}
+					if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0])
+					{
+						continue;
+					}
+
+					int slot = c[0] == collapse.to ? 0 : c[1] == collapse.to ? 1 : c[2] == collapse.to ? 2 : -1;
+					if (slot >= 0)
+					{
+						// Nothing collapsed into an untouched target yet
+						toVertex = cornerVertices[triangle * 3 + slot];
+						removed += 1;
+						continue;
+					}
+
+					const float* p[3] = { position(c[0]), position(c[1]), position(c[2]) };
+					float before[3];
+					triangleNormal(p[0], p[1], p[2], before);
+					for (int kk = 0; kk < 3; ++kk)
+					{
+						p[kk] = c[kk] == collapse.from ? to : p[kk];
+					}
+					float after[3];
+					triangleNormal(p[0], p[1], p[2], after);
+
+					float d = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+					float lengths = sqrtf((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) * (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+					flips = d <= 0.01f * lengths;
+				}
+
+				if (flips || toVertex == UINT32_MAX)
+				{
+					continue;
+				}
+
+				remap[collapse.from] = collapse.to;
+				remapVertex[collapse.from] = toVertex;
+				addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+				touched[collapse.from] = 1;
+				touched[collapse.to] = 1;
+
+				liveTriangles -= std::min<size_t>(liveTriangles, removed);
+				maxError = std::max(maxError, collapse.cost);
+				numCollapsed += 1;
+			}
+
+			if (numCollapsed != 0)
+			{
+				size_t write = 0;
+				for (size_t ii = 0; ii < corners.size(); ii += 3)
+				{
+					for (int kk = 0; kk < 3; ++kk)
+					{
+						uint32_t corner = corners[ii + kk];
+						if (remap[corner] != corner)
+						{
+							corners[ii + kk] = remap[corner];
+							cornerVertices[ii + kk] = remapVertex[corner];
+						}
+					}
+
+					if (corners[ii + 0] == corners[ii + 1] || corners[ii + 1] == corners[ii + 2] || corners[ii + 2] == corners[ii + 0])
+					{
+						continue;
+					}
+
+					for (int kk = 0; kk < 3; ++kk)
+					{
+						corners[write + kk] = corners[ii + kk];
+						cornerVertices[write + kk] = cornerVertices[ii + kk];
+					}
+					write += 3;
+				}
+				corners.resize(write);
+				cornerVertices.resize(write);
+			}
+
+			// Take the level once it is reached, or the best there is once
+			// nothing more collapses
+			size_t current = corners.size() / 3;
+			bool stuck = numCollapsed == 0;
+			if (current <= target || (stuck && float(current) < float(levelTriangles) * minReduction))
+			{
+				LodLevel level;
+				level.indices = cornerVertices;
+				level.error = sqrtf(maxError);
+				_levels.push_back(std::move(level));
+
+				levelTriangles = current;
+				target = current / 4;
+			}
+			if (stuck || current == 0)
+			{
+				break;
+			}
+		}
+	}
+
+	void buildLods(MeshData& _mesh, uint32_t _numLevels)
+	{
+		_mesh.lodIndices.clear();
+
+		std::vector<LodLevel> levels;
+		for (SubMeshData& subMesh : _mesh.subMeshes)
+		{
+			levels.clear();
+			buildLodChain(_mesh.vertices.data(), uint32_t(_mesh.vertices.size()), &_mesh.indices[subMesh.firstIndex], subMesh.numIndices, _numLevels, levels);
+
+			subMesh.lods.clear();
+			for (const LodLevel& level : levels)
+			{
+				LodData lod;
+				lod.firstIndex = uint32_t(_mesh.lodIndices.size());
+				lod.numIndices = uint32_t(level.indices.size());
+				lod.error = level.error;
+				subMesh.lods.push_back(lod);
+
+				_mesh.lodIndices.insert(_mesh.lodIndices.end(), level.indices.begin(), level.indices.end());
+			}
+		}
+	}
+
+	void buildProxyMesh(const MeshData& _mesh, uint32_t _gridSize, MeshData& _proxy)
+	{
+		_proxy = MeshData();
+		_proxy.vertexFormat = _mesh.vertexFormat;
+		_proxy.vertexLayout = _mesh.vertexLayout;
+
+		float min[3] = { INFINITY, INFINITY, INFINITY };
+		float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (const Vertex& vertex : _mesh.vertices)
+		{
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				min[kk] = std::min(min[kk], vertex.position[kk]);
+				max[kk] = std::max(max[kk], vertex.position[kk]);
+			}
+		}
+
+		float extent = std::max(max[0] - min[0], std::max(max[1] - min[1], max[2] - min[2]));
+		float scale = extent > 0.0f ? float(_gridSize) / extent : 0.0f;
+
+		// First vertex in a cell stands in for all of them
+		std::unordered_map<uint64_t, uint32_t> cells;
+		cells.reserve(_mesh.vertices.size() / 4);
+		std::vector<uint32_t> remap(_mesh.vertices.size());
+		for (size_t ii = 0; ii < _mesh.vertices.size(); ++ii)
+		{
+			const float* position = _mesh.vertices[ii].position;
+			uint64_t cell = 0;
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				uint64_t coord = std::min(uint64_t((position[kk] - min[kk]) * scale), uint64_t(_gridSize - 1));
+				cell = cell * _gridSize + coord;
+			}
+
+			auto it = cells.emplace(cell, uint32_t(_proxy.vertices.size()));
+			if (it.second)
+			{
+				_proxy.vertices.push_back(_mesh.vertices[ii]);
+			}
+			remap[ii] = it.first->second;
+		}
+
+		_proxy.hash = hashBytes(&_mesh.hash, sizeof(_mesh.hash), _gridSize);
+		computeBounds(_proxy.vertices.data(), uint32_t(_proxy.vertices.size()), _proxy.bounds);
+		for (const SubMeshData& subMesh : _mesh.subMeshes)
+		{
+			SubMeshData proxy;
+			proxy.firstIndex = uint32_t(_proxy.indices.size());
+			proxy.material = subMesh.material;
+
+			for (uint32_t ii = subMesh.firstIndex; ii + 2 < subMesh.firstIndex + subMesh.numIndices; ii += 3)
+			{
+				uint32_t i0 = remap[_mesh.indices[ii + 0]];
+				uint32_t i1 = remap[_mesh.indices[ii + 1]];
+				uint32_t i2 = remap[_mesh.indices[ii + 2]];
+				if (i0 != i1 && i1 != i2 && i2 != i0)
+				{
+					_proxy.indices.insert(_proxy.indices.end(), { i0, i1, i2 });
+				}
+			}
+
+			proxy.numIndices = uint32_t(_proxy.indices.size()) - proxy.firstIndex;
+			if (proxy.numIndices != 0)
+			{
+				proxy.hash = hashBytes(&_proxy.indices[proxy.firstIndex], sizeof(uint32_t) * proxy.numIndices, _proxy.hash);
+				computeBounds(_proxy.vertices.data(), &_proxy.indices[proxy.firstIndex], proxy.numIndices, proxy.bounds);
+				_proxy.subMeshes.push_back(std::move(proxy));
+			}
+		}
+	}
+
+} // namespace mb
@@ -0,0 +1,41 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include "scene_writer.h"
+
+#include <vector>
+
+namespace mb
+{
+	/// One simplified index buffer of a LOD chain.
+	///
+	struct LodLevel
+	{
+		std::vector<uint32_t> indices;
+		float error; //!< Root mean square distance of collapsed vertices from the surface around them, in mesh units.
+	};
+
+	/// Quadric error edge collapse (Garland and Heckbert) of one index range.
+	/// Vertices collapse onto one of their neighbours, so every level indexes
+	/// the vertices of the original mesh. Vertices on borders and attribute
+	/// seams stay put. Appends up to _numLevels levels with a quarter of the
+	/// triangles of the one before, and stops early once the mesh doesn't
+	/// get much simpler.
+	///
+	void buildLodChain(const Vertex* _vertices, uint32_t _numVertices, const uint32_t* _indices, size_t _numIndices, uint32_t _numLevels, std::vector<LodLevel>& _levels);
+
+	/// Fills _mesh.subMeshes LODs and _mesh.lodIndices for every submesh.
+	///
+	void buildLods(MeshData& _mesh, uint32_t _numLevels);
+
+	/// Cheap stand-in for a mesh whose LODs are still being built, made by
+	/// merging vertices on a _gridSize^3 grid over the bounds. Much coarser
+	/// than a quadric LOD but fast enough to send right away.
+	///
+	void buildProxyMesh(const MeshData& _mesh, uint32_t _gridSize, MeshData& _proxy);
+
+} // namespace mb
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "meshlet_builder.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace mb
+{
+	static float dot(const float* _a, const float* _b)
+	{
+		return _a[0] * _b[0] + _a[1] * _b[1] + _a[2] * _b[2];
+	}
+
+	/// Sphere around the bounding box, and the cone of the triangle normals
+	/// with the apex placed so every triangle plane lies in front of it.
+	///
+	static void computeBounds(Meshlet& _meshlet, const Vertex* _vertices, const uint32_t* _meshletVertices, const uint8_t* _meshletTriangles)
+	{
+		float min[3] = { INFINITY, INFINITY, INFINITY };
+		float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (uint32_t ii = 0; ii < _meshlet.numVertices; ++ii)
+		{
+			const float* position = _vertices[_meshletVertices[ii]].position;
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				min[kk] = position[kk] < min[kk] ? position[kk] : min[kk];
+				max[kk] = position[kk] > max[kk] ? position[kk] : max[kk];
+			}
+		}
+
+		float radiusSq = 0.0f;
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			_meshlet.center[kk] = (min[kk] + max[kk]) * 0.5f;
+		}
+		for (uint32_t ii = 0; ii < _meshlet.numVertices; ++ii)
+		{
+			const float* position = _vertices[_meshletVertices[ii]].position;
+			float d[3] = { position[0] - _meshlet.center[0], position[1] - _meshlet.center[1], position[2] - _meshlet.center[2] };
+			float distanceSq = dot(d, d);
+			radiusSq = distanceSq > radiusSq ? distanceSq : radiusSq;
+		}
+		_meshlet.radius = sqrtf(radiusSq);
+
+		// Unit normal of every triangle, degenerate ones don't constrain the cone
+		float normals[MAYABRIDGE_MESHLET_MAX_TRIANGLES][3];
+		bool valid[MAYABRIDGE_MESHLET_MAX_TRIANGLES];
+		float axis[3] = { 0.0f, 0.0f, 0.0f };
+
+		for (uint32_t ii = 0; ii < _meshlet.numTriangles; ++ii)
+		{
+			const float* p0 = _vertices[_meshletVertices[_meshletTriangles[ii * 3 + 0]]].position;
+			const float* p1 = _vertices[_meshletVertices[_meshletTriangles[ii * 3 + 1]]].position;
+			const float* p2 = _vertices[_meshletVertices[_meshletTriangles[ii * 3 + 2]]].position;
+
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float* n = normals[ii];
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+			float length = sqrtf(dot(n, n));
+			valid[ii] = length > 1e-12f;
+			if (valid[ii])
+			{
+				for (int kk = 0; kk < 3; ++kk)
+				{
+					n[kk] /= length;
+					axis[kk] += n[kk];
+				}
+			}
+		}
+
+		memcpy(_meshlet.coneApex, _meshlet.center, sizeof(_meshlet.coneApex));
+		memset(_meshlet.coneAxis, 0, sizeof(_meshlet.coneAxis));
+		_meshlet.coneCutoff = 1.0f;
+
+		float length = sqrtf(dot(axis, axis));
+		if (length < 1e-12f)
+		{
+			return;
+		}
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			axis[kk] /= length;
+		}
+
+		float minDot = 1.0f;
+		for (uint32_t ii = 0; ii < _meshlet.numTriangles; ++ii)
+		{
+			if (valid[ii])
+			{
+				float d = dot(normals[ii], axis);
+				minDot = d < minDot ? d : minDot;
+			}
+		}
+
+		// Normals spread over more than a hemisphere, nothing can be culled
+		if (minDot <= 0.0f)
+		{
+			return;
+		}
+
+		// Move the apex back along the axis until it is behind every triangle plane
+		float maxT = 0.0f;
+		for (uint32_t ii = 0; ii < _meshlet.numTriangles; ++ii)
+		{
+			if (valid[ii])
+			{
+				const float* p0 = _vertices[_meshletVertices[_meshletTriangles[ii * 3 + 0]]].position;
+				float c[3] = { _meshlet.center[0] - p0[0], _meshlet.center[1] - p0[1], _meshlet.center[2] - p0[2] };
+				float t = dot(c, normals[ii]) / dot(axis, normals[ii]);
+				maxT = t > maxT ? t : maxT;
+			}
+		}
+
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			_meshlet.coneApex[kk] = _meshlet.center[kk] - axis[kk] * maxT;
+			_meshlet.coneAxis[kk] = axis[kk];
+		}
+		_meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+	}
+
+	void buildMeshlets(const Vertex* _vertices, uint32_t _numVertices, const uint32_t* _indices, size_t _numIndices, std::vector<Meshlet>& _meshlets, std::vector<uint32_t>& _meshletVertices, std::vector<uint8_t>& _meshletTriangles)
+	{
+		// Slot of each mesh vertex in the meshlet being built
+		std::vector<uint8_t> slots(_numVertices, 0xff);
+
+		Meshlet meshlet;
+		memset(&meshlet, 0, sizeof(Meshlet));
+		meshlet.vertexOffset = uint32_t(_meshletVertices.size());
+		meshlet.triangleOffset = uint32_t(_meshletTriangles.size());
+
+		auto finish = [&]()
+		{
+			for (uint32_t ii = 0; ii < meshlet.numVertices; ++ii)
+			{
+				slots[_meshletVertices[meshlet.vertexOffset + ii]] = 0xff;
+			}
+
+			// Keep every meshlet's triangles 4 byte aligned
+			while (_meshletTriangles.size() & 3)
+			{
+				_meshletTriangles.push_back(0);
+			}
+
+			computeBounds(meshlet, _vertices, &_meshletVertices[meshlet.vertexOffset], &_meshletTriangles[meshlet.triangleOffset]);
+			_meshlets.push_back(meshlet);
+
+			memset(&meshlet, 0, sizeof(Meshlet));
+			meshlet.vertexOffset = uint32_t(_meshletVertices.size());
+			meshlet.triangleOffset = uint32_t(_meshletTriangles.size());
+		};
+
+		for (size_t ii = 0; ii + 2 < _numIndices; ii += 3)
+		{
+			const uint32_t* triangle = &_indices[ii];
+
+			uint32_t newVertices = 0;
+			newVertices += slots[triangle[0]] == 0xff ? 1 : 0;
+			newVertices += slots[triangle[1]] == 0xff && triangle[1] != triangle[0] ? 1 : 0;
+			newVertices += slots[triangle[2]] == 0xff && triangle[2] != triangle[0] && triangle[2] != triangle[1] ? 1 : 0;
+
+			if (meshlet.numVertices + newVertices > MAYABRIDGE_MESHLET_MAX_VERTICES || meshlet.numTriangles == MAYABRIDGE_MESHLET_MAX_TRIANGLES)
+			{
+				finish();
+			}
+
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				uint8_t& slot = slots[triangle[kk]];
+				if (slot == 0xff)
+				{
+					slot = uint8_t(meshlet.numVertices++);
+					_meshletVertices.push_back(triangle[kk]);
+				}
+				_meshletTriangles.push_back(slot);
+			}
+			meshlet.numTriangles += 1;
+		}
+
+		if (meshlet.numTriangles != 0)
+		{
+			finish();
+		}
+	}
+
+} // namespace mb
@@ -0,0 +1,22 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include "maya-bridge/shared_data.h"
+
+#include <vector>
+
+namespace mb
+{
+	/// Splits one index range into meshlets in triangle order, starting a new
+	/// one when the next triangle would exceed the vertex or triangle limit,
+	/// so a cache optimized order gives tightly packed meshlets. Appends to
+	/// the arrays, offsets in the meshlets are relative to their start. The
+	/// result only depends on the input, not on the thread or the machine.
+	///
+	void buildMeshlets(const Vertex* _vertices, uint32_t _numVertices, const uint32_t* _indices, size_t _numIndices, std::vector<Meshlet>& _meshlets, std::vector<uint32_t>& _meshletVertices, std::vector<uint8_t>& _meshletTriangles);
+
+} // namespace mb
@@ -0,0 +1,1301 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "scene_writer.h"
+#include "vertex_format.h"
+#include "hash.h"
+
+#include <new>
+#include <string.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+
+namespace mb
+{
+	static uint64_t alignUp(uint64_t _value, uint64_t _alignment)
+	{
+		return (_value + _alignment - 1) & ~(_alignment - 1);
+	}
+
+	uint64_t SceneWriter::alloc(uint64_t _size)
+	{
+		_size = alignUp(_size, MAYABRIDGE_SCENE_ALIGNMENT);
+
+		std::lock_guard<std::mutex> lock(m_arenaMutex);
+
+		// Reuse a freed block first so the used size stays close to the scene size.
+		for (auto it = m_freeBlocks.begin(); it != m_freeBlocks.end(); ++it)
+		{
+			if (it->second >= _size)
+			{
+				uint64_t offset = it->first;
+				uint64_t remaining = it->second - _size;
+				m_freeBlocks.erase(it);
+				if (remaining != 0)
+				{
+					m_freeBlocks[offset + _size] = remaining;
+				}
+				return offset;
+			}
+		}
+
+		if (m_top + _size > m_capacity)
+		{
+			return 0;
+		}
+		if (m_storage != NULL && !m_storage->commit(m_top + _size))
+		{
+			return 0;
+		}
+
+		uint64_t offset = m_top;
+		m_top += _size;
+		return offset;
+	}
+
+	void SceneWriter::free(uint64_t _offset, uint64_t _size)
+	{
+		_size = alignUp(_size, MAYABRIDGE_SCENE_ALIGNMENT);
+
+		std::lock_guard<std::mutex> lock(m_arenaMutex);
+		m_recorded.erase(_offset);
+
+		// Merge with the following block.
+		auto next = m_freeBlocks.find(_offset + _size);
+		if (next != m_freeBlocks.end())
+		{
+			_size += next->second;
+			m_freeBlocks.erase(next);
+		}
+
+		// Merge with the preceding block.
+		auto prev = m_freeBlocks.lower_bound(_offset);
+		if (prev != m_freeBlocks.begin())
+		{
+			--prev;
+			if (prev->first + prev->second == _offset)
+			{
+				_offset = prev->first;
+				_size += prev->second;
+				m_freeBlocks.erase(prev);
+			}
+		}
+
+		// Give the tail back to the top of the arena.
+		if (_offset + _size == m_top)
+		{
+			m_top = _offset;
+			return;
+		}
+
+		m_freeBlocks[_offset] = _size;
+	}
+
+	void SceneWriter::retire(uint64_t _offset, uint64_t _size)
+	{
+		// Everything up to the current sequence may reference it, the next
+		// publish is the first that doesn't.
+		uint64_t sequence = m_data->sequence.load(std::memory_order_relaxed) + 2;
+		m_retired.push_back({ _offset, _size, sequence });
+	}
+
+	void SceneWriter::reclaim()
+	{
+		// Pairs with the store/load in SharedData::acquire, either the reader
+		// sees the new sequence and retries or we see what it announced.
+		uint64_t readSequence = m_data->readSequence.load(std::memory_order_seq_cst);
+
+		size_t count = 0;
+		for (size_t ii = 0; ii < m_retired.size(); ++ii)
+		{
+			const Retired& retired = m_retired[ii];
+			if (readSequence == 0 || readSequence >= retired.sequence)
+			{
+				free(retired.offset, retired.size);
+				m_recordSequence = std::max(m_recordSequence, retired.sequence);
+			}
+			else
+			{
+				m_retired[count++] = retired;
+			}
+		}
+		m_retired.resize(count);
+	}
+
+	void SceneWriter::reclaimPayloads()
+	{
+		// The consumer is done with a payload once it has consumed the event.
+		uint64_t tail = m_data->events.tail.load(std::memory_order_acquire);
+
+		size_t count = 0;
+		for (size_t ii = 0; ii < m_payloads.size(); ++ii)
+		{
+			const Payload& payload = m_payloads[ii];
+			if (tail > payload.position)
+			{
+				free(payload.offset, payload.size);
+				m_recordTail = std::max(m_recordTail, payload.position + 1);
+			}
+			else
+			{
+				m_payloads[count++] = payload;
+			}
+		}
+		m_payloads.resize(count);
+	}
+
+	bool SceneWriter::pushEvent(const Event& _event)
+	{
+		EventRing& ring = m_data->events;
+
+		uint64_t head = ring.head.load(std::memory_order_relaxed);
+		uint64_t tail = ring.tail.load(std::memory_order_acquire);
+		if (head - tail == MAYABRIDGE_CONFIG_EVENT_RING_SIZE)
+		{
+			return false;
+		}
+
+		ring.events[head & (MAYABRIDGE_CONFIG_EVENT_RING_SIZE - 1)] = _event;
+		ring.head.store(head + 1, std::memory_order_release);
+
+		m_recorder.writeEvent(_event);
+		return true;
+	}
+
+	bool SceneWriter::emitEvent(const Event& _event)
+	{
+		// Never wait for the consumer. Once something has been dropped it has to
+		// rebuild from a snapshot anyway, so nothing more is sent until it has
+		// made room for the resync.
+		if (m_overflow)
+		{
+			Event resync = { MAYABRIDGE_EVENT_RESYNC, 0, m_data->sequence.load(std::memory_order_relaxed), 0 };
+			m_overflow = !pushEvent(resync);
+			m_numResyncs += m_overflow ? 0 : 1;
+		}
+
+		if (m_overflow || !pushEvent(_event))
+		{
+			m_overflow = true;
+			return false;
+		}
+		return true;
+	}
+
+	void SceneWriter::flushEvents(uint64_t _sequence)
+	{
+		for (Event& event : m_staged)
+		{
+			event.sequence = _sequence;
+			emitEvent(event);
+		}
+		m_staged.clear();
+	}
+
+	template<typename T>
+	T& SceneWriter::editRecord(RecordTable<T>& _table, uint32_t _index)
+	{
+		uint32_t chunk = _index / MAYABRIDGE_SCENE_CHUNK_RECORDS;
+		if (chunk >= _table.dirty.size())
+		{
+			_table.dirty.resize(chunk + 1, true);
+		}
+		_table.dirty[chunk] = true;
+		return _table.records[_index];
+	}
+
+	template<typename T>
+	void SceneWriter::writeRecords(RecordTable<T>& _table, uint32_t& _count, uint64_t& _offset)
+	{
+		const uint64_t chunkSize = sizeof(T) * MAYABRIDGE_SCENE_CHUNK_RECORDS;
+		uint32_t numRecords = uint32_t(_table.records.size());
+		uint32_t numChunks = (numRecords + MAYABRIDGE_SCENE_CHUNK_RECORDS - 1) / MAYABRIDGE_SCENE_CHUNK_RECORDS;
+		_table.dirty.resize(numChunks, true);
+
+		bool changed = numChunks != _table.chunks.size();
+		for (uint32_t ii = 0; ii < numChunks && !changed; ++ii)
+		{
+			changed = _table.dirty[ii];
+		}
+		if (!changed)
+		{
+			return;
+		}
+
+		// Without room for the chunk offsets the snapshot keeps the chunks it
+		// has, and they are tried again with the next publish
+		uint64_t directory = numChunks != 0 ? alloc(sizeof(uint64_t) * numChunks) : 0;
+		if (numChunks != 0 && directory == 0)
+		{
+			return;
+		}
+
+		for (uint32_t ii = numChunks; ii < _table.chunks.size(); ++ii)
+		{
+			if (_table.chunks[ii] != 0)
+			{
+				retire(_table.chunks[ii], chunkSize);
+			}
+		}
+		_table.chunks.resize(numChunks, 0);
+		_table.counts.resize(numChunks, 0);
+
+		// A chunk that doesn't fit stays dirty and the snapshot keeps the old one
+		uint32_t numPublished = numRecords;
+		for (uint32_t ii = 0; ii < numChunks; ++ii)
+		{
+			uint32_t first = ii * MAYABRIDGE_SCENE_CHUNK_RECORDS;
+			uint32_t count = numRecords - first < MAYABRIDGE_SCENE_CHUNK_RECORDS ? numRecords - first : MAYABRIDGE_SCENE_CHUNK_RECORDS;
+
+			uint64_t offset = _table.dirty[ii] ? alloc(chunkSize) : 0;
+			if (offset != 0)
+			{
+				memcpy(m_base + offset, &_table.records[first], sizeof(T) * count);
+
+				if (_table.chunks[ii] != 0)
+				{
+					retire(_table.chunks[ii], chunkSize);
+				}
+				_table.chunks[ii] = offset;
+				_table.counts[ii] = count;
+				_table.dirty[ii] = false;
+			}
+
+			// Nothing from the first chunk that is stale or short on is
+			// published. A stale one may reference retired blobs, and the
+			// tail of a short one was never written.
+			if (numPublished == numRecords && (_table.chunks[ii] == 0 || _table.dirty[ii] || _table.counts[ii] < count))
+			{
+				bool current = _table.chunks[ii] != 0 && !_table.dirty[ii];
+				numPublished = first + (current ? _table.counts[ii] : 0);
+			}
+		}
+
+		if (_table.directory != 0)
+		{
+			retire(_table.directory, sizeof(uint64_t) * _table.numDirectory);
+		}
+		if (numChunks != 0)
+		{
+			memcpy(m_base + directory, _table.chunks.data(), sizeof(uint64_t) * numChunks);
+		}
+		_table.directory = directory;
+		_table.numDirectory = numChunks;
+
+		_offset = directory;
+		_count = numPublished;
+	}
+
+	SceneWriter::SceneWriter()
+		: m_base(NULL)
+		, m_data(NULL)
+		, m_storage(NULL)
+		, m_stringPage(0)
+		, m_stringPageUsed(0)
+		, m_begin(0)
+		, m_capacity(0)
+		, m_top(0)
+		, m_recordSequence(0)
+		, m_recordTail(0)
+		, m_hierarchyStale(false)
+		, m_hierarchyStaged(false)
+		, m_overflow(false)
+		, m_transformsStale(false)
+		, m_numResyncs(0)
+		, m_cameraEvent(0)
+		, m_nextModelId(1)
+		, m_nextMeshId(1)
+	{
+	}
+
+	bool SceneWriter::init(void* _buffer, uint64_t _capacity)
+	{
+		return initArena(_buffer, _capacity, NULL);
+	}
+
+	bool SceneWriter::init(SharedBuffer& _buffer)
+	{
+		return initArena(_buffer.getBuffer(), _buffer.getSize(), &_buffer);
+	}
+
+	bool SceneWriter::initArena(void* _buffer, uint64_t _capacity, SharedBuffer* _storage)
+	{
+		m_begin = alignUp(sizeof(SharedData), MAYABRIDGE_SCENE_ALIGNMENT);
+		if (_buffer == NULL || _capacity < m_begin)
+		{
+			return false;
+		}
+
+		// The header has to be usable before anything else is
+		if (_storage != NULL && !_storage->commit(m_begin))
+		{
+			return false;
+		}
+
+		m_base = static_cast<uint8_t*>(_buffer);
+		m_storage = _storage;
+		m_data = new (m_base) SharedData();
+		m_data->capacity = _capacity;
+		m_capacity = _capacity;
+
+		// The buffer starts over, a recording would no longer replay
+		stopRecording();
+		m_recorded.clear();
+		m_recordSequence = 0;
+		m_recordTail = 0;
+
+		m_freeBlocks.clear();
+		m_retired.clear();
+		m_payloads.clear();
+		m_parkedMeshes.clear();
+		m_hierarchy.clear();
+		m_hierarchyStale = false;
+		m_hierarchyStaged = false;
+		m_models = RecordTable<Model>();
+		m_freeModels.clear();
+		m_materials = RecordTable<Material>();
+		m_strings = RecordTable<uint64_t>();
+		m_stringIds.clear();
+		m_stringBlobs.clear();
+		m_stringPage = 0;
+		m_stringPageUsed = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_materialMutex);
+			m_materialSlots.clear();
+		}
+		m_staged.clear();
+		m_overflow = false;
+		m_transformsStale = false;
+		m_cameraEvent = 0;
+		m_top = m_begin;
+
+		m_scene = Scene();
+		internString("");
+		publish();
+		return true;
+	}
+
+	void SceneWriter::reset()
+	{
+		// Reloading an unchanged scene should write next to nothing, so meshes
+		// are parked for the reload to pick up again rather than retired.
+		trimMeshCache();
+		{
+			std::lock_guard<std::mutex> lock(m_arenaMutex);
+			for (const Model& model : m_models.records)
+			{
+				const Mesh& mesh = model.mesh;
+				if (mesh.blobOffset != 0)
+				{
+					m_parkedMeshes.insert(std::make_pair(mesh.hash, mesh));
+				}
+			}
+		}
+		for (const Model& model : m_models.records)
+		{
+			if (model.instancesOffset != 0)
+			{
+				retire(model.instancesOffset, sizeof(Instance) * model.numInstances);
+			}
+		}
+
+		m_models.records.clear();
+		m_freeModels.clear();
+		m_materials.records.clear();
+		{
+			std::lock_guard<std::mutex> lock(m_materialMutex);
+			m_materialSlots.clear();
+		}
+
+		// Strings are only dropped here, nothing refers to them anymore
+		for (const Blob& blob : m_stringBlobs)
+		{
+			retire(blob.offset, blob.size);
+		}
+		m_strings.records.clear();
+		m_stringIds.clear();
+		m_stringBlobs.clear();
+		m_stringPage = 0;
+		m_stringPageUsed = 0;
+		internString("");
+		m_scene.snapshotPath = 0;
+
+		m_staged.clear();
+		m_hierarchyStaged = false;
+		stageEvent(MAYABRIDGE_EVENT_RESET);
+
+		m_hierarchy.clear();
+		updateHierarchy(true);
+	}
+
+	void SceneWriter::publish()
+	{
+		if (m_hierarchyStale)
+		{
+			writeHierarchy();
+		}
+		writeRecords(m_models, m_scene.numModels, m_scene.modelsOffset);
+		writeRecords(m_materials, m_scene.numMaterials, m_scene.materialsOffset);
+		writeRecords(m_strings, m_scene.numStrings, m_scene.stringsOffset);
+
+		{
+			std::lock_guard<std::mutex> lock(m_arenaMutex);
+			m_scene.size = m_top;
+		}
+
+		if (m_recorder.isOpen())
+		{
+			recordBlobs();
+			m_recorder.writeScene(m_scene);
+		}
+
+		// Seqlock write, the sequence is odd while the records are copied. Blobs
+		// were written before this and are ordered by the release fence.
+		uint64_t sequence = m_data->sequence.load(std::memory_order_relaxed);
+		m_data->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		memcpy(&m_data->scene, &m_scene, sizeof(Scene));
+
+		m_data->sequence.store(sequence + 2, std::memory_order_seq_cst);
+		m_transformsStale = false;
+		m_hierarchyStaged = false;
+
+		flushEvents(sequence + 2);
+		reclaim();
+		reclaimPayloads();
+	}
+
+	template<typename T>
+	void SceneWriter::collectRecords(const RecordTable<T>& _table, std::vector<Blob>& _blobs) const
+	{
+		if (_table.directory != 0)
+		{
+			_blobs.push_back({ _table.directory, sizeof(uint64_t) * _table.numDirectory });
+		}
+		for (uint64_t chunk : _table.chunks)
+		{
+			if (chunk != 0)
+			{
+				_blobs.push_back({ chunk, sizeof(T) * MAYABRIDGE_SCENE_CHUNK_RECORDS });
+			}
+		}
+	}
+
+	void SceneWriter::collectBlobs(std::vector<Blob>& _blobs) const
+	{
+		// The rest of the arena is free, retired or still private to a worker
+		collectRecords(m_models, _blobs);
+		collectRecords(m_materials, _blobs);
+		collectRecords(m_strings, _blobs);
+		_blobs.insert(_blobs.end(), m_stringBlobs.begin(), m_stringBlobs.end());
+		for (uint32_t ii = 0; ii < m_scene.numModels; ++ii)
+		{
+			const Model& model = m_scene.getModel(m_base, ii);
+			if (model.mesh.blobOffset != 0)
+			{
+				_blobs.push_back({ model.mesh.blobOffset, model.mesh.blobSize });
+			}
+			if (model.instancesOffset != 0)
+			{
+				_blobs.push_back({ model.instancesOffset, sizeof(Instance) * model.numInstances });
+			}
+		}
+		if (m_scene.nodesOffset != 0)
+		{
+			_blobs.push_back({ m_scene.nodesOffset, sizeof(HierarchyNode) * m_scene.numNodes });
+		}
+	}
+
+	void SceneWriter::recordBlobs()
+	{
+		std::vector<Blob> blobs;
+		collectBlobs(blobs);
+
+		// Only what is new since the last publish, string pages are appended
+		// to in place
+		std::vector<Blob> ranges;
+		{
+			std::lock_guard<std::mutex> lock(m_arenaMutex);
+			for (Blob blob : blobs)
+			{
+				if (blob.offset == m_stringPage)
+				{
+					blob.size = m_stringPageUsed;
+				}
+
+				uint64_t& recorded = m_recorded[blob.offset];
+				if (recorded < blob.size)
+				{
+					ranges.push_back({ blob.offset + recorded, blob.size - recorded });
+					recorded = blob.size;
+				}
+			}
+		}
+
+		StreamBlob header = { 0, m_recordSequence, m_recordTail };
+		for (const Blob& range : ranges)
+		{
+			header.offset = range.offset;
+			m_recorder.writeBlob(header, m_base + range.offset, range.size);
+		}
+	}
+
+	void SceneWriter::recordPayload(uint64_t _offset, uint64_t _size)
+	{
+		if (m_recorder.isOpen())
+		{
+			StreamBlob header = { _offset, m_recordSequence, m_recordTail };
+			m_recorder.writeBlob(header, m_base + _offset, _size);
+		}
+	}
+
+	bool SceneWriter::startRecording(const char* _path)
+	{
+		stopRecording();
+		if (!m_recorder.open(_path, *m_data))
+		{
+			return false;
+		}
+
+		// Nothing in the buffer is in the file yet, the publish writes what
+		// the scene references
+		{
+			std::lock_guard<std::mutex> lock(m_arenaMutex);
+			m_recorded.clear();
+		}
+		m_recordSequence = 0;
+		m_recordTail = 0;
+
+		publish();
+		return m_recorder.isOpen();
+	}
+
+	void SceneWriter::stopRecording()
+	{
+		m_recorder.close();
+	}
+
+	bool SceneWriter::isRecording() const
+	{
+		return m_recorder.isOpen();
+	}
+
+	void SceneWriter::captureSnapshot(const char* _path, SnapshotData& _snapshot)
+	{
+		m_scene.snapshotPath = internString(_path);
+		publish();
+
+		std::vector<Blob> blobs;
+		collectBlobs(blobs);
+		std::sort(blobs.begin(), blobs.end(), [](const Blob& _a, const Blob& _b) { return _a.offset < _b.offset; });
+
+		// A fresh header, nothing in the ring and no reader
+		_snapshot.path = _path;
+		_snapshot.size = m_scene.size;
+		_snapshot.header.reset(new SharedData());
+		_snapshot.header->capacity = m_scene.size;
+		memcpy((void*)&_snapshot.header->camera, (const void*)&m_data->camera, sizeof(SharedCamera));
+		memcpy(&_snapshot.header->scene, &m_scene, sizeof(Scene));
+
+		// Copied now, the blobs may be retired and reused before the file is
+		// written
+		uint64_t total = 0;
+		for (const Blob& blob : blobs)
+		{
+			total += blob.size;
+		}
+
+		_snapshot.offsets.resize(blobs.size());
+		_snapshot.sizes.resize(blobs.size());
+		_snapshot.bytes.resize(size_t(total));
+
+		uint8_t* bytes = _snapshot.bytes.data();
+		for (size_t ii = 0; ii < blobs.size(); ++ii)
+		{
+			_snapshot.offsets[ii] = blobs[ii].offset;
+			_snapshot.sizes[ii] = blobs[ii].size;
+			memcpy(bytes, m_base + blobs[ii].offset, size_t(blobs[ii].size));
+			bytes += blobs[ii].size;
+		}
+	}
+
+	bool SceneWriter::writeSnapshot(const SnapshotData& _snapshot)
+	{
+		std::string temporary = _snapshot.path + ".tmp";
+		bool written = false;
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(_snapshot.header.get()), sizeof(SharedData));
+
+			uint64_t end = sizeof(SharedData);
+			const uint8_t* bytes = _snapshot.bytes.data();
+			for (size_t ii = 0; ii < _snapshot.offsets.size(); ++ii)
+			{
+				file.seekp(std::streamoff(_snapshot.offsets[ii]));
+				file.write(reinterpret_cast<const char*>(bytes), std::streamsize(_snapshot.sizes[ii]));
+				bytes += _snapshot.sizes[ii];
+				end = std::max(end, _snapshot.offsets[ii] + _snapshot.sizes[ii]);
+			}
+			if (end < _snapshot.size)
+			{
+				file.seekp(std::streamoff(_snapshot.size - 1));
+				file.put(0);
+			}
+
+			written = bool(file.flush());
+		}
+
+		std::error_code error;
+		if (written)
+		{
+			std::filesystem::rename(temporary, _snapshot.path, error);
+		}
+		if (!written || error)
+		{
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+
+		return true;
+	}
+
+	void SceneWriter::publishCamera(const Camera& _camera)
+	{
+		SharedCamera& shared = m_data->camera;
+
+		uint64_t sequence = shared.sequence.load(std::memory_order_relaxed);
+		shared.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		memcpy(&shared.camera, &_camera, sizeof(Camera));
+
+		shared.sequence.store(sequence + 2, std::memory_order_release);
+		m_recorder.writeCamera(_camera);
+
+		// The slot sequence is what says the camera moved, the event only
+		// wakes a consumer waiting on the ring. One is enough until it has
+		// been consumed, an orbit must not fill the ring.
+		if (m_data->events.tail.load(std::memory_order_acquire) < m_cameraEvent)
+		{
+			return;
+		}
+
+		// A resync has to point at a snapshot that has every transform batch
+		// sent before the overflow in it.
+		if (m_overflow && m_transformsStale)
+		{
+			publish();
+		}
+
+		Event event = { MAYABRIDGE_EVENT_CAMERA_CHANGED, 0, sequence + 2, 0 };
+		if (emitEvent(event))
+		{
+			m_cameraEvent = m_data->events.head.load(std::memory_order_relaxed);
+		}
+	}
+
+	void SceneWriter::flushStaged()
+	{
+		// Payload events go out straight away, they must not overtake the
+		// changes they refer to.
+		if (!m_staged.empty())
+		{
+			publish();
+		}
+	}
+
+	void SceneWriter::writeHierarchy()
+	{
+		// Local matrices change without a publish, so the blob is written
+		// again rather than patched
+		if (m_scene.nodesOffset != 0)
+		{
+			retire(m_scene.nodesOffset, sizeof(HierarchyNode) * m_scene.numNodes);
+		}
+
+		m_scene.numNodes = 0;
+		m_scene.nodesOffset = 0;
+		if (!m_hierarchy.empty())
+		{
+			uint64_t size = sizeof(HierarchyNode) * m_hierarchy.size();
+			uint64_t offset = alloc(size);
+			if (offset != 0)
+			{
+				memcpy(m_base + offset, m_hierarchy.data(), size);
+				m_scene.numNodes = uint32_t(m_hierarchy.size());
+				m_scene.nodesOffset = offset;
+			}
+		}
+
+		m_hierarchyStale = false;
+	}
+
+	void SceneWriter::publishTransforms(const uint32_t* _nodes, uint32_t _count)
+	{
+		if (_count == 0)
+		{
+			return;
+		}
+
+		reclaimPayloads();
+		flushStaged();
+		m_hierarchyStale = true;
+
+		// A consumer that is behind rebuilds from a snapshot instead, so make
+		// sure there is one with the new transforms.
+		uint64_t size = sizeof(Transform) * _count;
+		uint64_t offset = m_overflow ? 0 : alloc(size);
+		if (offset == 0)
+		{
+			m_overflow = true;
+			publish();
+			return;
+		}
+
+		Transform* transforms = reinterpret_cast<Transform*>(m_base + offset);
+		for (uint32_t ii = 0; ii < _count; ++ii)
+		{
+			Transform& transform = transforms[ii];
+			transform.node = _nodes[ii];
+			transform.hierarchy = m_scene.hierarchyId;
+			memcpy(transform.local, m_hierarchy[_nodes[ii]].local, sizeof(transform.local));
+		}
+		recordPayload(offset, size);
+
+		// Released by the store of the ring head.
+		uint64_t position = m_data->events.head.load(std::memory_order_relaxed);
+		Event event = { MAYABRIDGE_EVENT_TRANSFORM_CHANGED, _count, m_data->sequence.load(std::memory_order_relaxed), offset };
+		if (!emitEvent(event))
+		{
+			free(offset, size);
+			publish();
+			return;
+		}
+
+		m_payloads.push_back({ position, offset, size });
+		m_transformsStale = true;
+	}
+
+	bool SceneWriter::publishVertices(uint32_t _index, const VertexDeltaData& _delta)
+	{
+		// Quantized vertices can't be patched from float deltas, positions
+		// outside the old bounds would be clamped onto them and the tangent
+		// frame the delta doesn't carry would go stale
+		if (m_models.records[_index].mesh.vertexFormat != MAYABRIDGE_VERTEX_FORMAT_FLOAT)
+		{
+			return false;
+		}
+
+		flushStaged();
+		if (m_overflow)
+		{
+			return false;
+		}
+
+		uint64_t headerSize = alignUp(sizeof(VertexDelta), 16);
+		uint64_t runsSize = alignUp(sizeof(VertexRun) * _delta.runs.size(), 16);
+		uint64_t size = headerSize + runsSize + sizeof(DeltaVertex) * _delta.vertices.size();
+
+		uint64_t offset = alloc(size);
+		if (offset == 0)
+		{
+			return false;
+		}
+
+		const Model& model = m_models.records[_index];
+
+		VertexDelta* delta = reinterpret_cast<VertexDelta*>(m_base + offset);
+		delta->modelId = model.id;
+		delta->meshId = model.mesh.id;
+		delta->numRuns = uint32_t(_delta.runs.size());
+		delta->numVertices = uint32_t(_delta.vertices.size());
+		delta->runsOffset = offset + headerSize;
+		delta->verticesOffset = offset + headerSize + runsSize;
+		memcpy(m_base + delta->runsOffset, _delta.runs.data(), sizeof(VertexRun) * _delta.runs.size());
+		memcpy(m_base + delta->verticesOffset, _delta.vertices.data(), sizeof(DeltaVertex) * _delta.vertices.size());
+		recordPayload(offset, size);
+
+		uint64_t position = m_data->events.head.load(std::memory_order_relaxed);
+		Event event = { MAYABRIDGE_EVENT_VERTICES_CHANGED, _index, m_data->sequence.load(std::memory_order_relaxed), offset };
+		if (!emitEvent(event))
+		{
+			free(offset, size);
+			return false;
+		}
+
+		m_payloads.push_back({ position, offset, size });
+		return true;
+	}
+
+	uint32_t SceneWriter::addModel()
+	{
+		// Reuse the lowest empty slot so indices stay stable while a model
+		// lives. Slots trimmed off the end or taken again since they were
+		// freed are skipped.
+		uint32_t index = uint32_t(m_models.records.size());
+		while (!m_freeModels.empty())
+		{
+			std::pop_heap(m_freeModels.begin(), m_freeModels.end(), std::greater<uint32_t>());
+			uint32_t slot = m_freeModels.back();
+			m_freeModels.pop_back();
+
+			if (slot >= m_models.records.size())
+			{
+				m_freeModels.clear();
+			}
+			else if (m_models.records[slot].id == 0)
+			{
+				index = slot;
+				break;
+			}
+		}
+
+		if (index == m_models.records.size())
+		{
+			m_models.records.emplace_back();
+		}
+
+		Model& model = editModel(index);
+		model.reset();
+		model.id = m_nextModelId++;
+
+		stageEvent(MAYABRIDGE_EVENT_MODEL_ADDED, index);
+		return index;
+	}
+
+	void SceneWriter::removeModel(uint32_t _index)
+	{
+		Model& model = editModel(_index);
+		freeMesh(model.mesh);
+		if (model.instancesOffset != 0)
+		{
+			retire(model.instancesOffset, sizeof(Instance) * model.numInstances);
+		}
+		model.reset();
+
+		// Trim empty slots at the end.
+		while (!m_models.records.empty() && m_models.records.back().id == 0)
+		{
+			m_models.records.pop_back();
+		}
+		if (_index < m_models.records.size())
+		{
+			m_freeModels.push_back(_index);
+			std::push_heap(m_freeModels.begin(), m_freeModels.end(), std::greater<uint32_t>());
+		}
+
+		stageEvent(MAYABRIDGE_EVENT_MODEL_REMOVED, _index);
+	}
+
+	bool SceneWriter::setInstances(uint32_t _index, const Instance* _instances, uint32_t _count)
+	{
+		Model& model = editModel(_index);
+		if (model.instancesOffset != 0)
+		{
+			retire(model.instancesOffset, sizeof(Instance) * model.numInstances);
+		}
+
+		bool fits = true;
+		model.numInstances = _count;
+		model.instancesOffset = 0;
+		if (_count > 1)
+		{
+			uint64_t offset = alloc(sizeof(Instance) * _count);
+			if (offset != 0)
+			{
+				memcpy(m_base + offset, _instances, sizeof(Instance) * _count);
+				model.instancesOffset = offset;
+			}
+			else
+			{
+				model.numInstances = 1;
+				fits = false;
+			}
+		}
+
+		stageEvent(MAYABRIDGE_EVENT_INSTANCES_CHANGED, _index);
+		return fits;
+	}
+
+	uint32_t SceneWriter::getNumModels() const
+	{
+		return uint32_t(m_models.records.size());
+	}
+
+	const Model& SceneWriter::getModel(uint32_t _index) const
+	{
+		return m_models.records[_index];
+	}
+
+	Model& SceneWriter::editModel(uint32_t _index)
+	{
+		return editRecord(m_models, _index);
+	}
+
+	uint32_t SceneWriter::addMaterial(const char* _name)
+	{
+		uint32_t index = uint32_t(m_materials.records.size());
+		m_materials.records.emplace_back();
+		editMaterial(index).name = internString(_name);
+
+		{
+			std::lock_guard<std::mutex> lock(m_materialMutex);
+			m_materialSlots.insert(std::make_pair(std::string(_name), index));
+		}
+
+		stageEvent(MAYABRIDGE_EVENT_MATERIAL_ADDED, index);
+		return index;
+	}
+
+	const Material& SceneWriter::getMaterial(uint32_t _index) const
+	{
+		return m_materials.records[_index];
+	}
+
+	Material& SceneWriter::editMaterial(uint32_t _index)
+	{
+		return editRecord(m_materials, _index);
+	}
+
+	uint32_t SceneWriter::findMaterial(const std::string& _name) const
+	{
+		std::lock_guard<std::mutex> lock(m_materialMutex);
+
+		auto it = m_materialSlots.find(_name);
+		return it != m_materialSlots.end() ? it->second : UINT32_MAX;
+	}
+
+	uint32_t SceneWriter::internString(const char* _string)
+	{
+		auto it = m_stringIds.find(_string);
+		if (it != m_stringIds.end())
+		{
+			return it->second;
+		}
+
+		// Packed into pages, the bytes of a published string are never
+		// touched again and the rest of its page isn't read before the next
+		// publish
+		uint64_t size = strlen(_string) + 1;
+		uint64_t offset = 0;
+		if (size > MAYABRIDGE_STRING_PAGE_SIZE)
+		{
+			offset = alloc(size);
+			if (offset == 0)
+			{
+				return 0;
+			}
+			m_stringBlobs.push_back({ offset, size });
+		}
+		else
+		{
+			if (m_stringPage == 0 || m_stringPageUsed + size > MAYABRIDGE_STRING_PAGE_SIZE)
+			{
+				uint64_t page = alloc(MAYABRIDGE_STRING_PAGE_SIZE);
+				if (page == 0)
+				{
+					return 0;
+				}
+				m_stringBlobs.push_back({ page, MAYABRIDGE_STRING_PAGE_SIZE });
+				m_stringPage = page;
+				m_stringPageUsed = 0;
+			}
+
+			offset = m_stringPage + m_stringPageUsed;
+			m_stringPageUsed += size;
+		}
+		memcpy(m_base + offset, _string, size);
+
+		uint32_t id = uint32_t(m_strings.records.size());
+		m_strings.records.push_back(0);
+		editRecord(m_strings, id) = offset;
+		m_stringIds.insert(std::make_pair(std::string(_string), id));
+		return id;
+	}
+
+	const char* SceneWriter::getString(uint32_t _id) const
+	{
+		return reinterpret_cast<const char*>(m_base + m_strings.records[_id]);
+	}
+
+	std::vector<HierarchyNode>& SceneWriter::getHierarchy()
+	{
+		return m_hierarchy;
+	}
+
+	void SceneWriter::updateHierarchy(bool _renumbered)
+	{
+		if (_renumbered)
+		{
+			m_scene.hierarchyId += 1;
+		}
+
+		m_hierarchyStale = true;
+		if (!m_hierarchyStaged)
+		{
+			stageEvent(MAYABRIDGE_EVENT_HIERARCHY_CHANGED);
+			m_hierarchyStaged = true;
+		}
+	}
+
+	void SceneWriter::stageEvent(uint32_t _type, uint32_t _index)
+	{
+		Event event = { _type, _index, 0, 0 };
+		m_staged.push_back(event);
+	}
+
+	uint64_t SceneWriter::getNumResyncs() const
+	{
+		return m_numResyncs;
+	}
+
+	uint32_t SceneWriter::takeRequest()
+	{
+		return m_data->request.exchange(MAYABRIDGE_MESSAGE_NONE, std::memory_order_acq_rel);
+	}
+
+	bool SceneWriter::writeMesh(Mesh& _mesh, const MeshData& _data)
+	{
+		_mesh.reset();
+
+		VertexLayout layout;
+		if (!getVertexLayout(_data.vertexFormat, layout, _data.vertexLayout))
+		{
+			return false;
+		}
+
+		// One blob per mesh: submesh records, then the vertex streams, then the index ranges back to back
+		// followed by the LOD index ranges, then the meshlets if there are any.
+		uint64_t subMeshesSize = alignUp(sizeof(SubMesh) * _data.subMeshes.size(), MAYABRIDGE_SCENE_ALIGNMENT);
+		uint64_t streamSizes[MAYABRIDGE_VERTEX_MAX_STREAMS];
+		uint64_t verticesSize = 0;
+		for (uint32_t ii = 0; ii < MAYABRIDGE_VERTEX_MAX_STREAMS; ++ii)
+		{
+			streamSizes[ii] = alignUp(uint64_t(layout.streamStrides[ii]) * _data.vertices.size(), MAYABRIDGE_SCENE_ALIGNMENT);
+			verticesSize += streamSizes[ii];
+		}
+		// 16-bit indices whenever every vertex fits, 0xffff stays free for primitive restart
+		uint32_t indexSize = _data.vertices.size() < UINT16_MAX ? sizeof(uint16_t) : sizeof(uint32_t);
+		uint64_t indicesSize = alignUp(uint64_t(indexSize) * (_data.indices.size() + _data.lodIndices.size()), MAYABRIDGE_SCENE_ALIGNMENT);
+		uint64_t lodIndicesOffset = uint64_t(indexSize) * _data.indices.size();
+
+		uint64_t meshletsSize = alignUp(sizeof(Meshlet) * _data.meshletRecords.size(), MAYABRIDGE_SCENE_ALIGNMENT);
+		uint64_t meshletVerticesSize = alignUp(sizeof(uint32_t) * _data.meshletVertices.size(), MAYABRIDGE_SCENE_ALIGNMENT);
+		uint64_t meshletTrianglesSize = alignUp(_data.meshletTriangles.size(), MAYABRIDGE_SCENE_ALIGNMENT);
+
+		uint64_t size = subMeshesSize + verticesSize + indicesSize + meshletsSize + meshletVerticesSize + meshletTrianglesSize;
+
+		uint64_t offset = alloc(size);
+		if (offset == 0)
+		{
+			return false;
+		}
+
+		_mesh.id = m_nextMeshId.fetch_add(1, std::memory_order_relaxed);
+		_mesh.hash = _data.hash;
+		_mesh.blobOffset = offset;
+		_mesh.blobSize = size;
+
+		_mesh.numSubMeshes = uint32_t(_data.subMeshes.size());
+		_mesh.subMeshesOffset = offset;
+		offset += subMeshesSize;
+
+		_mesh.numVertices = uint32_t(_data.vertices.size());
+		_mesh.verticesOffset = offset;
+		_mesh.vertexFormat = _data.vertexFormat;
+		_mesh.vertexLayout = _data.vertexLayout;
+		_mesh.vertexStride = layout.stride;
+
+		uint8_t* streams[MAYABRIDGE_VERTEX_MAX_STREAMS];
+		for (uint32_t ii = 0; ii < MAYABRIDGE_VERTEX_MAX_STREAMS; ++ii)
+		{
+			_mesh.streams[ii].offset = layout.streamStrides[ii] != 0 ? offset : 0;
+			_mesh.streams[ii].stride = layout.streamStrides[ii];
+			streams[ii] = m_base + offset;
+			offset += streamSizes[ii];
+		}
+
+		// Quantized formats are encoded straight into the blob
+		_mesh.bounds = _data.bounds;
+		getPositionRange(_data.bounds, _mesh.positionOffset, _mesh.positionScale);
+		if (_data.vertexLayout == MAYABRIDGE_VERTEX_LAYOUT_INTERLEAVED)
+		{
+			encodeVertices(_data.vertexFormat, _data.vertices.data(), _mesh.numVertices, _mesh.positionOffset, _mesh.positionScale, streams[0]);
+		}
+		else
+		{
+			encodeVertexStreams(_data.vertexFormat, layout, _data.vertices.data(), _mesh.numVertices, _mesh.positionOffset, _mesh.positionScale, streams);
+		}
+
+		// Lets the consumer re-upload only the streams that changed, like
+		// positions after a deformation.
+		for (uint32_t ii = 0; ii < MAYABRIDGE_VERTEX_MAX_STREAMS; ++ii)
+		{
+			if (_mesh.streams[ii].stride != 0)
+			{
+				_mesh.streams[ii].hash = hashBytes(streams[ii], uint64_t(_mesh.streams[ii].stride) * _mesh.numVertices);
+			}
+		}
+
+		uint64_t indicesOffset = offset;
+		_mesh.indexSize = indexSize;
+		for (const std::vector<uint32_t>* source : { &_data.indices, &_data.lodIndices })
+		{
+			uint8_t* dest = m_base + indicesOffset + (source == &_data.indices ? 0 : lodIndicesOffset);
+			if (indexSize == sizeof(uint16_t))
+			{
+				uint16_t* indices = reinterpret_cast<uint16_t*>(dest);
+				for (size_t ii = 0; ii < source->size(); ++ii)
+				{
+					indices[ii] = uint16_t((*source)[ii]);
+				}
+			}
+			else
+			{
+				memcpy(dest, source->data(), sizeof(uint32_t) * source->size());
+			}
+		}
+		offset += indicesSize;
+
+		// Meshlets after the indices, with the arrays they index
+		uint64_t meshletsOffset = offset;
+		memcpy(m_base + meshletsOffset, _data.meshletRecords.data(), sizeof(Meshlet) * _data.meshletRecords.size());
+		offset += meshletsSize;
+
+		_mesh.meshletVerticesOffset = offset;
+		memcpy(m_base + offset, _data.meshletVertices.data(), sizeof(uint32_t) * _data.meshletVertices.size());
+		offset += meshletVerticesSize;
+
+		_mesh.meshletTrianglesOffset = offset;
+		memcpy(m_base + offset, _data.meshletTriangles.data(), _data.meshletTriangles.size());
+
+		SubMesh* subMeshes = reinterpret_cast<SubMesh*>(m_base + _mesh.subMeshesOffset);
+		for (uint32_t ii = 0; ii < _mesh.numSubMeshes; ++ii)
+		{
+			const SubMeshData& data = _data.subMeshes[ii];
+
+			SubMesh* subMesh = new (&subMeshes[ii]) SubMesh();
+			subMesh->material = findMaterial(data.material);
+			subMesh->hash = data.hash;
+			subMesh->bounds = data.bounds;
+			subMesh->numIndices = data.numIndices;
+			subMesh->indicesOffset = indicesOffset + uint64_t(indexSize) * data.firstIndex;
+			subMesh->numMeshlets = data.numMeshlets;
+			subMesh->meshletsOffset = meshletsOffset + sizeof(Meshlet) * data.firstMeshlet;
+
+			subMesh->numLods = 1;
+			subMesh->lods[0].numIndices = subMesh->numIndices;
+			subMesh->lods[0].indicesOffset = subMesh->indicesOffset;
+			for (const LodData& lod : data.lods)
+			{
+				if (subMesh->numLods == MAYABRIDGE_MAX_LODS)
+				{
+					break;
+				}
+
+				SubMeshLod& level = subMesh->lods[subMesh->numLods++];
+				level.numIndices = lod.numIndices;
+				level.error = lod.error;
+				level.indicesOffset = indicesOffset + lodIndicesOffset + uint64_t(indexSize) * lod.firstIndex;
+			}
+		}
+
+		return true;
+	}
+
+	void SceneWriter::discardMesh(const Mesh& _mesh)
+	{
+		// Never published, so nobody can be reading it.
+		if (_mesh.blobOffset != 0)
+		{
+			free(_mesh.blobOffset, _mesh.blobSize);
+		}
+	}
+
+	bool SceneWriter::reuseMesh(Mesh& _mesh, const MeshData& _data)
+	{
+		std::lock_guard<std::mutex> lock(m_arenaMutex);
+
+		// The hash covers the material names, but the reload may have put
+		// the materials in other slots
+		auto range = m_parkedMeshes.equal_range(_data.hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			const Mesh& parked = it->second;
+			const SubMesh* subMeshes = parked.getSubMeshes(m_base);
+
+			bool matches = parked.numSubMeshes == _data.subMeshes.size();
+			for (uint32_t ii = 0; ii < parked.numSubMeshes && matches; ++ii)
+			{
+				matches = subMeshes[ii].material == findMaterial(_data.subMeshes[ii].material);
+			}
+
+			if (matches)
+			{
+				_mesh = parked;
+				m_parkedMeshes.erase(it);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void SceneWriter::trimMeshCache()
+	{
+		std::vector<Mesh> meshes;
+		{
+			std::lock_guard<std::mutex> lock(m_arenaMutex);
+			for (auto& parked : m_parkedMeshes)
+			{
+				meshes.push_back(parked.second);
+			}
+			m_parkedMeshes.clear();
+		}
+
+		for (Mesh& mesh : meshes)
+		{
+			freeMesh(mesh);
+		}
+	}
+
+	void SceneWriter::setMesh(uint32_t _index, const Mesh& _mesh, bool _notify)
+	{
+		Model& model = editModel(_index);
+
+		// Same vertices the consumer already patched in, only the snapshot
+		// needs to catch up.
+		uint64_t id = _notify ? _mesh.id : model.mesh.id;
+
+		freeMesh(model.mesh);
+		model.mesh = _mesh;
+		model.mesh.id = id;
+
+		if (_notify)
+		{
+			stageEvent(MAYABRIDGE_EVENT_MODEL_CHANGED, _index);
+		}
+	}
+
+	void SceneWriter::freeMesh(Mesh& _mesh)
+	{
+		if (_mesh.blobOffset != 0)
+		{
+			retire(_mesh.blobOffset, _mesh.blobSize);
+		}
+		_mesh.reset();
+	}
+
+	Scene& SceneWriter::getScene()
+	{
+		return m_scene;
+	}
+
+} // namespace mb
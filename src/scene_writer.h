@@ -0,0 +1,308 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include "maya-bridge/shared_buffer.h"
+#include "maya-bridge/shared_data.h"
+#include "stream_recorder.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mb
+{
+	/// Simplified level of a submesh, a range of MeshData::lodIndices.
+	///
+	struct LodData
+	{
+		uint32_t firstIndex = 0;
+		uint32_t numIndices = 0;
+		float error = 0.0f;
+	};
+
+	/// Mesh extracted from Maya before it is packed into the shared arena.
+	/// Submeshes are consecutive ranges of one index array.
+	///
+	struct SubMeshData
+	{
+		uint32_t firstIndex = 0;
+		uint32_t numIndices = 0;
+		uint32_t firstMeshlet = 0;
+		uint32_t numMeshlets = 0;
+		uint64_t hash = 0;
+		std::string material;
+		std::vector<LodData> lods; //!< Below the full submesh, finest first.
+		Bounds bounds = {};
+	};
+
+	struct MeshData
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<SubMeshData> subMeshes;
+		uint64_t hash = 0;
+		Bounds bounds = {};
+		uint32_t vertexFormat = MAYABRIDGE_VERTEX_FORMAT_FLOAT; //!< Format the vertices are written in.
+		uint32_t vertexLayout = MAYABRIDGE_VERTEX_LAYOUT_INTERLEAVED;
+		bool optimize = false; //!< Reorder triangles and vertices for the GPU caches.
+		bool meshlets = false; //!< Split submeshes into meshlets.
+		uint32_t lodLevels = 0; //!< Simplified levels to build for heavy meshes.
+
+		std::vector<Meshlet> meshletRecords;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+
+		std::vector<uint32_t> lodIndices;
+	};
+
+	/// Vertex changes before they are packed into a VertexDelta payload.
+	///
+	struct VertexDeltaData
+	{
+		std::vector<VertexRun> runs;
+		std::vector<DeltaVertex> vertices;
+	};
+
+	/// Published scene copied out of the arena, for the file to be written
+	/// on a worker while the arena moves on.
+	///
+	struct SnapshotData
+	{
+		std::string path;
+		uint64_t size = 0;                  //!< Of the file, the capacity of the buffer.
+		std::unique_ptr<SharedData> header; //!< Scene and camera, nothing in the ring and no reader.
+		std::vector<uint64_t> offsets;      //!< Of each blob in the file, ascending.
+		std::vector<uint64_t> sizes;
+		std::vector<uint8_t> bytes;         //!< The blobs back to back.
+	};
+
+	/// Owns the layout of the shared scene buffer: the SharedData header at
+	/// the start and a first-fit arena of variable sized blobs after it.
+	///
+	/// Records are edited in a private Scene and copied into the header by
+	/// publish. Blobs that are replaced are retired rather than freed, and
+	/// reused once the reader no longer holds a snapshot referencing them.
+	/// Events staged since the last publish go out right after it.
+	///
+	/// Everything but writeMesh and discardMesh belongs to the main thread.
+	///
+	class SceneWriter
+	{
+		struct Retired
+		{
+			uint64_t offset;
+			uint64_t size;
+			uint64_t sequence; //!< First published sequence not referencing the blob.
+		};
+
+		struct Payload
+		{
+			uint64_t position; //!< Ring position of the event carrying it.
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		struct Blob
+		{
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		/// Records of one kind and the chunks they were last published in.
+		template<typename T>
+		struct RecordTable
+		{
+			std::vector<T> records;
+			std::vector<uint64_t> chunks; //!< Blob of each chunk, 0 until it is first written.
+			std::vector<bool> dirty;      //!< Chunks with records changed since they were written.
+			std::vector<uint32_t> counts; //!< Records each chunk held when it was written.
+			uint64_t directory = 0;       //!< Blob of the chunk offsets.
+			uint32_t numDirectory = 0;
+		};
+
+		bool initArena(void* _buffer, uint64_t _capacity, SharedBuffer* _storage);
+
+		uint64_t alloc(uint64_t _size);
+		void free(uint64_t _offset, uint64_t _size);
+		void retire(uint64_t _offset, uint64_t _size);
+		void reclaim();
+		void reclaimPayloads();
+
+		bool pushEvent(const Event& _event);
+		bool emitEvent(const Event& _event);
+		void flushEvents(uint64_t _sequence);
+		void flushStaged();
+		void writeHierarchy();
+		void collectBlobs(std::vector<Blob>& _blobs) const;
+		void recordBlobs();
+		void recordPayload(uint64_t _offset, uint64_t _size);
+
+		template<typename T>
+		T& editRecord(RecordTable<T>& _table, uint32_t _index);
+
+		template<typename T>
+		void writeRecords(RecordTable<T>& _table, uint32_t& _count, uint64_t& _offset);
+
+		template<typename T>
+		void collectRecords(const RecordTable<T>& _table, std::vector<Blob>& _blobs) const;
+
+	public:
+		SceneWriter();
+
+		bool init(void* _buffer, uint64_t _capacity);
+
+		/// Lays the scene out in all of _buffer, and commits the mapping as
+		/// the arena grows into it.
+		bool init(SharedBuffer& _buffer);
+		void reset();
+
+		void publish();
+		void publishCamera(const Camera& _camera);
+
+		/// Publishes with _path as the snapshot path, then copies what the
+		/// scene references into _snapshot for writeSnapshot.
+		void captureSnapshot(const char* _path, SnapshotData& _snapshot);
+
+		/// Writes _snapshot to a file laid out like the buffer, for a consumer
+		/// to map instead of waiting for the scene. Only blobs the scene
+		/// references are written, the gaps read as 0. Doesn't touch the
+		/// writer, so it is safe to call from worker threads. Stage
+		/// MAYABRIDGE_EVENT_SNAPSHOT_WRITTEN once it returned true.
+		static bool writeSnapshot(const SnapshotData& _snapshot);
+
+		/// Records every publication from here on to a stream file at _path,
+		/// for the replay tool to play back without Maya. Publishes, so the
+		/// file starts with everything the scene references.
+		bool startRecording(const char* _path);
+		void stopRecording();
+		bool isRecording() const;
+
+		/// Sends the local matrices of the given hierarchy nodes as one
+		/// batch, without publishing the rest of the scene.
+		void publishTransforms(const uint32_t* _nodes, uint32_t _count);
+
+		/// Sends changed vertices of model _index for the consumer to patch
+		/// its copy of the mesh with. The published mesh isn't touched, so
+		/// it is stale until it is replaced with setMesh. Returns false if the
+		/// delta couldn't be delivered and the mesh has to be sent whole,
+		/// which is always the case for meshes in a quantized vertex format.
+		bool publishVertices(uint32_t _index, const VertexDeltaData& _delta);
+
+		uint32_t addModel();
+		void removeModel(uint32_t _index);
+		uint32_t getNumModels() const;
+		const Model& getModel(uint32_t _index) const;
+
+		/// Marks the chunk of the record changed, so it is written again with
+		/// the next publish.
+		Model& editModel(uint32_t _index);
+
+		/// Replaces the instance table of model _index. Returns false if the
+		/// table didn't fit and only the first instance was kept.
+		bool setInstances(uint32_t _index, const Instance* _instances, uint32_t _count);
+
+		uint32_t addMaterial(const char* _name);
+		const Material& getMaterial(uint32_t _index) const;
+		Material& editMaterial(uint32_t _index);
+
+		/// Slot of the first material named _name, UINT32_MAX if there is
+		/// none. Safe to call from worker threads.
+		uint32_t findMaterial(const std::string& _name) const;
+
+		/// Id of _string in the interned strings, which are kept until the
+		/// scene is reset. 0 is the empty string, also returned when the
+		/// buffer is full.
+		uint32_t internString(const char* _string);
+		const char* getString(uint32_t _id) const;
+
+		/// Nodes of the published hierarchy, parents first. Edited in place
+		/// like the scene records, then sent whole with updateHierarchy or,
+		/// when only local matrices changed, with publishTransforms.
+		std::vector<HierarchyNode>& getHierarchy();
+
+		/// Writes the hierarchy again with the next publish. With _renumbered,
+		/// indices from before may now mean other nodes.
+		void updateHierarchy(bool _renumbered);
+
+		void stageEvent(uint32_t _type, uint32_t _index = 0);
+		uint32_t takeRequest();
+
+		/// Counts the resyncs sent, a consumer that resynced has rebuilt from
+		/// the snapshot and missed what was only sent as deltas.
+		uint64_t getNumResyncs() const;
+
+		/// Packs _data into a new blob and points _mesh at it. The blob stays
+		/// private until it is set on a model and published, so this is safe
+		/// to call from worker threads.
+		bool writeMesh(Mesh& _mesh, const MeshData& _data);
+		void discardMesh(const Mesh& _mesh);
+
+		/// Takes a mesh parked by reset with the content of _data instead of
+		/// writing it again. Safe to call from worker threads.
+		bool reuseMesh(Mesh& _mesh, const MeshData& _data);
+
+		/// Drops parked meshes nothing has reused, once the scene is reloaded.
+		void trimMeshCache();
+
+		/// Without _notify the mesh keeps the id of the one it replaces and no
+		/// event is sent, for catching the snapshot up with delivered deltas.
+		void setMesh(uint32_t _index, const Mesh& _mesh, bool _notify = true);
+		void freeMesh(Mesh& _mesh);
+
+		Scene& getScene();
+
+	private:
+		uint8_t* m_base;
+		SharedData* m_data;
+		SharedBuffer* m_storage; //!< Committed as the arena grows, NULL if it is all usable.
+		Scene m_scene;
+		RecordTable<Model> m_models;
+		std::vector<uint32_t> m_freeModels; //!< Empty model slots, a min-heap.
+		RecordTable<Material> m_materials;
+		RecordTable<uint64_t> m_strings; //!< Offset of each interned string.
+
+		std::unordered_map<std::string, uint32_t> m_stringIds;
+		std::vector<Blob> m_stringBlobs; //!< Pages, and strings too long for one.
+		uint64_t m_stringPage;           //!< Page strings are appended to, 0 if none.
+		uint64_t m_stringPageUsed;
+
+		mutable std::mutex m_materialMutex;
+		std::unordered_map<std::string, uint32_t> m_materialSlots;
+
+		uint64_t m_begin;
+		uint64_t m_capacity;
+		uint64_t m_top;
+
+		std::mutex m_arenaMutex;
+		std::map<uint64_t, uint64_t> m_freeBlocks;
+		std::vector<Retired> m_retired;
+		std::vector<Payload> m_payloads;
+		std::unordered_multimap<uint64_t, Mesh> m_parkedMeshes; //!< Meshes of the scene before the last reset, by hash.
+
+		StreamRecorder m_recorder;
+		std::unordered_map<uint64_t, uint64_t> m_recorded; //!< Bytes recorded of each blob, until it is freed.
+		uint64_t m_recordSequence; //!< Newest retirement sequence a freed blob had.
+		uint64_t m_recordTail;     //!< Ring tail past the newest freed payload.
+
+		std::vector<HierarchyNode> m_hierarchy;
+		bool m_hierarchyStale;  //!< The published hierarchy is older than m_hierarchy.
+		bool m_hierarchyStaged; //!< MAYABRIDGE_EVENT_HIERARCHY_CHANGED is staged.
+
+		std::vector<Event> m_staged;
+		bool m_overflow;
+		bool m_transformsStale; //!< Transform batches went out since the last publish.
+		uint64_t m_numResyncs;
+		uint64_t m_cameraEvent; //!< Ring position past the last MAYABRIDGE_EVENT_CAMERA_CHANGED.
+		uint32_t m_nextModelId;
+		std::atomic<uint64_t> m_nextMeshId;
+	};
+
+} // namespace mb
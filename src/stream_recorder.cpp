@@ -0,0 +1,101 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "stream_recorder.h"
+
+#include <string.h>
+
+namespace mb
+{
+	StreamRecorder::StreamRecorder()
+	{
+	}
+
+	bool StreamRecorder::open(const char* _path, const SharedData& _data)
+	{
+		close();
+
+		m_file.open(_path, std::ios::binary | std::ios::trunc);
+		if (!m_file)
+		{
+			return false;
+		}
+
+		StreamHeader header = {};
+		header.magic = MAYABRIDGE_STREAM_MAGIC;
+		header.version = MAYABRIDGE_STREAM_VERSION;
+		header.sceneVersion = MAYABRIDGE_SCENE_VERSION;
+		header.capacity = _data.capacity;
+		header.sequence = _data.sequence.load(std::memory_order_relaxed);
+		header.cameraSequence = _data.camera.sequence.load(std::memory_order_relaxed);
+		header.eventPosition = _data.events.head.load(std::memory_order_relaxed);
+		memcpy(&header.camera, (const void*)&_data.camera.camera, sizeof(Camera));
+		m_file.write(reinterpret_cast<const char*>(&header), sizeof(StreamHeader));
+		m_start = std::chrono::steady_clock::now();
+
+		return isOpen();
+	}
+
+	void StreamRecorder::close()
+	{
+		if (m_file.is_open())
+		{
+			m_file.close();
+		}
+		m_file.clear();
+	}
+
+	bool StreamRecorder::isOpen() const
+	{
+		return m_file.is_open() && m_file.good();
+	}
+
+	void StreamRecorder::writeRecord(uint32_t _type, const void* _header, uint32_t _headerSize, const void* _data, uint64_t _size)
+	{
+		if (!isOpen())
+		{
+			return;
+		}
+
+		StreamRecord record;
+		record.type = _type;
+		record.padding = 0;
+		record.size = _headerSize + _size;
+		record.time = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+
+		m_file.write(reinterpret_cast<const char*>(&record), sizeof(StreamRecord));
+		m_file.write(reinterpret_cast<const char*>(_header), _headerSize);
+		if (_size != 0)
+		{
+			m_file.write(reinterpret_cast<const char*>(_data), std::streamsize(_size));
+		}
+
+		if (!m_file)
+		{
+			m_file.close();
+		}
+	}
+
+	void StreamRecorder::writeBlob(const StreamBlob& _blob, const void* _data, uint64_t _size)
+	{
+		writeRecord(MAYABRIDGE_STREAM_RECORD_BLOB, &_blob, sizeof(StreamBlob), _data, _size);
+	}
+
+	void StreamRecorder::writeScene(const Scene& _scene)
+	{
+		writeRecord(MAYABRIDGE_STREAM_RECORD_SCENE, &_scene, sizeof(Scene), NULL, 0);
+	}
+
+	void StreamRecorder::writeCamera(const Camera& _camera)
+	{
+		writeRecord(MAYABRIDGE_STREAM_RECORD_CAMERA, &_camera, sizeof(Camera), NULL, 0);
+	}
+
+	void StreamRecorder::writeEvent(const Event& _event)
+	{
+		writeRecord(MAYABRIDGE_STREAM_RECORD_EVENT, &_event, sizeof(Event), NULL, 0);
+	}
+
+} // namespace mb
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include "maya-bridge/shared_data.h"
+
+#include <stdint.h> // uint32_t
+
+#include <chrono>
+#include <fstream>
+
+///
+#define MAYABRIDGE_STREAM_MAGIC   UINT32_C(0x5253424d) // 'MBSR'
+#define MAYABRIDGE_STREAM_VERSION UINT32_C(2)
+
+/// Records of a stream file, each a StreamRecord followed by `size` bytes.
+#define MAYABRIDGE_STREAM_RECORD_BLOB   UINT32_C(0x00000001) //!< StreamBlob, then the bytes it writes.
+#define MAYABRIDGE_STREAM_RECORD_SCENE  UINT32_C(0x00000002) //!< Scene that was published.
+#define MAYABRIDGE_STREAM_RECORD_CAMERA UINT32_C(0x00000003) //!< Camera that was published.
+#define MAYABRIDGE_STREAM_RECORD_EVENT  UINT32_C(0x00000004) //!< Event that went into the ring.
+
+namespace mb
+{
+	/// Start of a stream file, the state of the buffer when the recording
+	/// started. A replay starts from a fresh buffer with these counters, so
+	/// sequences and ring positions come out as they were recorded.
+	///
+	struct StreamHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t sceneVersion;   //!< MAYABRIDGE_SCENE_VERSION of the writer.
+		uint32_t padding;
+		uint64_t capacity;
+		uint64_t sequence;       //!< Scene sequence before the first record.
+		uint64_t cameraSequence;
+		uint64_t eventPosition;  //!< Ring head before the first record.
+		Camera camera;           //!< Camera Maya had published before the first record.
+	};
+
+	struct StreamRecord
+	{
+		uint32_t type; //!< MAYABRIDGE_STREAM_RECORD_*
+		uint32_t padding;
+		uint64_t size; //!< Bytes that follow, a mesh blob can be more than 4GB.
+		uint64_t time; //!< Nanoseconds since the recording started.
+	};
+
+	/// Bytes written into the arena. Maya only reused the range once the
+	/// reader had moved past what referenced it before, a replay has to wait
+	/// for its own reader the same way before writing them.
+	///
+	struct StreamBlob
+	{
+		uint64_t offset;
+		uint64_t readSequence; //!< Reader has to be idle or at least here.
+		uint64_t eventTail;    //!< Reader has to have consumed up to here.
+	};
+
+	/// Appends every publication of a SceneWriter to a file: blobs once when
+	/// they are first published, the scene and camera whenever they are,
+	/// and each event as it goes into the ring. Replaying the records in
+	/// order onto a fresh buffer leaves it as Maya left it at the same point.
+	///
+	class StreamRecorder
+	{
+		void writeRecord(uint32_t _type, const void* _header, uint32_t _headerSize, const void* _data, uint64_t _size);
+
+	public:
+		StreamRecorder();
+
+		/// Starts a new file at _path from the current state of _data.
+		/// False if it can't be created.
+		bool open(const char* _path, const SharedData& _data);
+		void close();
+
+		/// False once a write failed, the file stops at the last whole record.
+		bool isOpen() const;
+
+		void writeBlob(const StreamBlob& _blob, const void* _data, uint64_t _size);
+		void writeScene(const Scene& _scene);
+		void writeCamera(const Camera& _camera);
+		void writeEvent(const Event& _event);
+
+	private:
+		std::ofstream m_file;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+} // namespace mb
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "texture_cache.h"
+#include "maya-bridge/shared_data.h"
+#include "hash.h"
+
+#include <stdio.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace mb
+{
+	TextureCache::TextureCache()
+	{
+	}
+
+	bool TextureCache::init(const std::string& _directory)
+	{
+		m_directory.clear();
+		if (_directory.empty())
+		{
+			return true;
+		}
+
+		std::error_code error;
+		std::filesystem::create_directories(_directory, error);
+		if (error)
+		{
+			return false;
+		}
+
+		m_directory = _directory;
+		return true;
+	}
+
+	bool TextureCache::isEnabled() const
+	{
+		return !m_directory.empty();
+	}
+
+	bool TextureCache::getKey(const std::string& _path, uint32_t _slot, bool _bc7, uint64_t& _key) const
+	{
+		std::error_code error;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(_path, error);
+		if (error)
+		{
+			return false;
+		}
+
+		std::ifstream file(_path, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return false;
+		}
+
+		std::vector<char> bytes(size_t(file.tellg()));
+		file.seekg(0);
+		if (!file.read(bytes.data(), bytes.size()))
+		{
+			return false;
+		}
+
+		// What the file is encoded into, a new file version makes new entries
+		uint64_t hash = hashBytes(bytes.data(), bytes.size(), uint64_t(time.time_since_epoch().count()));
+		const uint32_t settings[3] = { _slot, _bc7 ? 1u : 0u, MAYABRIDGE_TEXTURE_VERSION };
+		_key = hashBytes(settings, sizeof(settings), hash);
+		return true;
+	}
+
+	std::string TextureCache::getPath(uint64_t _key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.mbtx", (unsigned long long)_key);
+		return (std::filesystem::path(m_directory) / name).string();
+	}
+
+	bool TextureCache::contains(uint64_t _key) const
+	{
+		std::ifstream file(getPath(_key), std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return false;
+		}
+
+		uint64_t size = uint64_t(file.tellg());
+		TextureHeader header;
+		file.seekg(0);
+		if (size < sizeof(TextureHeader) || !file.read(reinterpret_cast<char*>(&header), sizeof(TextureHeader)) || !header.isValid() || header.numMips == 0)
+		{
+			return false;
+		}
+
+		return header.mipOffsets[header.numMips - 1] + header.mipSizes[header.numMips - 1] <= size;
+	}
+
+	bool TextureCache::store(uint64_t _key, const std::vector<uint8_t>& _file) const
+	{
+		std::string path = getPath(_key);
+
+		// Unique per writer, other sessions may share the directory
+		uint64_t unique = uint64_t(std::hash<std::thread::id>()(std::this_thread::get_id())) ^ uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%016llx.tmp", (unsigned long long)unique);
+		std::string temporary = path + suffix;
+
+		std::error_code error;
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file || !file.write(reinterpret_cast<const char*>(_file.data()), _file.size()))
+			{
+				file.close();
+				std::filesystem::remove(temporary, error);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temporary, path, error);
+		if (error)
+		{
+			// Fine if another session stored the same entry first
+			std::filesystem::remove(temporary, error);
+			return contains(_key);
+		}
+		return true;
+	}
+
+} // namespace mb
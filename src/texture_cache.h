@@ -0,0 +1,50 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include <stdint.h> // uint64_t
+
+#include <string>
+#include <vector>
+
+namespace mb
+{
+	/// Directory of preprocessed textures, one file per key named after it.
+	/// A key covers the content of the source file, its modification time
+	/// and what the texture is encoded for, so an edited or re-exported
+	/// file gets a new entry and unchanged ones are never encoded twice,
+	/// across sessions and scenes. Entries are never removed. Everything but
+	/// init is safe to call from worker threads.
+	///
+	class TextureCache
+	{
+	public:
+		TextureCache();
+
+		/// An empty _directory turns the cache off. False if the directory
+		/// can't be created.
+		bool init(const std::string& _directory);
+		bool isEnabled() const;
+
+		/// Reads the file at _path for the key of texture _slot, encoded with
+		/// BC7 or not. False if the file can't be read.
+		bool getKey(const std::string& _path, uint32_t _slot, bool _bc7, uint64_t& _key) const;
+
+		/// Where the entry of _key is or would be.
+		std::string getPath(uint64_t _key) const;
+
+		/// True if the cache has a complete file for _key.
+		bool contains(uint64_t _key) const;
+
+		/// Writes the file under a temporary name first, readers never see
+		/// half of it.
+		bool store(uint64_t _key, const std::vector<uint8_t>& _file) const;
+
+	private:
+		std::string m_directory;
+	};
+
+} // namespace mb
@@ -0,0 +1,688 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "texture_encoder.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace mb
+{
+	/// Interpolation weights of the 4-bit BC7 indices, out of 64.
+	static const uint32_t s_bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	static float linearToSrgb(float _value)
+	{
+		return _value <= 0.0031308f ? _value * 12.92f : 1.055f * powf(_value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	static const float* getSrgbTable()
+	{
+		static const std::vector<float> s_table = []()
+		{
+			std::vector<float> table(256);
+			for (uint32_t ii = 0; ii < 256; ++ii)
+			{
+				float value = float(ii) / 255.0f;
+				table[ii] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+			}
+			return table;
+		}();
+		return s_table.data();
+	}
+
+	static uint8_t toByte(float _value)
+	{
+		return uint8_t(std::min(std::max(_value * 255.0f + 0.5f, 0.0f), 255.0f));
+	}
+
+	uint32_t chooseTextureFormat(uint32_t _slot, const TextureImage& _image, bool _bc7, uint32_t& _flags)
+	{
+		_flags = 0;
+		if (_slot == MAYABRIDGE_TEXTURE_NORMAL)
+		{
+			_flags = MAYABRIDGE_TEXTURE_FLAG_NORMAL;
+			return MAYABRIDGE_TEXTURE_FORMAT_BC5;
+		}
+		if (_slot == MAYABRIDGE_TEXTURE_METALLIC || _slot == MAYABRIDGE_TEXTURE_ROUGHNESS || _slot == MAYABRIDGE_TEXTURE_OCCLUSION)
+		{
+			return MAYABRIDGE_TEXTURE_FORMAT_BC4;
+		}
+
+		_flags = MAYABRIDGE_TEXTURE_FLAG_SRGB;
+		if (_bc7)
+		{
+			return MAYABRIDGE_TEXTURE_FORMAT_BC7;
+		}
+
+		bool alpha = false;
+		for (size_t ii = 3; ii < _image.pixels.size() && _slot == MAYABRIDGE_TEXTURE_BASE_COLOR && !alpha; ii += 4)
+		{
+			alpha = _image.pixels[ii] != 255;
+		}
+		return alpha ? MAYABRIDGE_TEXTURE_FORMAT_BC3 : MAYABRIDGE_TEXTURE_FORMAT_BC1;
+	}
+
+	void downsampleImage(const TextureImage& _src, TextureImage& _dst, uint32_t _flags)
+	{
+		_dst.width = std::max(_src.width / 2, 1u);
+		_dst.height = std::max(_src.height / 2, 1u);
+		_dst.pixels.resize(size_t(_dst.width) * _dst.height * 4);
+
+		const float* srgbTable = getSrgbTable();
+		bool srgb = (_flags & MAYABRIDGE_TEXTURE_FLAG_SRGB) != 0;
+		bool normal = (_flags & MAYABRIDGE_TEXTURE_FLAG_NORMAL) != 0;
+
+		for (uint32_t yy = 0; yy < _dst.height; ++yy)
+		{
+			uint32_t y0 = std::min(yy * 2, _src.height - 1);
+			uint32_t y1 = std::min(yy * 2 + 1, _src.height - 1);
+			for (uint32_t xx = 0; xx < _dst.width; ++xx)
+			{
+				uint32_t x0 = std::min(xx * 2, _src.width - 1);
+				uint32_t x1 = std::min(xx * 2 + 1, _src.width - 1);
+
+				const uint8_t* texels[4] =
+				{
+					&_src.pixels[(size_t(y0) * _src.width + x0) * 4],
+					&_src.pixels[(size_t(y0) * _src.width + x1) * 4],
+					&_src.pixels[(size_t(y1) * _src.width + x0) * 4],
+					&_src.pixels[(size_t(y1) * _src.width + x1) * 4],
+				};
+
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (uint32_t kk = 0; kk < 4; ++kk)
+				{
+					for (uint32_t cc = 0; cc < 4; ++cc)
+					{
+						sum[cc] += srgb && cc < 3 ? srgbTable[texels[kk][cc]] : float(texels[kk][cc]) / 255.0f;
+					}
+				}
+
+				uint8_t* out = &_dst.pixels[(size_t(yy) * _dst.width + xx) * 4];
+				if (normal)
+				{
+					float n[3] = { sum[0] * 0.5f - 1.0f, sum[1] * 0.5f - 1.0f, sum[2] * 0.5f - 1.0f };
+					float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					float scale = length > 0.0f ? 1.0f / length : 0.0f;
+					for (uint32_t cc = 0; cc < 3; ++cc)
+					{
+						out[cc] = toByte(n[cc] * scale * 0.5f + 0.5f);
+					}
+					out[3] = toByte(sum[3] * 0.25f);
+					continue;
+				}
+
+				for (uint32_t cc = 0; cc < 4; ++cc)
+				{
+					float value = sum[cc] * 0.25f;
+					out[cc] = toByte(srgb && cc < 3 ? linearToSrgb(value) : value);
+				}
+			}
+		}
+	}
+
+	static void loadBlock(const TextureImage& _image, uint32_t _blockX, uint32_t _blockY, uint8_t _block[16][4])
+	{
+		for (uint32_t yy = 0; yy < 4; ++yy)
+		{
+			uint32_t y = std::min(_blockY * 4 + yy, _image.height - 1);
+			for (uint32_t xx = 0; xx < 4; ++xx)
+			{
+				uint32_t x = std::min(_blockX * 4 + xx, _image.width - 1);
+				memcpy(_block[yy * 4 + xx], &_image.pixels[(size_t(y) * _image.width + x) * 4], 4);
+			}
+		}
+	}
+
+	/// Endpoints of the line through the 16 texels of a block, along the
+	/// axis they spread most on. The axis comes from power iteration on
+	/// the covariance of the first _channels channels.
+	///
+	static void fitEndpoints(const float (*_points)[4], uint32_t _channels, float* _e0, float* _e1)
+	{
+		float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			for (uint32_t cc = 0; cc < _channels; ++cc)
+			{
+				mean[cc] += _points[ii][cc] / 16.0f;
+			}
+		}
+
+		float covariance[4][4] = {};
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			for (uint32_t cc = 0; cc < _channels; ++cc)
+			{
+				for (uint32_t kk = 0; kk < _channels; ++kk)
+				{
+					covariance[cc][kk] += (_points[ii][cc] - mean[cc]) * (_points[ii][kk] - mean[kk]);
+				}
+			}
+		}
+
+		// Start from the channel with the most spread
+		uint32_t widest = 0;
+		for (uint32_t cc = 1; cc < _channels; ++cc)
+		{
+			widest = covariance[cc][cc] > covariance[widest][widest] ? cc : widest;
+		}
+
+		float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (uint32_t cc = 0; cc < _channels; ++cc)
+		{
+			axis[cc] = covariance[widest][cc];
+		}
+		for (uint32_t iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float largest = 0.0f;
+			for (uint32_t cc = 0; cc < _channels; ++cc)
+			{
+				for (uint32_t kk = 0; kk < _channels; ++kk)
+				{
+					next[cc] += covariance[cc][kk] * axis[kk];
+				}
+				largest = std::max(largest, fabsf(next[cc]));
+			}
+			if (largest == 0.0f)
+			{
+				break;
+			}
+			for (uint32_t cc = 0; cc < _channels; ++cc)
+			{
+				axis[cc] = next[cc] / largest;
+			}
+		}
+
+		float length = 0.0f;
+		for (uint32_t cc = 0; cc < _channels; ++cc)
+		{
+			length += axis[cc] * axis[cc];
+		}
+		length = sqrtf(length);
+
+		float minT = 0.0f;
+		float maxT = 0.0f;
+		if (length > 0.0f)
+		{
+			minT = INFINITY;
+			maxT = -INFINITY;
+			for (uint32_t ii = 0; ii < 16; ++ii)
+			{
+				float t = 0.0f;
+				for (uint32_t cc = 0; cc < _channels; ++cc)
+				{
+					t += (_points[ii][cc] - mean[cc]) * axis[cc] / length;
+				}
+				minT = std::min(minT, t);
+				maxT = std::max(maxT, t);
+			}
+		}
+
+		for (uint32_t cc = 0; cc < _channels; ++cc)
+		{
+			float direction = length > 0.0f ? axis[cc] / length : 0.0f;
+			_e0[cc] = std::min(std::max(mean[cc] + direction * minT, 0.0f), 255.0f);
+			_e1[cc] = std::min(std::max(mean[cc] + direction * maxT, 0.0f), 255.0f);
+		}
+	}
+
+	/// Least squares endpoints for the indices picked, _weights says how far
+	/// toward _e1 the palette entry of each index lies. False if the indices
+	/// don't pin the endpoints down.
+	///
+	static bool refineEndpoints(const float (*_points)[4], uint32_t _channels, const uint8_t* _indices, const float* _weights, float* _e0, float* _e1)
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			float b = _weights[_indices[ii]];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (uint32_t cc = 0; cc < _channels; ++cc)
+			{
+				ax[cc] += a * _points[ii][cc];
+				bx[cc] += b * _points[ii][cc];
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (fabsf(determinant) < 1e-6f)
+		{
+			return false;
+		}
+
+		for (uint32_t cc = 0; cc < _channels; ++cc)
+		{
+			_e0[cc] = std::min(std::max((ax[cc] * bb - bx[cc] * ab) / determinant, 0.0f), 255.0f);
+			_e1[cc] = std::min(std::max((bx[cc] * aa - ax[cc] * ab) / determinant, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	static uint16_t packRgb565(const float* _color)
+	{
+		uint32_t r = uint32_t(std::min(std::max(_color[0] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f));
+		uint32_t g = uint32_t(std::min(std::max(_color[1] * 63.0f / 255.0f + 0.5f, 0.0f), 63.0f));
+		uint32_t b = uint32_t(std::min(std::max(_color[2] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f));
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	static void unpackRgb565(uint16_t _packed, int* _color)
+	{
+		int r = (_packed >> 11) & 31;
+		int g = (_packed >> 5) & 63;
+		int b = _packed & 31;
+		_color[0] = (r << 3) | (r >> 2);
+		_color[1] = (g << 2) | (g >> 4);
+		_color[2] = (b << 3) | (b >> 2);
+	}
+
+	/// Nearest of the four colors for every texel, returns the squared error.
+	///
+	static uint32_t selectColorIndices(const float (*_points)[4], uint16_t _c0, uint16_t _c1, uint8_t* _indices)
+	{
+		int palette[4][3];
+		unpackRgb565(_c0, palette[0]);
+		unpackRgb565(_c1, palette[1]);
+		for (uint32_t cc = 0; cc < 3; ++cc)
+		{
+			palette[2][cc] = (2 * palette[0][cc] + palette[1][cc]) / 3;
+			palette[3][cc] = (palette[0][cc] + 2 * palette[1][cc]) / 3;
+		}
+
+		uint32_t error = 0;
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			uint32_t best = UINT32_MAX;
+			for (uint8_t index = 0; index < 4; ++index)
+			{
+				uint32_t distance = 0;
+				for (uint32_t cc = 0; cc < 3; ++cc)
+				{
+					int d = int(_points[ii][cc]) - palette[index][cc];
+					distance += uint32_t(d * d);
+				}
+				if (distance < best)
+				{
+					best = distance;
+					_indices[ii] = index;
+				}
+			}
+			error += best;
+		}
+		return error;
+	}
+
+	/// BC1 color block, also the color half of BC3.
+	///
+	static void encodeColorBlock(const uint8_t _block[16][4], uint8_t* _out)
+	{
+		float points[16][4];
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			for (uint32_t cc = 0; cc < 4; ++cc)
+			{
+				points[ii][cc] = float(_block[ii][cc]);
+			}
+		}
+
+		float e0[4];
+		float e1[4];
+		fitEndpoints(points, 3, e0, e1);
+
+		uint16_t c0 = packRgb565(e1);
+		uint16_t c1 = packRgb565(e0);
+		uint8_t indices[16];
+		uint32_t error = selectColorIndices(points, c0, c1, indices);
+
+		// One least squares pass on the indices found, kept if it helps
+		static const float s_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		if (refineEndpoints(points, 3, indices, s_weights, e0, e1))
+		{
+			uint16_t refined0 = packRgb565(e0);
+			uint16_t refined1 = packRgb565(e1);
+			uint8_t refinedIndices[16];
+			uint32_t refinedError = selectColorIndices(points, refined0, refined1, refinedIndices);
+			if (refinedError < error)
+			{
+				c0 = refined0;
+				c1 = refined1;
+				memcpy(indices, refinedIndices, sizeof(indices));
+			}
+		}
+
+		// The four color palette needs c0 > c1, swapping reverses it
+		if (c0 < c1)
+		{
+			std::swap(c0, c1);
+			for (uint32_t ii = 0; ii < 16; ++ii)
+			{
+				indices[ii] ^= 1;
+			}
+		}
+		else if (c0 == c1)
+		{
+			memset(indices, 0, sizeof(indices));
+		}
+
+		uint32_t bits = 0;
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			bits |= uint32_t(indices[ii]) << (ii * 2);
+		}
+
+		_out[0] = uint8_t(c0);
+		_out[1] = uint8_t(c0 >> 8);
+		_out[2] = uint8_t(c1);
+		_out[3] = uint8_t(c1 >> 8);
+		memcpy(_out + 4, &bits, 4);
+	}
+
+	/// BC4 block of one channel, also the alpha of BC3 and each half of BC5.
+	///
+	static void encodeChannelBlock(const uint8_t _block[16][4], uint32_t _channel, uint8_t* _out)
+	{
+		int minValue = 255;
+		int maxValue = 0;
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			minValue = std::min(minValue, int(_block[ii][_channel]));
+			maxValue = std::max(maxValue, int(_block[ii][_channel]));
+		}
+
+		// Eight value palette, a flat block only uses the first entry
+		int palette[8] = { maxValue, minValue };
+		for (int kk = 2; kk < 8; ++kk)
+		{
+			palette[kk] = ((8 - kk) * maxValue + (kk - 1) * minValue) / 7;
+		}
+
+		uint64_t bits = 0;
+		for (uint32_t ii = 0; ii < 16 && maxValue != minValue; ++ii)
+		{
+			uint32_t best = 0;
+			int bestDistance = 256;
+			for (uint32_t index = 0; index < 8; ++index)
+			{
+				int distance = abs(int(_block[ii][_channel]) - palette[index]);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = index;
+				}
+			}
+			bits |= uint64_t(best) << (ii * 3);
+		}
+
+		_out[0] = uint8_t(maxValue);
+		_out[1] = uint8_t(minValue);
+		for (uint32_t ii = 0; ii < 6; ++ii)
+		{
+			_out[2 + ii] = uint8_t(bits >> (ii * 8));
+		}
+	}
+
+	/// Quantizes an endpoint to the 7 bits and shared parity bit of BC7
+	/// mode 6, with whichever parity lands closer.
+	///
+	static void quantizeBc7Endpoint(const float* _endpoint, uint32_t* _quantized, uint32_t& _parity)
+	{
+		float bestError = INFINITY;
+		for (uint32_t parity = 0; parity < 2; ++parity)
+		{
+			uint32_t quantized[4];
+			float error = 0.0f;
+			for (uint32_t cc = 0; cc < 4; ++cc)
+			{
+				quantized[cc] = uint32_t(std::min(std::max((_endpoint[cc] - float(parity)) * 0.5f + 0.5f, 0.0f), 127.0f));
+				float d = float((quantized[cc] << 1) | parity) - _endpoint[cc];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(_quantized, quantized, sizeof(quantized));
+				_parity = parity;
+			}
+		}
+	}
+
+	/// Nearest of the 16 colors for every texel, returns the squared error.
+	///
+	static uint32_t selectBc7Indices(const float (*_points)[4], const uint32_t* _q0, uint32_t _p0, const uint32_t* _q1, uint32_t _p1, uint8_t* _indices)
+	{
+		int palette[16][4];
+		for (uint32_t cc = 0; cc < 4; ++cc)
+		{
+			int e0 = int((_q0[cc] << 1) | _p0);
+			int e1 = int((_q1[cc] << 1) | _p1);
+			for (uint32_t index = 0; index < 16; ++index)
+			{
+				palette[index][cc] = (e0 * int(64 - s_bc7Weights[index]) + e1 * int(s_bc7Weights[index]) + 32) >> 6;
+			}
+		}
+
+		uint32_t error = 0;
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			uint32_t best = UINT32_MAX;
+			for (uint8_t index = 0; index < 16; ++index)
+			{
+				uint32_t distance = 0;
+				for (uint32_t cc = 0; cc < 4; ++cc)
+				{
+					int d = int(_points[ii][cc]) - palette[index][cc];
+					distance += uint32_t(d * d);
+				}
+				if (distance < best)
+				{
+					best = distance;
+					_indices[ii] = index;
+				}
+			}
+			error += best;
+		}
+		return error;
+	}
+
+	/// Writes fields into a block from the lowest bit up.
+	///
+	struct BitWriter
+	{
+		void write(uint32_t _value, uint32_t _bits)
+		{
+			for (uint32_t ii = 0; ii < _bits; ++ii, ++position)
+			{
+				out[position >> 3] |= uint8_t(((_value >> ii) & 1) << (position & 7));
+			}
+		}
+
+		uint8_t* out;
+		uint32_t position;
+	};
+
+	/// BC7 in mode 6 only: one subset, RGBA endpoints and 16 levels. Simple
+	/// and still well ahead of BC1 and BC3 on smooth gradients.
+	///
+	static void encodeBc7Block(const uint8_t _block[16][4], uint8_t* _out)
+	{
+		float points[16][4];
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			for (uint32_t cc = 0; cc < 4; ++cc)
+			{
+				points[ii][cc] = float(_block[ii][cc]);
+			}
+		}
+
+		float e0[4];
+		float e1[4];
+		fitEndpoints(points, 4, e0, e1);
+
+		uint32_t q0[4];
+		uint32_t q1[4];
+		uint32_t p0 = 0;
+		uint32_t p1 = 0;
+		quantizeBc7Endpoint(e0, q0, p0);
+		quantizeBc7Endpoint(e1, q1, p1);
+		uint8_t indices[16];
+		uint32_t error = selectBc7Indices(points, q0, p0, q1, p1, indices);
+
+		float weights[16];
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			weights[ii] = float(s_bc7Weights[ii]) / 64.0f;
+		}
+		if (refineEndpoints(points, 4, indices, weights, e0, e1))
+		{
+			uint32_t refined0[4];
+			uint32_t refined1[4];
+			uint32_t parity0 = 0;
+			uint32_t parity1 = 0;
+			quantizeBc7Endpoint(e0, refined0, parity0);
+			quantizeBc7Endpoint(e1, refined1, parity1);
+			uint8_t refinedIndices[16];
+			uint32_t refinedError = selectBc7Indices(points, refined0, parity0, refined1, parity1, refinedIndices);
+			if (refinedError < error)
+			{
+				memcpy(q0, refined0, sizeof(q0));
+				memcpy(q1, refined1, sizeof(q1));
+				p0 = parity0;
+				p1 = parity1;
+				memcpy(indices, refinedIndices, sizeof(indices));
+			}
+		}
+
+		// The top bit of the first index is implied 0, swapping reverses the palette
+		if (indices[0] & 8)
+		{
+			std::swap(q0, q1);
+			std::swap(p0, p1);
+			for (uint32_t ii = 0; ii < 16; ++ii)
+			{
+				indices[ii] = uint8_t(15 - indices[ii]);
+			}
+		}
+
+		memset(_out, 0, 16);
+		BitWriter writer = { _out, 0 };
+		writer.write(1 << 6, 7);
+		for (uint32_t cc = 0; cc < 4; ++cc)
+		{
+			writer.write(q0[cc], 7);
+			writer.write(q1[cc], 7);
+		}
+		writer.write(p0, 1);
+		writer.write(p1, 1);
+		writer.write(indices[0], 3);
+		for (uint32_t ii = 1; ii < 16; ++ii)
+		{
+			writer.write(indices[ii], 4);
+		}
+	}
+
+	static uint32_t getBlockSize(uint32_t _format)
+	{
+		return _format == MAYABRIDGE_TEXTURE_FORMAT_BC1 || _format == MAYABRIDGE_TEXTURE_FORMAT_BC4 ? 8 : 16;
+	}
+
+	uint64_t getCompressedSize(uint32_t _format, uint32_t _width, uint32_t _height)
+	{
+		return uint64_t((_width + 3) / 4) * ((_height + 3) / 4) * getBlockSize(_format);
+	}
+
+	void compressImage(const TextureImage& _image, uint32_t _format, uint8_t* _out)
+	{
+		uint32_t blockSize = getBlockSize(_format);
+		uint32_t numBlocksX = (_image.width + 3) / 4;
+		uint32_t numBlocksY = (_image.height + 3) / 4;
+
+		uint8_t block[16][4];
+		for (uint32_t by = 0; by < numBlocksY; ++by)
+		{
+			for (uint32_t bx = 0; bx < numBlocksX; ++bx)
+			{
+				loadBlock(_image, bx, by, block);
+
+				uint8_t* out = _out + (size_t(by) * numBlocksX + bx) * blockSize;
+				if (_format == MAYABRIDGE_TEXTURE_FORMAT_BC1)
+				{
+					encodeColorBlock(block, out);
+				}
+				else if (_format == MAYABRIDGE_TEXTURE_FORMAT_BC3)
+				{
+					encodeChannelBlock(block, 3, out);
+					encodeColorBlock(block, out + 8);
+				}
+				else if (_format == MAYABRIDGE_TEXTURE_FORMAT_BC4)
+				{
+					encodeChannelBlock(block, 0, out);
+				}
+				else if (_format == MAYABRIDGE_TEXTURE_FORMAT_BC5)
+				{
+					encodeChannelBlock(block, 0, out);
+					encodeChannelBlock(block, 1, out + 8);
+				}
+				else
+				{
+					encodeBc7Block(block, out);
+				}
+			}
+		}
+	}
+
+	void encodeTexture(const TextureImage& _image, uint32_t _format, uint32_t _flags, std::vector<uint8_t>& _file)
+	{
+		TextureHeader header;
+		memset(&header, 0, sizeof(TextureHeader));
+		header.magic = MAYABRIDGE_TEXTURE_MAGIC;
+		header.version = MAYABRIDGE_TEXTURE_VERSION;
+		header.format = _format;
+		header.flags = _flags;
+		header.width = _image.width;
+		header.height = _image.height;
+
+		// Every mip down to 1x1, as far as the header has room
+		header.numMips = 1;
+		while (header.numMips < MAYABRIDGE_TEXTURE_MAX_MIPS && (std::max(_image.width, _image.height) >> header.numMips) != 0)
+		{
+			header.numMips += 1;
+		}
+
+		uint64_t offset = sizeof(TextureHeader);
+		for (uint32_t mip = 0; mip < header.numMips; ++mip)
+		{
+			header.mipOffsets[mip] = offset;
+			header.mipSizes[mip] = getCompressedSize(_format, std::max(_image.width >> mip, 1u), std::max(_image.height >> mip, 1u));
+			offset += header.mipSizes[mip];
+		}
+
+		_file.assign(size_t(offset), 0);
+		memcpy(_file.data(), &header, sizeof(TextureHeader));
+
+		TextureImage mips[2];
+		const TextureImage* image = &_image;
+		for (uint32_t mip = 0; mip < header.numMips; ++mip)
+		{
+			if (mip != 0)
+			{
+				downsampleImage(*image, mips[mip & 1], _flags);
+				image = &mips[mip & 1];
+			}
+			compressImage(*image, _format, &_file[size_t(header.mipOffsets[mip])]);
+		}
+	}
+
+} // namespace mb
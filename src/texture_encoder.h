@@ -0,0 +1,50 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include "maya-bridge/shared_data.h"
+
+#include <stdint.h> // uint32_t
+
+#include <vector>
+
+namespace mb
+{
+	/// Decoded texture, RGBA8 rows from the top of the image.
+	///
+	struct TextureImage
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> pixels;
+	};
+
+	/// Format and MAYABRIDGE_TEXTURE_FLAG_* for texture _slot of a material:
+	/// BC5 for normal maps, BC4 for the single channel maps, and for colors
+	/// BC7, or with _bc7 off BC1 unless the base color has alpha.
+	///
+	uint32_t chooseTextureFormat(uint32_t _slot, const TextureImage& _image, bool _bc7, uint32_t& _flags);
+
+	/// Halves _src in both dimensions with a box filter. sRGB colors are
+	/// averaged in linear space and normals are renormalized.
+	///
+	void downsampleImage(const TextureImage& _src, TextureImage& _dst, uint32_t _flags);
+
+	/// Bytes of one mip in _format, in whole blocks.
+	///
+	uint64_t getCompressedSize(uint32_t _format, uint32_t _width, uint32_t _height);
+
+	/// Compresses _image into blocks of _format, rows of blocks from the top.
+	/// Blocks over the edge repeat the last row and column.
+	///
+	void compressImage(const TextureImage& _image, uint32_t _format, uint8_t* _out);
+
+	/// Builds the mip chain of _image and writes the file the texture cache
+	/// stores: a TextureHeader, then the compressed mips.
+	///
+	void encodeTexture(const TextureImage& _image, uint32_t _format, uint32_t _flags, std::vector<uint8_t>& _file);
+
+} // namespace mb
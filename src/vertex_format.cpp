@@ -0,0 +1,426 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#include "vertex_format.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAYABRIDGE_VERTEX_SSE2 1
+#include <emmintrin.h>
+#else
+#define MAYABRIDGE_VERTEX_SSE2 0
+#endif
+
+#if defined(__F16C__)
+#define MAYABRIDGE_VERTEX_F16C 1
+#include <immintrin.h>
+#else
+#define MAYABRIDGE_VERTEX_F16C 0
+#endif
+
+namespace mb
+{
+	uint32_t getVertexStride(uint32_t _format)
+	{
+		VertexLayout layout;
+		return getVertexLayout(_format, layout) ? layout.stride : 0;
+	}
+
+	void getPositionRange(const Bounds& _bounds, float* _offset, float* _scale)
+	{
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			_offset[kk] = _bounds.min[kk];
+			_scale[kk] = (_bounds.max[kk] - _bounds.min[kk]) / 65535.0f;
+		}
+	}
+
+	uint16_t encodeHalf(float _value)
+	{
+#if MAYABRIDGE_VERTEX_F16C
+		return uint16_t(_mm_cvtsi128_si32(_mm_cvtps_ph(_mm_set_ss(_value), _MM_FROUND_TO_NEAREST_INT)));
+#else
+		uint32_t bits;
+		memcpy(&bits, &_value, sizeof(bits));
+
+		uint32_t sign = (bits >> 16) & 0x8000;
+		uint32_t exponent = (bits >> 23) & 0xff;
+		uint32_t mantissa = bits & 0x7fffff;
+
+		// Inf and NaN, keep NaNs quiet
+		if (exponent == 0xff)
+		{
+			return uint16_t(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+		}
+
+		int32_t halfExponent = int32_t(exponent) - 127 + 15;
+		if (halfExponent >= 0x1f)
+		{
+			return uint16_t(sign | 0x7c00);
+		}
+
+		// Denormals, round to nearest even on the shifted out bits
+		if (halfExponent <= 0)
+		{
+			if (halfExponent < -10)
+			{
+				return uint16_t(sign);
+			}
+			mantissa |= 0x800000;
+			uint32_t shift = uint32_t(14 - halfExponent);
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			half += (rest > halfway || (rest == halfway && (half & 1))) ? 1 : 0;
+			return uint16_t(sign | half);
+		}
+
+		uint32_t half = (uint32_t(halfExponent) << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1fff;
+		half += (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ? 1 : 0;
+		return uint16_t(sign | half);
+#endif // MAYABRIDGE_VERTEX_F16C
+	}
+
+	float decodeHalf(uint16_t _value)
+	{
+		uint32_t sign = uint32_t(_value & 0x8000) << 16;
+		uint32_t exponent = (_value >> 10) & 0x1f;
+		uint32_t mantissa = _value & 0x3ff;
+
+		uint32_t bits;
+		if (exponent == 0x1f)
+		{
+			bits = sign | 0x7f800000 | (mantissa << 13);
+		}
+		else if (exponent != 0)
+		{
+			bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+		}
+		else if (mantissa != 0)
+		{
+			// Denormal, normalize it
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400) == 0)
+			{
+				mantissa <<= 1;
+				exponent -= 1;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+		else
+		{
+			bits = sign;
+		}
+
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	static int16_t encodeSnorm16(float _value)
+	{
+		_value = _value < -1.0f ? -1.0f : (_value > 1.0f ? 1.0f : _value);
+		return int16_t(lrintf(_value * 32767.0f));
+	}
+
+	static uint8_t encodeUnorm8(float _value)
+	{
+		_value = _value < 0.0f ? 0.0f : (_value > 1.0f ? 1.0f : _value);
+		return uint8_t(lrintf(_value * 255.0f));
+	}
+
+	/// Positions to UNORM16 relative to the mesh bounds, w is written as 0.
+	///
+	static void encodePositions(const Vertex* _vertices, uint32_t _numVertices, const float* _offset, const float* _scale, uint8_t* _out, uint32_t _stride)
+	{
+		float invScale[3];
+		for (int kk = 0; kk < 3; ++kk)
+		{
+			invScale[kk] = _scale[kk] > 0.0f ? 1.0f / _scale[kk] : 0.0f;
+		}
+
+#if MAYABRIDGE_VERTEX_SSE2
+		const __m128 offset = _mm_setr_ps(_offset[0], _offset[1], _offset[2], 0.0f);
+		const __m128 scale = _mm_setr_ps(invScale[0], invScale[1], invScale[2], 0.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 max = _mm_set1_ps(65535.0f);
+		const __m128i bias = _mm_set1_epi32(32768);
+		const __m128i sign = _mm_set1_epi16(int16_t(0x8000));
+
+		for (uint32_t ii = 0; ii < _numVertices; ++ii)
+		{
+			// The fourth lane reads the normal, the zero scale drops it again.
+			__m128 position = _mm_loadu_ps(_vertices[ii].position);
+			__m128 value = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(position, offset), scale), half);
+			value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), max);
+
+			// SSE2 only packs with signed saturation, shift into range and back.
+			__m128i quantized = _mm_sub_epi32(_mm_cvttps_epi32(value), bias);
+			__m128i packed = _mm_xor_si128(_mm_packs_epi32(quantized, quantized), sign);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(_out + ii * _stride), packed);
+		}
+#else
+		for (uint32_t ii = 0; ii < _numVertices; ++ii)
+		{
+			uint16_t* position = reinterpret_cast<uint16_t*>(_out + ii * _stride);
+			for (int kk = 0; kk < 3; ++kk)
+			{
+				float value = (_vertices[ii].position[kk] - _offset[kk]) * invScale[kk] + 0.5f;
+				value = value < 0.0f ? 0.0f : (value > 65535.0f ? 65535.0f : value);
+				position[kk] = uint16_t(value);
+			}
+			position[3] = 0;
+		}
+#endif // MAYABRIDGE_VERTEX_SSE2
+	}
+
+	static void normalize(float* _v)
+	{
+		float length = sqrtf(_v[0] * _v[0] + _v[1] * _v[1] + _v[2] * _v[2]);
+		if (length > 1e-12f)
+		{
+			_v[0] /= length;
+			_v[1] /= length;
+			_v[2] /= length;
+		}
+	}
+
+	static void cross(const float* _a, const float* _b, float* _out)
+	{
+		_out[0] = _a[1] * _b[2] - _a[2] * _b[1];
+		_out[1] = _a[2] * _b[0] - _a[0] * _b[2];
+		_out[2] = _a[0] * _b[1] - _a[1] * _b[0];
+	}
+
+	/// Octahedral mapping of a unit vector to [-1, 1]^2.
+	///
+	static void encodeOctahedral(const float* _normal, int16_t* _out)
+	{
+		float n[3] = { _normal[0], _normal[1], _normal[2] };
+		float sum = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+		if (sum < 1e-12f)
+		{
+			_out[0] = 0;
+			_out[1] = 0;
+			return;
+		}
+
+		float x = n[0] / sum;
+		float y = n[1] / sum;
+		if (n[2] < 0.0f)
+		{
+			float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = fx;
+			y = fy;
+		}
+
+		_out[0] = encodeSnorm16(x);
+		_out[1] = encodeSnorm16(y);
+	}
+
+	/// Rotation taking the tangent space axes to (tangent, cross(normal,
+	/// tangent), normal), negated when the bitangent points the other way.
+	///
+	static void encodeTangentFrame(const Vertex& _vertex, int16_t* _out)
+	{
+		float n[3] = { _vertex.normal[0], _vertex.normal[1], _vertex.normal[2] };
+		float t[3] = { _vertex.tangent[0], _vertex.tangent[1], _vertex.tangent[2] };
+		normalize(n);
+
+		// Faces without uvs have no tangent, any perpendicular will do.
+		float d = n[0] * t[0] + n[1] * t[1] + n[2] * t[2];
+		t[0] -= n[0] * d;
+		t[1] -= n[1] * d;
+		t[2] -= n[2] * d;
+		if (t[0] * t[0] + t[1] * t[1] + t[2] * t[2] < 1e-12f)
+		{
+			float axis[3] = { fabsf(n[0]) < 0.9f ? 1.0f : 0.0f, fabsf(n[0]) < 0.9f ? 0.0f : 1.0f, 0.0f };
+			cross(n, axis, t);
+		}
+		normalize(t);
+
+		float b[3];
+		cross(n, t, b);
+
+		const float* bitangent = _vertex.bitangent;
+		float handedness = (b[0] * bitangent[0] + b[1] * bitangent[1] + b[2] * bitangent[2]) < 0.0f ? -1.0f : 1.0f;
+
+		// Columns t, b, n
+		float m00 = t[0], m01 = b[0], m02 = n[0];
+		float m10 = t[1], m11 = b[1], m12 = n[1];
+		float m20 = t[2], m21 = b[2], m22 = n[2];
+
+		float q[4];
+		float trace = m00 + m11 + m22;
+		if (trace > 0.0f)
+		{
+			float s = sqrtf(trace + 1.0f) * 2.0f;
+			q[3] = 0.25f * s;
+			q[0] = (m21 - m12) / s;
+			q[1] = (m02 - m20) / s;
+			q[2] = (m10 - m01) / s;
+		}
+		else if (m00 > m11 && m00 > m22)
+		{
+			float s = sqrtf(1.0f + m00 - m11 - m22) * 2.0f;
+			q[3] = (m21 - m12) / s;
+			q[0] = 0.25f * s;
+			q[1] = (m01 + m10) / s;
+			q[2] = (m02 + m20) / s;
+		}
+		else if (m11 > m22)
+		{
+			float s = sqrtf(1.0f + m11 - m00 - m22) * 2.0f;
+			q[3] = (m02 - m20) / s;
+			q[0] = (m01 + m10) / s;
+			q[1] = 0.25f * s;
+			q[2] = (m12 + m21) / s;
+		}
+		else
+		{
+			float s = sqrtf(1.0f + m22 - m00 - m11) * 2.0f;
+			q[3] = (m10 - m01) / s;
+			q[0] = (m02 + m20) / s;
+			q[1] = (m12 + m21) / s;
+			q[2] = 0.25f * s;
+		}
+
+		// w carries the handedness, so it can't be allowed to quantize to 0
+		if (q[3] < 0.0f)
+		{
+			q[0] = -q[0];
+			q[1] = -q[1];
+			q[2] = -q[2];
+			q[3] = -q[3];
+		}
+
+		const float bias = 1.0f / 32767.0f;
+		if (q[3] < bias)
+		{
+			float scale = sqrtf(1.0f - bias * bias);
+			q[0] *= scale;
+			q[1] *= scale;
+			q[2] *= scale;
+			q[3] = bias;
+		}
+
+		for (int kk = 0; kk < 4; ++kk)
+		{
+			_out[kk] = encodeSnorm16(q[kk] * handedness);
+		}
+	}
+
+	void encodeVertices(uint32_t _format, const Vertex* _vertices, uint32_t _numVertices, const float* _offset, const float* _scale, void* _out)
+	{
+		switch (_format)
+		{
+		case MAYABRIDGE_VERTEX_FORMAT_FLOAT:
+			memcpy(_out, _vertices, sizeof(Vertex) * _numVertices);
+			break;
+
+		case MAYABRIDGE_VERTEX_FORMAT_COMPACT:
+			{
+				CompactVertex* out = static_cast<CompactVertex*>(_out);
+				encodePositions(_vertices, _numVertices, _offset, _scale, reinterpret_cast<uint8_t*>(out), sizeof(CompactVertex));
+
+				for (uint32_t ii = 0; ii < _numVertices; ++ii)
+				{
+					const Vertex& vertex = _vertices[ii];
+					CompactVertex& compact = out[ii];
+
+					encodeTangentFrame(vertex, compact.tangentFrame);
+					compact.texcoord[0] = encodeHalf(vertex.texcoord[0]);
+					compact.texcoord[1] = encodeHalf(vertex.texcoord[1]);
+					for (int kk = 0; kk < 4; ++kk)
+					{
+						compact.weights[kk] = encodeUnorm8(vertex.weights[kk]);
+						compact.indices[kk] = vertex.indices[kk];
+					}
+					compact.displacement = encodeHalf(vertex.displacement);
+					compact.padding = 0;
+				}
+			}
+			break;
+
+		case MAYABRIDGE_VERTEX_FORMAT_SLIM:
+			{
+				SlimVertex* out = static_cast<SlimVertex*>(_out);
+				encodePositions(_vertices, _numVertices, _offset, _scale, reinterpret_cast<uint8_t*>(out), sizeof(SlimVertex));
+
+				for (uint32_t ii = 0; ii < _numVertices; ++ii)
+				{
+					const Vertex& vertex = _vertices[ii];
+					SlimVertex& slim = out[ii];
+
+					encodeOctahedral(vertex.normal, slim.normal);
+					slim.texcoord[0] = encodeHalf(vertex.texcoord[0]);
+					slim.texcoord[1] = encodeHalf(vertex.texcoord[1]);
+				}
+			}
+			break;
+		}
+	}
+
+	void encodeVertexStreams(uint32_t _format, const VertexLayout& _layout, const Vertex* _vertices, uint32_t _numVertices, const float* _offset, const float* _scale, uint8_t* const* _out)
+	{
+		VertexLayout interleaved;
+		if (!getVertexLayout(_format, interleaved))
+		{
+			return;
+		}
+
+		// Attributes are in the same order in both layouts
+		uint32_t sizes[MAYABRIDGE_VERTEX_MAX_ATTRIBUTES];
+		uint32_t used[MAYABRIDGE_VERTEX_MAX_STREAMS] = {};
+		for (uint32_t ii = 0; ii < _layout.numAttributes; ++ii)
+		{
+			const VertexAttribute& attribute = _layout.attributes[ii];
+			sizes[ii] = getAttributeSize(attribute);
+			used[attribute.stream] = attribute.offset + sizes[ii];
+		}
+
+		// Encode interleaved in blocks that stay in cache, then scatter
+		const uint32_t blockSize = 256;
+		uint8_t block[blockSize * sizeof(Vertex)];
+
+		for (uint32_t first = 0; first < _numVertices; first += blockSize)
+		{
+			uint32_t count = _numVertices - first < blockSize ? _numVertices - first : blockSize;
+			encodeVertices(_format, _vertices + first, count, _offset, _scale, block);
+
+			for (uint32_t ii = 0; ii < _layout.numAttributes; ++ii)
+			{
+				const VertexAttribute& attribute = _layout.attributes[ii];
+				uint32_t stride = _layout.streamStrides[attribute.stream];
+
+				const uint8_t* src = block + interleaved.attributes[ii].offset;
+				uint8_t* dst = _out[attribute.stream] + uint64_t(first) * stride + attribute.offset;
+				for (uint32_t jj = 0; jj < count; ++jj)
+				{
+					memcpy(dst + jj * stride, src + jj * interleaved.stride, sizes[ii]);
+				}
+			}
+
+			// Padding is hashed with the stream, keep it deterministic
+			for (uint32_t stream = 0; stream < MAYABRIDGE_VERTEX_MAX_STREAMS; ++stream)
+			{
+				uint32_t stride = _layout.streamStrides[stream];
+				if (used[stream] < stride)
+				{
+					uint8_t* dst = _out[stream] + uint64_t(first) * stride + used[stream];
+					for (uint32_t jj = 0; jj < count; ++jj)
+					{
+						memset(dst + jj * stride, 0, stride - used[stream]);
+					}
+				}
+			}
+		}
+	}
+
+} // namespace mb
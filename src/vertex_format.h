@@ -0,0 +1,33 @@
+/*
+ * Copyright 2025 Marcus Nesse Madland. All rights reserved.
+ * License: https://github.com/marcusnessemadland/vulkan-renderer/blob/main/LICENSE
+ */
+
+#pragma once
+
+#include "maya-bridge/shared_data.h"
+
+namespace mb
+{
+	/// Bytes per vertex in _format, 0 if the format is unknown.
+	///
+	uint32_t getVertexStride(uint32_t _format);
+
+	/// Range the quantized positions are relative to, so that they decode
+	/// to _offset + unorm * _scale.
+	///
+	void getPositionRange(const Bounds& _bounds, float* _offset, float* _scale);
+
+	/// Writes _numVertices vertices in _format to _out.
+	///
+	void encodeVertices(uint32_t _format, const Vertex* _vertices, uint32_t _numVertices, const float* _offset, const float* _scale, void* _out);
+
+	/// Writes _numVertices vertices in _format split into the streams of
+	/// _layout, _out holds the destination of each stream with a stride.
+	///
+	void encodeVertexStreams(uint32_t _format, const VertexLayout& _layout, const Vertex* _vertices, uint32_t _numVertices, const float* _offset, const float* _scale, uint8_t* const* _out);
+
+	uint16_t encodeHalf(float _value);
+	float decodeHalf(uint16_t _value);
+
+} // namespace mb